@@ -17,6 +17,26 @@ struct Vec4Line
 		: P1(p1), P2(p2) {}
 };
 
+// Structure of arrays point storage used by the batch transform methods of Mat4
+struct PointStream
+{
+	std::vector<double> X;
+	std::vector<double> Y;
+	std::vector<double> Z;
+	std::vector<double> W;
+
+	void Resize(size_t n)
+	{
+		X.resize(n);
+		Y.resize(n);
+		Z.resize(n);
+		W.resize(n);
+	}
+
+	size_t Size() const { return X.size(); }
+	Vec4 Get(size_t i) const { return Vec4(X[i], Y[i], Z[i], W[i]); }
+};
+
 inline bool IsMinDbl(double a, double b)
 {
 	return a < b;
@@ -4,6 +4,10 @@ void Animation::AddKeyFrame(Frame* keyFrame)
 {
     if (keyFrame == NULL)
         return;
+
+    // Decompose once here, interpolation only blends the components
+    keyFrame->ObjectToParentTRS = TRS::FromMatrix(keyFrame->ObjectToParentTransform);
+    keyFrame->ViewTRS = TRS::FromMatrix(keyFrame->ViewTransform);
     
     if (keyFrame->FrameNum > maxFrame)
     {
@@ -32,24 +36,20 @@ Frame* Animation::GetFrame(int frame)
 
     if (Settings::FramesInterpolation[0])
     {
-        for (unsigned int i = 0; i < keyFrames.size(); i++)
+        // Keyframes are sorted by frame number, find the first one at or after frame
+        auto it = std::lower_bound(keyFrames.begin(), keyFrames.end(), frame,
+            [](const Frame* keyFrame, int frameNum) { return keyFrame->FrameNum < frameNum; });
+
+        if (((*it)->FrameNum == frame) || (it == keyFrames.begin()))
+        {
+            frameToReturn = new Frame();
+            frameToReturn->ObjectToParentTransform = (*it)->ObjectToParentTransform;
+            frameToReturn->ViewTransform = (*it)->ViewTransform;
+            frameToReturn->FrameNum = frame;
+        }
+        else
         {
-            if (keyFrames[i]->FrameNum == frame)
-            {
-                frameToReturn = new Frame();
-                frameToReturn->ObjectToWorldTransform = keyFrames[i]->ObjectToWorldTransform;
-                frameToReturn->ViewTransform = keyFrames[i]->ViewTransform;
-                frameToReturn->FrameNum = frame;
-                break;
-            }
-
-            if ((keyFrames[i]->FrameNum < frame) && 
-                (keyFrames[i + 1]->FrameNum > frame))
-            {
-                frameToReturn = GetFrameLinearInterpolation2(keyFrames[i], 
-                    keyFrames[i + 1], frame);
-                break;
-            }
+            frameToReturn = GetFrameTRSInterpolation(*(it - 1), *it, frame);
         }
     }
     else if (Settings::FramesInterpolation[1])
@@ -143,58 +143,27 @@ Frame* Animation::GetFrameLinearInterpolation(Frame* before, Frame* after, int f
     Frame* result = new Frame();
     double t = (double)(frame - before->FrameNum) / (after->FrameNum - before->FrameNum);
 
-    result->ObjectToWorldTransform = before->ObjectToWorldTransform * (1.0 - t) + after->ObjectToWorldTransform * t;
+    result->ObjectToParentTransform = before->ObjectToParentTransform * (1.0 - t) + after->ObjectToParentTransform * t;
     result->ViewTransform = before->ViewTransform * (1.0 - t) + after->ViewTransform * t;
     result->FrameNum = frame;
 
     return result;
 }
 
-Frame* Animation::GetFrameLinearInterpolation2(Frame* before, Frame* after, int frame) const
+Frame* Animation::GetFrameTRSInterpolation(Frame* before, Frame* after, int frame) const
 {
+    // Blending whole matrices shears rotations, fall back to it only when a
+    // keyframe has shear that can't be represented as TRS
+    if (!before->ObjectToParentTRS.IsExact || !after->ObjectToParentTRS.IsExact ||
+        !before->ViewTRS.IsExact || !after->ViewTRS.IsExact)
+        return GetFrameLinearInterpolation(before, after, frame);
+
     Frame* result = new Frame();
     double t = (double)(frame - before->FrameNum) / (after->FrameNum - before->FrameNum);
-    
-    Mat4 ObjectToWorldTransform = before->ObjectToWorldTransform;
-    Mat4 ViewTransform = before->ViewTransform;
-
-    Vec4 transform = Vec4(0.0, 0.0, 0.0, 1.0) * (1.0 - t) + after->Translation * t;
-    Vec4 scale = Vec4(1.0, 1.0, 1.0, 1.0) * (1.0 - t) + after->Scale * t;
-    Vec4 rotation = Vec4(0.0, 0.0, 0.0, 1.0) * (1.0 - t) + after->Rotation * t;
-
-    if (after->Space == ID_SPACE_OBJECT)
-    {
-        if (after->Action[0])
-            ObjectToWorldTransform = Mat4::Translate(transform) * ObjectToWorldTransform;
-        else if (after->Action[1])
-            ObjectToWorldTransform = Mat4::Scale(scale) * ObjectToWorldTransform;
-        else
-            ObjectToWorldTransform = Mat4::RotateX(rotation[0]) * Mat4::RotateY(rotation[1]) 
-                * Mat4::RotateZ(rotation[2]) * ObjectToWorldTransform;
-    }
-    else if (after->Space == ID_SPACE_WORLD)
-    {
-        if (after->Action[0])
-            ObjectToWorldTransform = ObjectToWorldTransform * Mat4::Translate(transform);
-        else if (after->Action[1])
-            ObjectToWorldTransform = ObjectToWorldTransform * Mat4::Scale(scale);
-        else
-            ObjectToWorldTransform = ObjectToWorldTransform * Mat4::RotateX(rotation[0]) * Mat4::RotateY(rotation[1]) 
-                * Mat4::RotateZ(rotation[2]);
-    }
-    else
-    {
-        if (after->Action[0])
-            ViewTransform = Mat4::Translate(transform) * ViewTransform;
-        else if (after->Action[1])
-            ViewTransform = Mat4::Scale(scale) * ViewTransform;
-        else
-            ViewTransform = Mat4::RotateX(rotation[0]) 
-                * Mat4::RotateY(rotation[1]) * Mat4::RotateZ(rotation[2]) * ViewTransform;
-    }
 
-    result->ObjectToWorldTransform = ObjectToWorldTransform;
-    result->ViewTransform = ViewTransform;
+    result->ObjectToParentTransform = TRS::Interpolate(before->ObjectToParentTRS, 
+        after->ObjectToParentTRS, t).ToMatrix();
+    result->ViewTransform = TRS::Interpolate(before->ViewTRS, after->ViewTRS, t).ToMatrix();
     result->FrameNum = frame;
 
     return result;
@@ -221,7 +190,7 @@ Frame* Animation::GetFrameBezierInterpolation(int frameNum) const
 
         double fact = (temp1 * temp2 * temp3) / temp4;
 
-        sumModel = sumModel + keyFrames[i]->ObjectToWorldTransform * fact;
+        sumModel = sumModel + keyFrames[i]->ObjectToParentTransform * fact;
         sumCam = sumCam + keyFrames[i]->ViewTransform * fact;
     }
     sumModel[3][3] = 1.0;
@@ -231,15 +200,15 @@ Frame* Animation::GetFrameBezierInterpolation(int frameNum) const
 
     if (!isOnlyTranslation)
     {
-        frame->ObjectToWorldTransform = sumModel;
+        frame->ObjectToParentTransform = sumModel;
         frame->ViewTransform = sumCam;
     }
     else
     {
-        frame->ObjectToWorldTransform = keyFrames[0]->ObjectToWorldTransform;
+        frame->ObjectToParentTransform = keyFrames[0]->ObjectToParentTransform;
         frame->ViewTransform = keyFrames[0]->ViewTransform;
 
-        frame->ObjectToWorldTransform[3] = sumModel[3];
+        frame->ObjectToParentTransform[3] = sumModel[3];
         frame->ViewTransform[3] = sumCam[3];
     }
     frame->FrameNum = frameNum;
@@ -1,27 +1,21 @@
 #pragma once
 
 #include "pch.h"
+#include "Quat.h"
 
 struct Frame
 {
 public:
-    Mat4 ObjectToWorldTransform;
+    Mat4 ObjectToParentTransform;
     Mat4 ViewTransform;
+    // Decomposed transforms, interpolated between keyframes
+    TRS ObjectToParentTRS;
+    TRS ViewTRS;
     int FrameNum;
     int OriginalFrame;
 
-    Vec4 Translation;
-    Vec4 Scale;
-    Vec4 Rotation;
-
-    bool Action[3];
-    int Space;
-
     Frame()
-        : FrameNum(0), OriginalFrame(0), Space(ID_SPACE_OBJECT)
-    {
-        Action[0] = Action[1] = Action[2] = true;
-    }
+        : FrameNum(0), OriginalFrame(0) {}
 };
 
 class Animation
@@ -48,7 +42,7 @@ public:
 
 private:
     Frame* GetFrameLinearInterpolation(Frame* before, Frame* after, int frame) const;
-    Frame* GetFrameLinearInterpolation2(Frame* before, Frame* after, int frame) const;
+    Frame* GetFrameTRSInterpolation(Frame* before, Frame* after, int frame) const;
     Frame* GetFrameBezierInterpolationPW(Frame* before, Frame* after, int frame) const;
     Frame* GetFrameBezierInterpolation(int frame) const;
 
@@ -0,0 +1,180 @@
+#include "AttributeCompression.h"
+
+#include <cstring>
+
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
+#define QUANTIZED_STEPS 65535.0
+#define SNORM16_MAX 32767.0
+
+static double SignNotZero(double value)
+{
+    return (value >= 0.0) ? 1.0 : -1.0;
+}
+
+static uint16_t EncodeSnorm16(double value)
+{
+    double clamped = std::min(std::max(value, -1.0), 1.0);
+    return (uint16_t)(int16_t)lround(clamped * SNORM16_MAX);
+}
+
+static double DecodeSnorm16(uint16_t value)
+{
+    return std::max((int16_t)value / SNORM16_MAX, -1.0);
+}
+
+void AttributeCompression::QuantizePositions(const std::vector<Vec4>& positions, QuantizedPointStream& quantized)
+{
+    Vec4 minDimensions(0.0, 0.0, 0.0);
+    Vec4 maxDimensions(0.0, 0.0, 0.0);
+    if (!positions.empty())
+    {
+        minDimensions = positions[0];
+        maxDimensions = positions[0];
+    }
+    for (const Vec4& pos : positions)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            minDimensions[i] = std::min(minDimensions[i], pos[i]);
+            maxDimensions[i] = std::max(maxDimensions[i], pos[i]);
+        }
+    }
+
+    quantized.Offset = Vec4(minDimensions[0], minDimensions[1], minDimensions[2]);
+    quantized.Step = Vec4(0.0, 0.0, 0.0, 0.0);
+    double inverseSteps[3] = { 0.0, 0.0, 0.0 };
+    for (int i = 0; i < 3; i++)
+    {
+        double extent = maxDimensions[i] - minDimensions[i];
+        if (extent > 0.0)
+        {
+            quantized.Step[i] = extent / QUANTIZED_STEPS;
+            inverseSteps[i] = QUANTIZED_STEPS / extent;
+        }
+    }
+
+    std::vector<uint16_t>* axes[3] = { &quantized.X, &quantized.Y, &quantized.Z };
+    for (int i = 0; i < 3; i++)
+    {
+        std::vector<uint16_t>& values = *axes[i];
+        values.resize(positions.size());
+        for (size_t v = 0; v < positions.size(); v++)
+        {
+            double steps = (positions[v][i] - minDimensions[i]) * inverseSteps[i];
+            values[v] = (uint16_t)std::min(lround(steps), (long)QUANTIZED_STEPS);
+        }
+    }
+}
+
+uint32_t AttributeCompression::EncodeNormal(const Vec4& normal)
+{
+    // Project on the octahedron |x| + |y| + |z| = 1, the lower half is
+    // folded over the diagonals
+    double length = abs(normal[0]) + abs(normal[1]) + abs(normal[2]);
+    if (length == 0.0)
+        return EncodeNormal(Vec4(0.0, 0.0, 1.0, 0.0));
+
+    double x = normal[0] / length;
+    double y = normal[1] / length;
+    if (normal[2] < 0.0)
+    {
+        double foldedX = (1.0 - abs(y)) * SignNotZero(x);
+        double foldedY = (1.0 - abs(x)) * SignNotZero(y);
+        x = foldedX;
+        y = foldedY;
+    }
+
+    return (uint32_t)EncodeSnorm16(x) | ((uint32_t)EncodeSnorm16(y) << 16);
+}
+
+Vec4 AttributeCompression::DecodeNormal(uint32_t encoded)
+{
+    double x = DecodeSnorm16((uint16_t)(encoded & 0xFFFF));
+    double y = DecodeSnorm16((uint16_t)(encoded >> 16));
+    double z = 1.0 - abs(x) - abs(y);
+    if (z < 0.0)
+    {
+        double unfoldedX = (1.0 - abs(y)) * SignNotZero(x);
+        double unfoldedY = (1.0 - abs(x)) * SignNotZero(y);
+        x = unfoldedX;
+        y = unfoldedY;
+    }
+
+    double length = sqrt(x * x + y * y + z * z);
+    return Vec4(x / length, y / length, z / length, 0.0);
+}
+
+uint32_t AttributeCompression::EncodeTexCoord(const Vec4& texCoord)
+{
+    return (uint32_t)FloatToHalf((float)texCoord[0]) | ((uint32_t)FloatToHalf((float)texCoord[1]) << 16);
+}
+
+Vec4 AttributeCompression::DecodeTexCoord(uint32_t encoded)
+{
+    return Vec4(HalfToFloat((uint16_t)(encoded & 0xFFFF)), HalfToFloat((uint16_t)(encoded >> 16)), 0.0, 0.0);
+}
+
+uint16_t AttributeCompression::FloatToHalf(float value)
+{
+#ifdef __F16C__
+    return _cvtss_sh(value, 0);
+#else
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    // NaN, then too large for a half
+    if ((bits & 0x7FFFFFFF) > 0x7F800000)
+        return sign | 0x7E00;
+    if (exponent >= 31)
+        return sign | 0x7C00;
+
+    // Denormal or too small for a half
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+            return sign;
+
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        uint16_t half = (uint16_t)(mantissa >> shift);
+        if ((mantissa >> (shift - 1)) & 1)
+            half++;
+        return sign | half;
+    }
+
+    // Rounding up may carry into the exponent, which is still correct
+    uint16_t half = (uint16_t)((exponent << 10) | (mantissa >> 13));
+    if (mantissa & 0x1000)
+        half++;
+    return sign | half;
+#endif
+}
+
+float AttributeCompression::HalfToFloat(uint16_t value)
+{
+#ifdef __F16C__
+    return _cvtsh_ss(value);
+#else
+    uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1F;
+    uint32_t mantissa = value & 0x3FF;
+
+    if (exponent == 0)
+    {
+        float result = ldexpf((float)mantissa, -24);
+        return sign ? -result : result;
+    }
+
+    uint32_t bits = (exponent == 31) ? (sign | 0x7F800000 | (mantissa << 13)) : 
+        (sign | ((exponent + 112) << 23) | (mantissa << 13));
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "pch.h"
+#include <cstdint>
+
+// Positions as 16 bit steps from the low corner of the bounds they were
+// quantized in, a position is Offset + q * Step on every axis
+struct QuantizedPointStream
+{
+    std::vector<uint16_t> X;
+    std::vector<uint16_t> Y;
+    std::vector<uint16_t> Z;
+    Vec4 Offset;
+    Vec4 Step;
+
+    size_t Size() const { return X.size(); }
+    Vec4 Get(size_t i) const 
+    { 
+        return Vec4(Offset[0] + X[i] * Step[0], Offset[1] + Y[i] * Step[1], Offset[2] + Z[i] * Step[2]); 
+    }
+    // Maps the quantized values to the positions, for Mat4::TransformQuantizedPoints
+    Mat4 GetDecodeTransform() const { return Mat4::Scale(Step[0], Step[1], Step[2]) * Mat4::Translate(Offset); }
+};
+
+// Compact encodings of vertex attributes for meshes too large to keep as Vec4s
+class AttributeCompression
+{
+public:
+    // Quantizes to the bounds of the positions
+    static void QuantizePositions(const std::vector<Vec4>& positions, QuantizedPointStream& quantized);
+
+    // Octahedral mapping of a unit vector to two 16 bit signed fractions
+    static uint32_t EncodeNormal(const Vec4& normal);
+    static Vec4 DecodeNormal(uint32_t encoded);
+
+    // u and v as half floats
+    static uint32_t EncodeTexCoord(const Vec4& texCoord);
+    static Vec4 DecodeTexCoord(uint32_t encoded);
+
+    static uint16_t FloatToHalf(float value);
+    static float HalfToFloat(uint16_t value);
+};
\ No newline at end of file
@@ -44,7 +44,7 @@ void Camera::SetOrthographic(double left, double right, double top, double botto
     isPerspective = false;
 
     // Build Inverse projection matrix
-    buildInverseOrthographic(left, right, top, bottom, near, far);
+    orthoInverseProjection = Mat4::Inverse(orthoProjection);
 }
 
 void Camera::SetOrthographic(double width, double aspectRatio, double near, double far)
@@ -57,24 +57,6 @@ void Camera::SetOrthographic(double width, double aspectRatio, double near, doub
         near, far);
 }
 
-void Camera::buildInverseOrthographic(double left, double right, double top, double bottom,
-    double near, double far)
-{
-    // Create OpenGL Orthographic Inverse Matrix
-    Mat4 result;
-    result[0][0] = -(right - left) / 2.0;
-    result[1][1] = -(top - bottom) / 2.0;
-    result[2][2] = -(far - near) /  2.0;
-    result[0][3] = (right + left) / 2.0;
-    result[1][3] = (top + bottom) / 2.0;
-    result[2][3] = (far + near) / 2.0;
-
-    // Transform matrix to be row major
-    result.Transpose();
-
-    orthoInverseProjection = result;
-}
-
 void Camera::SetPerspective(double left, double right, double top, double bottom,
     double near, double far)
 {
@@ -107,7 +89,7 @@ void Camera::SetPerspective(double left, double right, double top, double bottom
     isPerspective = true;
 
     // Build Inverse projection matrix
-    buildInversePerspective(left, right, top, bottom, near, far);
+    perspInverseProjection = Mat4::Inverse(perspProjection);
 }
 
 void Camera::SetPerspective(double fov, double aspectRatio, double near, double far)
@@ -182,6 +164,7 @@ void Camera::ZoomCamera(double zoomOffset)
     {
         orthoProjection = Mat4::Scale(1.0 - zoomOffset / Settings::MouseSensitivity[1]) * 
             orthoProjection;
+        orthoInverseProjection = Mat4::Inverse(orthoProjection);
     }
 }
 
@@ -228,24 +211,4 @@ void Camera::SwitchToProjection(bool perspective)
 const Mat4& Camera::GetWorldToViewTransform() const
 {
     return worldToView;
-}
-
-void Camera::buildInversePerspective(double left, double right, double top, double bottom,
-    double near, double far)
-{
-    // Create OpenGL Perspective Inverse Matrix
-    Mat4 result;
-    result[0][0] = (right - left) / (2.0 * near);
-    result[1][1] = (top - bottom) / (2.0 * near);
-    result[2][2] = 0.0;
-    result[3][3] = (far + near) / (2 * far * near);
-    result[0][3] = (right + left) / (2 * near);
-    result[1][3] = (top + bottom) / (2 * near);
-    result[2][3] = -1.0;
-    result[3][2] = -(far - near) / (2.0 * far * near);
-
-    // Transform matrix to be row major
-    result.Transpose();
-
-    perspInverseProjection = result;
-}
+}
\ No newline at end of file
@@ -78,12 +78,6 @@ public:
 
     const Mat4& GetWorldToViewTransform() const;
 
-private:
-    void buildInversePerspective(double left, double right, double top, double bottom,
-        double near, double far);
-    void buildInverseOrthographic(double left, double right, double top, double bottom,
-        double near, double far);
-
 private:
     Mat4 orthoProjection;
     Mat4 orthoInverseProjection;
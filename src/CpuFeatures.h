@@ -0,0 +1,27 @@
+#pragma once
+
+// Kernels for instruction sets above the build's target are compiled with a
+// target attribute and only called when the CPU reports the feature, so a
+// build for the x86-64 baseline still runs them where they are supported.
+// Building with ARCHFLAGS=-march=native makes the checks constant,
+// CPU_NO_KERNELS leaves only the scalar code.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(CPU_NO_KERNELS)
+#define CPU_AVX_KERNELS
+#define CPU_TARGET_AVX __attribute__((target("avx")))
+#endif
+
+class CpuFeatures
+{
+public:
+    static bool HasAvx()
+    {
+#if !defined(CPU_AVX_KERNELS)
+        return false;
+#elif defined(__AVX__)
+        return true;
+#else
+        static const bool hasAvx = __builtin_cpu_supports("avx");
+        return hasAvx;
+#endif
+    }
+};
\ No newline at end of file
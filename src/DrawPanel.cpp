@@ -1,9 +1,14 @@
 #include "DrawPanel.h"
 #include "Scene.h"
 
+// Keyframes are interpolated along the shorter arc, so a rotation adds one
+// every time it turns this far. Three axes together still turn less than
+// 180 degrees between keyframes.
+#define MAX_KEYFRAME_ROTATION 45.0
+
 DrawPanel::DrawPanel(wxFrame* parent)
     : wxPanel(parent), m_IsMouseLeftButtonClicked(false), 
-      m_IsMouseMiddleButtonClicked(false), m_Offsets(Vec4(0.0, 1.0, 0.0))
+      m_IsMouseMiddleButtonClicked(false), m_KeyFrameAngle(0.0)
 {
     Connect(wxEVT_PAINT, wxPaintEventHandler(DrawPanel::OnPaint));
     Connect(wxEVT_ERASE_BACKGROUND, wxEraseEventHandler(DrawPanel::OnEraseBackground));
@@ -49,7 +54,7 @@ void DrawPanel::OnMouseLeftClick(wxMouseEvent& event)
     if (Settings::IsRecording)
     {
         m_MouseDownTicks = clock();
-        m_Offsets = Vec4(0.0, 1.0, 0.0);
+        m_KeyFrameAngle = 0.0;
     }
 
     if (Settings::SelectedAction == ID_ACTION_SELECT)
@@ -93,9 +98,6 @@ void DrawPanel::OnMouseMove(wxMouseEvent& event)
     {
         if (Settings::SelectedAction == ID_ACTION_TRANSLATE)
         {
-            double offset = dx / Settings::MouseSensitivity[0];
-            m_Offsets[0] += offset;
-
             Vec4 offsets;
             if (Settings::SelectedAxis[0]) offsets[0] = dx / Settings::MouseSensitivity[0];
             if (Settings::SelectedAxis[1]) offsets[1] = -dy / Settings::MouseSensitivity[0];
@@ -112,8 +114,7 @@ void DrawPanel::OnMouseMove(wxMouseEvent& event)
             double scale = 1.0 + dx / Settings::MouseSensitivity[1];
             if (scale < Settings::MinScaleFactor)
                 scale = Settings::MinScaleFactor;
-            m_Offsets[1] *= scale;
-            
+
             if (Settings::SelectedAxis[0])
             {
                 SCENE.GetSelectedModel()->Scale(Mat4::Scale(scale, 1.0, 1.0), Settings::SelectedSpace);
@@ -130,7 +131,6 @@ void DrawPanel::OnMouseMove(wxMouseEvent& event)
         else if (Settings::SelectedAction == ID_ACTION_ROTATE)
         {
             double angle = dx / Settings::MouseSensitivity[2];
-            m_Offsets[2] += angle;
             if (Settings::SelectedAxis[0])
             {
                 SCENE.GetSelectedModel()->Rotate(Mat4::RotateX(angle), Settings::SelectedSpace);
@@ -143,6 +143,15 @@ void DrawPanel::OnMouseMove(wxMouseEvent& event)
             {
                 SCENE.GetSelectedModel()->Rotate(Mat4::RotateZ(angle), Settings::SelectedSpace);
             }
+
+            m_KeyFrameAngle += angle;
+            if (Settings::IsRecording && (abs(m_KeyFrameAngle) >= MAX_KEYFRAME_ROTATION))
+            {
+                clock_t ticks = clock();
+                SCENE.AddKeyFrame((double)(ticks - m_MouseDownTicks) / CLOCKS_PER_SEC);
+                m_MouseDownTicks = ticks;
+                m_KeyFrameAngle = 0.0;
+            }
         }
     }
     if (m_IsMouseMiddleButtonClicked)
@@ -181,7 +190,7 @@ void DrawPanel::OnMouseLeftRelease(wxMouseEvent& event)
         clock_t ticksDiff = clock() - m_MouseDownTicks;
         double timeDiff = (double)ticksDiff / CLOCKS_PER_SEC;
 
-        SCENE.AddKeyFrame(timeDiff, m_Offsets);
+        SCENE.AddKeyFrame(timeDiff);
     }
 }
 
@@ -27,6 +27,7 @@ private:
     bool m_IsMouseLeftButtonClicked;
     bool m_IsMouseMiddleButtonClicked;
 
+    // Time and degrees rotated since the last keyframe while recording
     clock_t m_MouseDownTicks;
-    Vec4 m_Offsets;
+    double m_KeyFrameAngle;
 };
\ No newline at end of file
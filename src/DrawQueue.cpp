@@ -0,0 +1,112 @@
+#include "DrawQueue.h"
+
+#define DRAW_ITEM_RANK_BITS 24
+#define DRAW_PACKET_DEPTH_BITS 16
+
+// Maps depth in [min, max] to [0, 2^bits - 1]
+static uint64_t QuantizeDepth(double depth, double min, double max, int bits)
+{
+    uint64_t top = (1ULL << bits) - 1;
+    if (!(max > min))
+        return 0;
+
+    double t = (depth - min) / (max - min);
+    return (uint64_t)(std::min(std::max(t, 0.0), 1.0) * top);
+}
+
+void DrawQueue::Clear()
+{
+    items.clear();
+    packets.clear();
+}
+
+unsigned int DrawQueue::AddItem(const DrawItem& item)
+{
+    items.push_back(item);
+    return items.size() - 1;
+}
+
+void DrawQueue::AddPacket(unsigned int item, const Geometry* geo, unsigned int geometryIndex, 
+    double depth)
+{
+    DrawPacket packet;
+    packet.Key = 0;
+    packet.Geo = geo;
+    packet.GeometryIndex = geometryIndex;
+    packet.Item = item;
+    packet.Depth = (float)depth;
+    packets.push_back(packet);
+}
+
+void DrawQueue::BuildKeys(DrawSortMode mode)
+{
+    // Items are ranked front to back, ranks are unique so two items' packets
+    // never mix
+    std::vector<unsigned int> order(items.size());
+    for (unsigned int i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [this](unsigned int a, unsigned int b)
+    {
+        return (items[a].Depth < items[b].Depth) || ((items[a].Depth == items[b].Depth) && (a < b));
+    });
+    std::vector<uint64_t> ranks(items.size());
+    for (unsigned int i = 0; i < order.size(); i++)
+        ranks[order[i]] = i;
+
+    // Geometry depths are spread over the range of their own item
+    std::vector<float> minPacketDepths(items.size(), std::numeric_limits<float>::max());
+    std::vector<float> maxPacketDepths(items.size(), -std::numeric_limits<float>::max());
+    for (const DrawPacket& packet : packets)
+    {
+        if (packet.Geo == NULL)
+            continue;
+        minPacketDepths[packet.Item] = std::min(minPacketDepths[packet.Item], packet.Depth);
+        maxPacketDepths[packet.Item] = std::max(maxPacketDepths[packet.Item], packet.Depth);
+    }
+
+    for (DrawPacket& packet : packets)
+    {
+        const DrawItem& item = items[packet.Item];
+        uint64_t material = 0;
+        if (mode == DRAW_SORT_MATERIAL)
+            material = ((uint64_t)item.Color.Red() << 16) | (item.Color.Green() << 8) | item.Color.Blue();
+
+        // The item's last packet gets the largest depth
+        uint64_t packetDepth = (1ULL << DRAW_PACKET_DEPTH_BITS) - 1;
+        if (packet.Geo != NULL)
+        {
+            packetDepth = QuantizeDepth(packet.Depth, minPacketDepths[packet.Item], 
+                maxPacketDepths[packet.Item], DRAW_PACKET_DEPTH_BITS - 1);
+        }
+
+        packet.Key = (material << (DRAW_ITEM_RANK_BITS + DRAW_PACKET_DEPTH_BITS)) | 
+            (ranks[packet.Item] << DRAW_PACKET_DEPTH_BITS) | packetDepth;
+    }
+}
+
+void DrawQueue::Sort(DrawSortMode mode)
+{
+    BuildKeys(mode);
+
+    // Least significant byte first, each pass is stable. Bytes every key
+    // shares are skipped, the material bytes when sorting by depth.
+    sorted.resize(packets.size());
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        size_t counts[257] = { 0 };
+        for (const DrawPacket& packet : packets)
+            counts[((packet.Key >> shift) & 0xff) + 1]++;
+
+        bool isShared = false;
+        for (int b = 1; (b <= 256) && !isShared; b++)
+            isShared = counts[b] == packets.size();
+        if (isShared)
+            continue;
+
+        for (int b = 1; b <= 256; b++)
+            counts[b] += counts[b - 1];
+        for (const DrawPacket& packet : packets)
+            sorted[counts[(packet.Key >> shift) & 0xff]++] = packet;
+        packets.swap(sorted);
+    }
+}
\ No newline at end of file
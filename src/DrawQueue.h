@@ -0,0 +1,69 @@
+#pragma once
+
+#include "pch.h"
+#include "Model.h"
+#include <cstdint>
+
+enum DrawSortMode
+{
+    DRAW_SORT_FRONT_TO_BACK,
+    DRAW_SORT_MATERIAL
+};
+
+// A model to draw this frame, with everything its packets share
+struct DrawItem
+{
+    Model* Source;
+    Mat4 ObjectToView;
+    Mat4 NormalToView;
+    Mat4 ObjectToClip;
+    // Object space frustum planes and eye, see Scene::GetObjectSpaceEye
+    Vec4 Planes[4];
+    Vec4 Eye;
+    wxColour Color;
+    bool AreLodsReady;
+    // View depth of the bounds center, larger is farther
+    double Depth;
+};
+
+// One geometry of an item. Every item also has a packet without a geometry,
+// sorted after its geometries, for the model's bounding box and origin.
+struct DrawPacket
+{
+    uint64_t Key;
+    const Geometry* Geo;
+    // Index of Geo in the item's model
+    unsigned int GeometryIndex;
+    unsigned int Item;
+    float Depth;
+};
+
+// Flat list of the frame's draw packets. Packets are sorted by a 64 bit key
+// with a radix sort: the item's material when sorting by material, then the
+// item's rank by depth, then the geometry's depth within the item. An item's
+// packets stay together so its vertices are transformed once.
+class DrawQueue
+{
+public:
+    void Clear();
+
+    // Returns the item's index
+    unsigned int AddItem(const DrawItem& item);
+    // geo NULL for the item's last packet
+    void AddPacket(unsigned int item, const Geometry* geo, unsigned int geometryIndex = 0, 
+        double depth = 0.0);
+
+    void Sort(DrawSortMode mode);
+
+    const std::vector<DrawPacket>& GetPackets() const { return packets; }
+    const DrawItem& GetItem(unsigned int index) const { return items[index]; }
+    unsigned int GetItemCount() const { return items.size(); }
+
+private:
+    void BuildKeys(DrawSortMode mode);
+
+private:
+    std::vector<DrawItem> items;
+    std::vector<DrawPacket> packets;
+    std::vector<DrawPacket> sorted;
+};
\ No newline at end of file
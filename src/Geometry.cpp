@@ -1,30 +1,145 @@
 #include "Geometry.h"
 
+Geometry::Geometry()
+    : BoundingBox(NULL)
+{
+    PolygonOffsets.push_back(0);
+    ClusterOffsets.push_back(0);
+}
+
 Geometry::~Geometry()
 {
-    // Delete BBox verticies and polygons
-    while (BoundingBoxPolygons.size() > 0)
-    {
-        Polygon* poly = BoundingBoxPolygons.back();
-        BoundingBoxPolygons.pop_back();
+    delete BoundingBox;
+
+    for (Geometry* lod : Lods)
+        delete lod;
+}
+
+unsigned int Geometry::AddVertex(int posID, int texCoordID, int normalID)
+{
+    VertexPositionIDs.push_back(posID);
+    VertexTexCoordIDs.push_back(texCoordID);
+    VertexNormalIDs.push_back(normalID);
+
+    return VertexPositionIDs.size() - 1;
+}
 
-        for (Vertex* it : poly->Vertices)
-            delete it;
+void Geometry::EndPolygon(const Vec4& normal, const Vec4& center)
+{
+    PolygonOffsets.push_back(PolygonVertices.size());
+    PolygonNormals.push_back(normal);
+    PolygonCenters.push_back(center);
+}
+
+size_t Geometry::GetMemoryUsage() const
+{
+    size_t bytes = sizeof(Geometry) + 
+        GetVectorBytes(VertexPositionIDs) + GetVectorBytes(VertexTexCoordIDs) + 
+        GetVectorBytes(VertexNormalIDs) + GetVectorBytes(PolygonOffsets) + 
+        GetVectorBytes(PolygonVertices) + GetVectorBytes(PolygonNormals) + 
+        GetVectorBytes(PolygonCenters) + GetVectorBytes(PolygonFaces) + 
+        GetVectorBytes(PolygonEdges) + GetVectorBytes(VertexPolygonOffsets) + 
+        GetVectorBytes(VertexPolygons) + GetVectorBytes(ClusterOffsets) + 
+        GetVectorBytes(ClusterSpheres) + GetVectorBytes(ClusterCones);
+
+    if (BoundingBox != NULL)
+        bytes += BoundingBox->GetMemoryUsage();
+
+    return bytes;
+}
+
+void Geometry::BuildAdjacency()
+{
+    unsigned int vertexCount = GetVertexCount();
 
-        delete poly;
+    // Count the polygons of every vertex
+    VertexPolygonOffsets.assign(vertexCount + 1, 0);
+    for (unsigned int v : PolygonVertices)
+        VertexPolygonOffsets[v + 1]++;
+
+    for (unsigned int v = 0; v < vertexCount; v++)
+        VertexPolygonOffsets[v + 1] += VertexPolygonOffsets[v];
+
+    // Fill, polygons of a vertex end up in increasing order
+    std::vector<unsigned int> next(VertexPolygonOffsets.begin(), VertexPolygonOffsets.end() - 1);
+    VertexPolygons.resize(PolygonVertices.size());
+    for (unsigned int p = 0; p < GetPolygonCount(); p++)
+    {
+        for (unsigned int i = PolygonOffsets[p]; i < PolygonOffsets[p + 1]; i++)
+            VertexPolygons[next[PolygonVertices[i]]++] = p;
     }
+}
 
-    // Delete vertices
-    for (auto& it : Vertices)
+void Geometry::ReorderPolygons(const std::vector<unsigned int>& order)
+{
+    unsigned int polygonCount = GetPolygonCount();
+    assert(order.size() == polygonCount);
+
+    std::vector<unsigned int> offsets;
+    std::vector<unsigned int> vertices;
+    std::vector<Vec4> normals(polygonCount);
+    std::vector<Vec4> centers(polygonCount);
+    offsets.reserve(polygonCount + 1);
+    vertices.reserve(PolygonVertices.size());
+    offsets.push_back(0);
+
+    for (unsigned int i = 0; i < polygonCount; i++)
     {
-        delete it.second;
+        unsigned int p = order[i];
+        vertices.insert(vertices.end(), PolygonVertices.begin() + PolygonOffsets[p], 
+            PolygonVertices.begin() + PolygonOffsets[p + 1]);
+        offsets.push_back(vertices.size());
+        normals[i] = PolygonNormals[p];
+        centers[i] = PolygonCenters[p];
     }
-    
-    // Delete polygons
-    while (Polygons.size() > 0)
+
+    PolygonOffsets.swap(offsets);
+    PolygonVertices.swap(vertices);
+    PolygonNormals.swap(normals);
+    PolygonCenters.swap(centers);
+
+    if (IsTriangulated())
     {
-        Polygon* poly = Polygons.back();
-        Polygons.pop_back();
-        delete poly;
+        std::vector<unsigned int> faces(polygonCount);
+        std::vector<unsigned char> edges(polygonCount);
+        for (unsigned int i = 0; i < polygonCount; i++)
+        {
+            faces[i] = PolygonFaces[order[i]];
+            edges[i] = PolygonEdges[order[i]];
+        }
+        PolygonFaces.swap(faces);
+        PolygonEdges.swap(edges);
     }
+
+    ClusterOffsets.assign(1, 0);
+    ClusterSpheres.clear();
+    ClusterCones.clear();
+
+    if (!VertexPolygonOffsets.empty())
+        BuildAdjacency();
 }
+
+void Geometry::ReorderVertices(const std::vector<unsigned int>& remap)
+{
+    unsigned int vertexCount = GetVertexCount();
+    assert(remap.size() == vertexCount);
+
+    std::vector<int> positionIDs(vertexCount);
+    std::vector<int> texCoordIDs(vertexCount);
+    std::vector<int> normalIDs(vertexCount);
+    for (unsigned int v = 0; v < vertexCount; v++)
+    {
+        positionIDs[remap[v]] = VertexPositionIDs[v];
+        texCoordIDs[remap[v]] = VertexTexCoordIDs[v];
+        normalIDs[remap[v]] = VertexNormalIDs[v];
+    }
+    VertexPositionIDs.swap(positionIDs);
+    VertexTexCoordIDs.swap(texCoordIDs);
+    VertexNormalIDs.swap(normalIDs);
+
+    for (unsigned int& v : PolygonVertices)
+        v = remap[v];
+
+    if (!VertexPolygonOffsets.empty())
+        BuildAdjacency();
+}
\ No newline at end of file
@@ -1,40 +1,82 @@
 #pragma once
 
 #include "pch.h"
-#include <unordered_map>
 
-// Forward decleration
-struct Vertex;
-
-struct Polygon
-{
-    std::vector<Vertex*> Vertices;
-    Vec4 Normal;
-    Vec4 Center;
-};
-
-struct Vertex
+// Bytes allocated by a vector
+template <typename T>
+inline size_t GetVectorBytes(const std::vector<T>& v)
 {
-    int PositionID;
-    int TexCoordID;
-    int NormalID;
-    std::vector<Polygon*> NeighborPolys;
-
-    Vertex(int posID = -1, int texCoordID = -1, int normalID = -1)
-        : PositionID(posID), TexCoordID(texCoordID), NormalID(normalID) {}
-};
+    return v.capacity() * sizeof(T);
+}
 
+// Polygon mesh stored in flat arrays. Vertices are local to the geometry
+// and refer to the model's position, texture coordinate and normal arrays.
+// Polygon p uses PolygonVertices[PolygonOffsets[p]] to
+// PolygonVertices[PolygonOffsets[p + 1] - 1], and vertex v is used by
+// VertexPolygons[VertexPolygonOffsets[v]] to VertexPolygons[VertexPolygonOffsets[v + 1] - 1].
+// A triangulated geometry has only triangles and remembers the face each
+// one came from. Polygons are grouped in clusters of neighbours, cluster c
+// is polygons ClusterOffsets[c] to ClusterOffsets[c + 1] - 1.
 class Geometry
 {
 public:
-    Geometry() {}
+    Geometry();
     ~Geometry();
 
+    Geometry(Geometry const&) = delete;
+    void operator=(Geometry const&) = delete;
+
+    unsigned int GetVertexCount() const { return VertexPositionIDs.size(); }
+    unsigned int GetPolygonCount() const { return PolygonOffsets.size() - 1; }
+    unsigned int GetPolygonSize(unsigned int p) const { return PolygonOffsets[p + 1] - PolygonOffsets[p]; }
+    const unsigned int* GetPolygonVertices(unsigned int p) const { return &PolygonVertices[PolygonOffsets[p]]; }
+    bool IsTriangulated() const { return !PolygonFaces.empty(); }
+    unsigned int GetClusterCount() const { return ClusterOffsets.size() - 1; }
+
+    unsigned int AddVertex(int posID, int texCoordID = -1, int normalID = -1);
+    // Closes the polygon made of the vertices added to PolygonVertices since the last one
+    void EndPolygon(const Vec4& normal, const Vec4& center);
+
+    // Bytes allocated for the geometry, its arrays and its bounding box
+    size_t GetMemoryUsage() const;
+
+    // Builds the vertex to polygon adjacency from the polygons
+    void BuildAdjacency();
+
+    // order[i] is the polygon to move to position i. Clusters are dropped.
+    void ReorderPolygons(const std::vector<unsigned int>& order);
+    // remap[v] is the new index of vertex v
+    void ReorderVertices(const std::vector<unsigned int>& remap);
+
 public:
-    std::vector<Polygon*> Polygons;
-    std::unordered_map<int, Vertex*> Vertices;
+    std::vector<int> VertexPositionIDs;
+    std::vector<int> VertexTexCoordIDs;
+    std::vector<int> VertexNormalIDs;
+
+    std::vector<unsigned int> PolygonOffsets;
+    std::vector<unsigned int> PolygonVertices;
+    std::vector<Vec4> PolygonNormals;
+    std::vector<Vec4> PolygonCenters;
+
+    // Triangulated geometries only: source face of every triangle, and which
+    // triangle edges (bit i for vertex i to i + 1) are edges of that face
+    std::vector<unsigned int> PolygonFaces;
+    std::vector<unsigned char> PolygonEdges;
+
+    std::vector<unsigned int> VertexPolygonOffsets;
+    std::vector<unsigned int> VertexPolygons;
+
+    // Bounding sphere (w is the radius) and normal cone (w is the sine of
+    // its half angle, 1 if it is 90 degrees or more) of every cluster
+    std::vector<unsigned int> ClusterOffsets;
+    std::vector<Vec4> ClusterSpheres;
+    std::vector<Vec4> ClusterCones;
 
     Vec4 MaxDimensions;
     Vec4 MinDimensions;
-    std::vector<Polygon*> BoundingBoxPolygons;
+    Geometry* BoundingBox;
+
+    // Simplified versions, each with about a quarter of the polygons of the
+    // previous one. The level drawn is kept by each model using the geometry.
+    std::vector<Geometry*> Lods;
 };
\ No newline at end of file
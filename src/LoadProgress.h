@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <cstddef>
+
+class ModelPreview;
+
+// Progress of one model load, shared between the thread loading it and the
+// threads watching it. Parser threads add the bytes they parsed as they go.
+struct LoadProgress
+{
+    std::atomic<size_t> BytesRead;
+    std::atomic<size_t> TotalBytes;
+    std::atomic<bool> IsCancelled;
+
+    // Called after every block with the totals so far. Runs on the loading
+    // threads, possibly on several of them at once.
+    std::function<void(size_t bytesRead, size_t totalBytes)> Callback;
+
+    // Partial geometry is published here as it's parsed, if set
+    ModelPreview* Preview;
+
+    LoadProgress() : BytesRead(0), TotalBytes(0), IsCancelled(false), Preview(NULL) {}
+
+    void AddBytes(size_t bytes)
+    {
+        size_t bytesRead = BytesRead.fetch_add(bytes) + bytes;
+        if (Callback)
+            Callback(bytesRead, TotalBytes.load());
+    }
+};
+
+// Progress may be NULL for loads nobody watches
+inline bool IsLoadCancelled(const LoadProgress* progress)
+{
+    return (progress != NULL) && progress->IsCancelled.load();
+}
\ No newline at end of file
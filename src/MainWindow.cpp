@@ -24,22 +24,83 @@ MainWindow::MainWindow(const wxString& title)
     Centre();
 }
 
+MainWindow::~MainWindow()
+{
+    // Loads still running would call back into this window
+    SCENE.CancelLoadingModels(true);
+}
+
 /**************************** Event Handlers ****************************/
 void MainWindow::OnOpenFile(wxCommandEvent& event)
 {
     wxFileDialog* fileDialog = new wxFileDialog(this, wxT("Open a model"), wxT(""), wxT(""),
-                       wxT("OBJ files (*.obj)|*.obj"), wxFD_OPEN | wxFD_FILE_MUST_EXIST);
+                       wxT("Model files (*.obj;*.stl;*.ply)|*.obj;*.stl;*.ply|OBJ files (*.obj)|*.obj|STL files (*.stl)|*.stl|PLY files (*.ply)|*.ply"), wxFD_OPEN | wxFD_FILE_MUST_EXIST | wxFD_MULTIPLE);
 
     if (fileDialog->ShowModal() == wxID_OK)
     {
-        m_ModelFileName = fileDialog->GetPath();
-        std::string stlstring = std::string(m_ModelFileName.mb_str());
-        if (Scene::GetInstance().LoadModelFromFile(stlstring))
+        wxArrayString paths;
+        fileDialog->GetPaths(paths);
+
+        // Every file loads on its own thread, the scene keeps drawing meanwhile.
+        // The callbacks run on the loading threads and hand over to this one.
+        for (const wxString& path : paths)
         {
-            wxMessageDialog *dial = new wxMessageDialog(NULL, 
-            wxT("Model was loaded successfully"), wxT("Info"), wxOK | wxICON_INFORMATION);
-            dial->ShowModal();
+            m_ModelFileName = path;
+            std::string stlstring = std::string(path.mb_str());
+            SCENE.StartLoadingModel(stlstring, 
+                [this](unsigned int id, size_t bytesRead, size_t totalBytes) 
+                { 
+                    CallAfter(&MainWindow::OnLoadingProgress); 
+                },
+                [this](unsigned int id) 
+                { 
+                    CallAfter(&MainWindow::OnModelLoaded); 
+                });
         }
+        OnLoadingProgress();
+    }
+}
+
+void MainWindow::OnCancelLoading(wxCommandEvent& event)
+{
+    SCENE.CancelLoadingModels();
+    SetStatusText(wxT("Cancelling..."), 0);
+}
+
+void MainWindow::OnCancelLoadingUI(wxUpdateUIEvent& event)
+{
+    event.Enable(SCENE.GetLoadingModelCount() > 0);
+}
+
+void MainWindow::OnLoadingProgress()
+{
+    unsigned int count = SCENE.GetLoadingModelCount();
+    if (count == 0)
+    {
+        SetStatusText(wxT("Ready"), 0);
+        return;
+    }
+
+    size_t bytesRead, totalBytes;
+    SCENE.GetLoadingProgress(bytesRead, totalBytes);
+    int percentage = (totalBytes > 0) ? (int)(100.0 * bytesRead / totalBytes) : 0;
+    SetStatusText(wxString::Format(wxT("Loading %u model(s): %d%%"), count, percentage), 0);
+
+    // Show the geometry that has arrived so far
+    if (SCENE.UpdateLoadingPreviews())
+    {
+        INVALIDATE();
+    }
+}
+
+void MainWindow::OnModelLoaded()
+{
+    unsigned int count = SCENE.AddLoadedModels();
+    OnLoadingProgress();
+    if (count > 0)
+    {
+        INVALIDATE();
+        LOG_INFO("{0} model(s) were added to the scene.", count);
     }
 }
 
@@ -60,6 +121,9 @@ void MainWindow::OnUpdateUI(wxUpdateUIEvent& event)
     int id = event.GetId();
     switch (id)
     {
+        case ID_FILE_CANCEL_LOADING:
+            OnCancelLoadingUI(event);
+            break;
         case ID_VIEW_ORTHO:
             OnSwitchToOrthoUI(event);
             break;
@@ -99,6 +163,10 @@ void MainWindow::OnUpdateUI(wxUpdateUIEvent& event)
         case ID_ACTION_ROTATE:
             OnSelectRotateUI(event);
             break;
+        case ID_ACTION_SET_PARENT:
+        case ID_ACTION_CLEAR_PARENT:
+            OnParentUI(event);
+            break;
         case ID_AXIS_X:
         case ID_AXIS_Y:
         case ID_AXIS_Z:
@@ -255,6 +323,58 @@ void MainWindow::OnSelectRotateUI(wxUpdateUIEvent& event)
     event.Check(Settings::SelectedAction == ID_ACTION_ROTATE);
 }
 
+void MainWindow::OnSetParent(wxCommandEvent& event)
+{
+    Model* model = SCENE.GetSelectedModel();
+    if (model == nullptr)
+        return;
+
+    // Every other model, numbered in load order
+    std::vector<Model*>& models = SCENE.GetModels();
+    std::vector<Model*> parents;
+    wxArrayString choices;
+    int selection = 0;
+    for (unsigned int i = 0; i < models.size(); i++)
+    {
+        if (models[i] == model)
+            continue;
+        if (models[i] == SCENE.GetModelParent(model))
+            selection = parents.size();
+        parents.push_back(models[i]);
+        choices.Add(wxString::Format(wxT("%u: %s"), i + 1, models[i]->GetName().c_str()));
+    }
+    if (parents.empty())
+        return;
+
+    wxSingleChoiceDialog dlg(this, wxT("Parent of the selected model:"), wxT("Set Parent"), choices);
+    dlg.SetSelection(selection);
+    // A model under the selected one is refused, the scene graph logs it
+    if (dlg.ShowModal() == wxID_OK)
+    {
+        SCENE.SetModelParent(model, parents[dlg.GetSelection()]);
+        INVALIDATE();
+    }
+}
+
+void MainWindow::OnClearParent(wxCommandEvent& event)
+{
+    Model* model = SCENE.GetSelectedModel();
+    if (model == nullptr)
+        return;
+
+    SCENE.SetModelParent(model, NULL);
+    INVALIDATE();
+}
+
+void MainWindow::OnParentUI(wxUpdateUIEvent& event)
+{
+    Model* model = SCENE.GetSelectedModel();
+    if (event.GetId() == ID_ACTION_CLEAR_PARENT)
+        event.Enable((model != nullptr) && (SCENE.GetModelParent(model) != NULL));
+    else
+        event.Enable((model != nullptr) && (SCENE.GetModels().size() > 1));
+}
+
 void MainWindow::OnChangeAxis(wxCommandEvent& event)
 {
     int id = event.GetId() - ID_AXIS_X;
@@ -469,6 +589,10 @@ wxMenu* MainWindow::CreateFileMenu()
     file->Append(wxID_OPEN, wxT("&Open Model"), wxT("Open a new model file"));
     Connect(wxID_OPEN, wxEVT_COMMAND_MENU_SELECTED, 
         wxCommandEventHandler(MainWindow::OnOpenFile));
+    // Create Cancel Loading menu item and connect it
+    file->Append(ID_FILE_CANCEL_LOADING, wxT("C&ancel Loading"), wxT("Cancel the models being loaded"));
+    Connect(ID_FILE_CANCEL_LOADING, wxEVT_COMMAND_MENU_SELECTED, 
+        wxCommandEventHandler(MainWindow::OnCancelLoading));
     // Create Clear All menu item and connect it
     file->Append(ID_FILE_CLEAR_ALL, wxT("&Clear Scene"), wxT("Clear scene"));
     Connect(ID_FILE_CLEAR_ALL, wxEVT_COMMAND_MENU_SELECTED, 
@@ -499,6 +623,16 @@ wxMenu* MainWindow::CreateActionsMenu()
     CreateAxisSubMenu(actions);
     CreateSpacesSubMenu(actions);
 
+    actions->AppendSeparator();
+    actions->Append(ID_ACTION_SET_PARENT, wxT("Set &Parent..."), 
+        wxT("Attach the selected model to another model, it follows the other model's transforms"));
+    Connect(ID_ACTION_SET_PARENT, wxEVT_COMMAND_MENU_SELECTED,
+        wxCommandEventHandler(MainWindow::OnSetParent));
+    actions->Append(ID_ACTION_CLEAR_PARENT, wxT("C&lear Parent"), 
+        wxT("Detach the selected model from its parent"));
+    Connect(ID_ACTION_CLEAR_PARENT, wxEVT_COMMAND_MENU_SELECTED,
+        wxCommandEventHandler(MainWindow::OnClearParent));
+
     return actions;
 }
 
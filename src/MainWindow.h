@@ -7,12 +7,15 @@ class MainWindow : public wxFrame
 {
 public:
     MainWindow(const wxString& title);
+    ~MainWindow();
 
     void OnDrawingPanelPaint(wxPaintEvent& event);
     void OnUpdateUI(wxUpdateUIEvent& event);
 
     // File options events
     void OnOpenFile(wxCommandEvent& event);
+    void OnCancelLoading(wxCommandEvent& event);
+    void OnCancelLoadingUI(wxUpdateUIEvent& event);
     void OnClearAll(wxCommandEvent& event);
     void OnQuit(wxCommandEvent& event);
 
@@ -40,6 +43,9 @@ public:
     void OnSelectTranslateUI(wxUpdateUIEvent& event);
     void OnSelectScaleUI(wxUpdateUIEvent& event);
     void OnSelectRotateUI(wxUpdateUIEvent& event);
+    void OnSetParent(wxCommandEvent& event);
+    void OnClearParent(wxCommandEvent& event);
+    void OnParentUI(wxUpdateUIEvent& event);
 
     // Axis option events
     void OnChangeAxis(wxCommandEvent& event);
@@ -66,6 +72,10 @@ public:
     void OnRenderingSetMaterial(wxCommandEvent& event);
 
 private:
+    // Called on this thread by the background loads
+    void OnLoadingProgress();
+    void OnModelLoaded();
+
     void CreateMenuBar();
     void CreateToolBar();
     void CreateDrawingPanel();
@@ -0,0 +1,90 @@
+#include "MappedFile.h"
+
+#include <fstream>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+    : data(NULL), size(0), isMapped(false)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const std::string& filename)
+{
+    Close();
+
+#ifndef _WIN32
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0)
+    {
+        size = (size_t)st.st_size;
+        if (size == 0)
+        {
+            close(fd);
+            return true;
+        }
+
+        void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED)
+        {
+            // The file is scanned front to back
+            madvise(mapping, size, MADV_SEQUENTIAL);
+            data = (const char*)mapping;
+            isMapped = true;
+        }
+    }
+    close(fd);
+
+    if (isMapped)
+        return true;
+#endif
+
+    // Fallback: read the whole file
+    std::ifstream file(filename.c_str(), std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+        return false;
+
+    size = (size_t)file.tellg();
+    buffer.resize(size);
+    file.seekg(0);
+    file.read(buffer.data(), size);
+    data = buffer.data();
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+#ifndef _WIN32
+    if (isMapped)
+        munmap((void*)data, size);
+#endif
+    data = NULL;
+    size = 0;
+    isMapped = false;
+    buffer.clear();
+}
+
+const char* MappedFile::GetData() const
+{
+    return data;
+}
+
+size_t MappedFile::GetSize() const
+{
+    return size;
+}
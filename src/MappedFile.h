@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Read only view of a whole file. Uses mmap where available and falls back
+// to reading the file into memory.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(MappedFile const&) = delete;
+    void operator=(MappedFile const&) = delete;
+
+    bool Open(const std::string& filename);
+    void Close();
+
+    const char* GetData() const;
+    size_t GetSize() const;
+
+private:
+    const char* data;
+    size_t size;
+    bool isMapped;
+    std::vector<char> buffer;
+};
@@ -2,6 +2,12 @@
 #include "ALMath.h"
 #include <assert.h>
 
+#include "CpuFeatures.h"
+
+#ifdef CPU_AVX_KERNELS
+#include <immintrin.h>
+#endif
+
 // Constructors
 Mat4::Mat4(double d)
 {
@@ -30,28 +36,6 @@ Mat4::Mat4(double m00, double m01, double m02, double m03,
 	data[3] = Vec4(m30, m31, m32, m33);
 }
 
-// Copy Constructor
-Mat4::Mat4(const Mat4 & m)
-{
-	for (int i = 0; i < 4; i++)
-	{
-		data[i] = m.data[i];
-	}
-}
-
-// Assignment operator overloading
-Mat4 & Mat4::operator=(const Mat4 & m)
-{
-	if (this == &m)
-		return *this;
-
-	for (int i = 0; i < 4; i++)
-	{
-		data[i] = m.data[i];
-	}
-	return *this;
-}
-
 // Addition operator overloading
 Mat4 Mat4::operator+(const Mat4 & m) const
 {
@@ -94,22 +78,6 @@ Mat4 & Mat4::operator*=(double c)
 	return (*this = *this * c);
 }
 
-Mat4 Mat4::operator*(const Mat4 & m) const
-{
-	Mat4 result(0.0);
-	for (int i = 0; i < 4; i++)
-	{
-		for (int j = 0; j < 4; j++)
-		{
-			for (int k = 0; k < 4; k++)
-			{
-				result[i][j] += data[i][k] * m[k][j];
-			}
-		}
-	}
-	return result;
-}
-
 Mat4 & Mat4::operator*=(const Mat4 & m)
 {
 	return (*this = *this * m);
@@ -138,19 +106,6 @@ Mat4 & Mat4::operator/=(double c)
 	return (*this = *this / c);
 }
 
-// Subscript operator overloading
-const Vec4 & Mat4::operator[](int i) const
-{
-	assert(i >= 0 && i < 4);
-	return data[i];
-}
-
-Vec4 & Mat4::operator[](int i)
-{
-	assert(i >= 0 && i < 4);
-	return data[i];
-}
-
 // Cout overloading
 std::ostream & operator<<(std::ostream & os, const Mat4 & v)
 {
@@ -169,6 +124,269 @@ void Mat4::Transpose()
 	std::swap(this->data[2][3], this->data[3][2]);
 }
 
+bool Mat4::IsAffine() const
+{
+	return (abs(data[0][3]) < AL_DBL_EPSILON) && (abs(data[1][3]) < AL_DBL_EPSILON) &&
+		(abs(data[2][3]) < AL_DBL_EPSILON) && (abs(data[3][3] - 1.0) < AL_DBL_EPSILON);
+}
+
+// Multiplies a direction by the upper 3x3 only (no translation, w = 0)
+Vec4 Mat4::TransformNormal(const Vec4& n) const
+{
+	return Vec4(n[0] * data[0][0] + n[1] * data[1][0] + n[2] * data[2][0],
+		n[0] * data[0][1] + n[1] * data[1][1] + n[2] * data[2][1],
+		n[0] * data[0][2] + n[1] * data[1][2] + n[2] * data[2][2], 0.0);
+}
+
+// Batch methods
+#ifdef CPU_AVX_KERNELS
+// Transforms 4 points (w = 1) by the broadcast matrix coefficients c
+CPU_TARGET_AVX static inline void TransformBlock(__m256d x, __m256d y, __m256d z, const __m256d (&c)[4][4],
+	double* outXs, double* outYs, double* outZs, double* outWs)
+{
+	__m256d rx = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(x, c[0][0]), _mm256_mul_pd(y, c[1][0])),
+		_mm256_add_pd(_mm256_mul_pd(z, c[2][0]), c[3][0]));
+	__m256d ry = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(x, c[0][1]), _mm256_mul_pd(y, c[1][1])),
+		_mm256_add_pd(_mm256_mul_pd(z, c[2][1]), c[3][1]));
+	__m256d rz = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(x, c[0][2]), _mm256_mul_pd(y, c[1][2])),
+		_mm256_add_pd(_mm256_mul_pd(z, c[2][2]), c[3][2]));
+	__m256d rw = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(x, c[0][3]), _mm256_mul_pd(y, c[1][3])),
+		_mm256_add_pd(_mm256_mul_pd(z, c[2][3]), c[3][3]));
+
+	_mm256_storeu_pd(outXs, rx);
+	_mm256_storeu_pd(outYs, ry);
+	_mm256_storeu_pd(outZs, rz);
+	_mm256_storeu_pd(outWs, rw);
+}
+
+// 4 unsigned 16 bit values widened to doubles
+CPU_TARGET_AVX static inline __m256d LoadQuantized(const uint16_t* values)
+{
+	return _mm256_cvtepi32_pd(_mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)values)));
+}
+
+// The kernels below do 8 points per iteration (two 4-wide double registers)
+// and return how many points they did, the callers finish the rest. They
+// clear the upper halves on the way out so the SSE code after them doesn't
+// pay a transition penalty.
+CPU_TARGET_AVX static size_t TransformPointsAvx(const double (&m)[4][4], const double* xs, 
+	const double* ys, const double* zs, size_t n, double* outXs, double* outYs, double* outZs, double* outWs)
+{
+	__m256d c[4][4];
+	for (int r = 0; r < 4; r++)
+		for (int k = 0; k < 4; k++)
+			c[r][k] = _mm256_set1_pd(m[r][k]);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		for (size_t o = i; o < i + 8; o += 4)
+		{
+			TransformBlock(_mm256_loadu_pd(xs + o), _mm256_loadu_pd(ys + o), _mm256_loadu_pd(zs + o), c,
+				outXs + o, outYs + o, outZs + o, outWs + o);
+		}
+	}
+	_mm256_zeroupper();
+	return i;
+}
+
+CPU_TARGET_AVX static size_t TransformQuantizedPointsAvx(const double (&m)[4][4], const uint16_t* xs, 
+	const uint16_t* ys, const uint16_t* zs, size_t n, double* outXs, double* outYs, double* outZs, double* outWs)
+{
+	__m256d c[4][4];
+	for (int r = 0; r < 4; r++)
+		for (int k = 0; k < 4; k++)
+			c[r][k] = _mm256_set1_pd(m[r][k]);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		for (size_t o = i; o < i + 8; o += 4)
+		{
+			TransformBlock(LoadQuantized(xs + o), LoadQuantized(ys + o), LoadQuantized(zs + o), c,
+				outXs + o, outYs + o, outZs + o, outWs + o);
+		}
+	}
+	_mm256_zeroupper();
+	return i;
+}
+
+CPU_TARGET_AVX static size_t PerspectiveDivideAvx(const double (&m)[4][3], double* xs, double* ys, 
+	double* zs, const double* ws, size_t n)
+{
+	__m256d c[4][3];
+	for (int r = 0; r < 4; r++)
+		for (int k = 0; k < 3; k++)
+			c[r][k] = _mm256_set1_pd(m[r][k]);
+	const __m256d one = _mm256_set1_pd(1.0);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		for (size_t o = i; o < i + 8; o += 4)
+		{
+			__m256d invW = _mm256_div_pd(one, _mm256_loadu_pd(ws + o));
+			__m256d x = _mm256_mul_pd(_mm256_loadu_pd(xs + o), invW);
+			__m256d y = _mm256_mul_pd(_mm256_loadu_pd(ys + o), invW);
+			__m256d z = _mm256_mul_pd(_mm256_loadu_pd(zs + o), invW);
+
+			__m256d rx = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(x, c[0][0]), _mm256_mul_pd(y, c[1][0])),
+				_mm256_add_pd(_mm256_mul_pd(z, c[2][0]), c[3][0]));
+			__m256d ry = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(x, c[0][1]), _mm256_mul_pd(y, c[1][1])),
+				_mm256_add_pd(_mm256_mul_pd(z, c[2][1]), c[3][1]));
+			__m256d rz = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(x, c[0][2]), _mm256_mul_pd(y, c[1][2])),
+				_mm256_add_pd(_mm256_mul_pd(z, c[2][2]), c[3][2]));
+
+			_mm256_storeu_pd(xs + o, rx);
+			_mm256_storeu_pd(ys + o, ry);
+			_mm256_storeu_pd(zs + o, rz);
+		}
+	}
+	_mm256_zeroupper();
+	return i;
+}
+
+// The scalar Inverse with 4 result columns per register. s and c are the 2x2
+// minors of rows 0-1 and rows 2-3 over the same pair of columns, for the
+// pair ij they are in dij as (s, s, c, c) and in eij as (c, c, s, s).
+// Rows are read and written in place, a copy written with scalar stores
+// would stall the wide loads. Returns the determinant.
+CPU_TARGET_AVX static double InverseAvx(const Mat4& m, Mat4& result)
+{
+	__m256d r0 = _mm256_loadu_pd(&m[0][0]);
+	__m256d r1 = _mm256_loadu_pd(&m[1][0]);
+	__m256d r2 = _mm256_loadu_pd(&m[2][0]);
+	__m256d r3 = _mm256_loadu_pd(&m[3][0]);
+
+	// Columns, and qk is column k with the rows swapped in pairs (m1k, m0k, m3k, m2k)
+	__m256d t0 = _mm256_unpacklo_pd(r0, r1);
+	__m256d t1 = _mm256_unpackhi_pd(r0, r1);
+	__m256d t2 = _mm256_unpacklo_pd(r2, r3);
+	__m256d t3 = _mm256_unpackhi_pd(r2, r3);
+	__m256d c0 = _mm256_permute2f128_pd(t0, t2, 0x20);
+	__m256d c1 = _mm256_permute2f128_pd(t1, t3, 0x20);
+	__m256d c2 = _mm256_permute2f128_pd(t0, t2, 0x31);
+	__m256d q0 = _mm256_permute_pd(c0, 0x5);
+	__m256d q1 = _mm256_permute_pd(c1, 0x5);
+	__m256d q2 = _mm256_permute_pd(c2, 0x5);
+	__m256d q3 = _mm256_permute_pd(_mm256_permute2f128_pd(t1, t3, 0x31), 0x5);
+
+	__m256d d01 = _mm256_mul_pd(c0, q1);
+	__m256d d02 = _mm256_mul_pd(c0, q2);
+	__m256d d03 = _mm256_mul_pd(c0, q3);
+	__m256d d12 = _mm256_mul_pd(c1, q2);
+	__m256d d13 = _mm256_mul_pd(c1, q3);
+	__m256d d23 = _mm256_mul_pd(c2, q3);
+	d01 = _mm256_hsub_pd(d01, d01);
+	d02 = _mm256_hsub_pd(d02, d02);
+	d03 = _mm256_hsub_pd(d03, d03);
+	d12 = _mm256_hsub_pd(d12, d12);
+	d13 = _mm256_hsub_pd(d13, d13);
+	d23 = _mm256_hsub_pd(d23, d23);
+	__m256d e01 = _mm256_permute2f128_pd(d01, d01, 1);
+	__m256d e02 = _mm256_permute2f128_pd(d02, d02, 1);
+	__m256d e03 = _mm256_permute2f128_pd(d03, d03, 1);
+	__m256d e12 = _mm256_permute2f128_pd(d12, d12, 1);
+	__m256d e13 = _mm256_permute2f128_pd(d13, d13, 1);
+	__m256d e23 = _mm256_permute2f128_pd(d23, d23, 1);
+
+	// Lane 0 is s0c5 - s1c4 + s2c3, lane 2 is s5c0 - s4c1 + s3c2
+	__m256d terms = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(d01, e23), _mm256_mul_pd(d02, e13)),
+		_mm256_mul_pd(d03, e12));
+	double det = _mm_cvtsd_f64(_mm_add_sd(_mm256_castpd256_pd128(terms), _mm256_extractf128_pd(terms, 1)));
+	double invDet = 1.0 / det;
+	__m256d even = _mm256_setr_pd(invDet, -invDet, invDet, -invDet);
+	__m256d odd = _mm256_setr_pd(-invDet, invDet, -invDet, invDet);
+
+	_mm256_storeu_pd(&result[0][0], _mm256_mul_pd(_mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(q1, e23),
+		_mm256_mul_pd(q2, e13)), _mm256_mul_pd(q3, e12)), even));
+	_mm256_storeu_pd(&result[1][0], _mm256_mul_pd(_mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(q0, e23),
+		_mm256_mul_pd(q2, e03)), _mm256_mul_pd(q3, e02)), odd));
+	_mm256_storeu_pd(&result[2][0], _mm256_mul_pd(_mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(q0, e13),
+		_mm256_mul_pd(q1, e03)), _mm256_mul_pd(q3, e01)), even));
+	_mm256_storeu_pd(&result[3][0], _mm256_mul_pd(_mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(q0, e12),
+		_mm256_mul_pd(q1, e02)), _mm256_mul_pd(q2, e01)), odd));
+	_mm256_zeroupper();
+	return det;
+}
+#endif
+
+void Mat4::TransformPoints(const double* xs, const double* ys, const double* zs, size_t n,
+	double* outXs, double* outYs, double* outZs, double* outWs) const
+{
+	// Copy coefficients once, the loops below must not go through operator[]
+	double m[4][4];
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			m[i][j] = data[i][j];
+
+	size_t i = 0;
+#ifdef CPU_AVX_KERNELS
+	if (CpuFeatures::HasAvx())
+		i = TransformPointsAvx(m, xs, ys, zs, n, outXs, outYs, outZs, outWs);
+#endif
+	// Scalar tail (or the whole range without AVX)
+	for (; i < n; i++)
+	{
+		double x = xs[i];
+		double y = ys[i];
+		double z = zs[i];
+		outXs[i] = x * m[0][0] + y * m[1][0] + z * m[2][0] + m[3][0];
+		outYs[i] = x * m[0][1] + y * m[1][1] + z * m[2][1] + m[3][1];
+		outZs[i] = x * m[0][2] + y * m[1][2] + z * m[2][2] + m[3][2];
+		outWs[i] = x * m[0][3] + y * m[1][3] + z * m[2][3] + m[3][3];
+	}
+}
+
+void Mat4::TransformQuantizedPoints(const uint16_t* xs, const uint16_t* ys, const uint16_t* zs, size_t n,
+	double* outXs, double* outYs, double* outZs, double* outWs) const
+{
+	double m[4][4];
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			m[i][j] = data[i][j];
+
+	size_t i = 0;
+#ifdef CPU_AVX_KERNELS
+	if (CpuFeatures::HasAvx())
+		i = TransformQuantizedPointsAvx(m, xs, ys, zs, n, outXs, outYs, outZs, outWs);
+#endif
+	for (; i < n; i++)
+	{
+		double x = xs[i];
+		double y = ys[i];
+		double z = zs[i];
+		outXs[i] = x * m[0][0] + y * m[1][0] + z * m[2][0] + m[3][0];
+		outYs[i] = x * m[0][1] + y * m[1][1] + z * m[2][1] + m[3][1];
+		outZs[i] = x * m[0][2] + y * m[1][2] + z * m[2][2] + m[3][2];
+		outWs[i] = x * m[0][3] + y * m[1][3] + z * m[2][3] + m[3][3];
+	}
+}
+
+void Mat4::PerspectiveDivide(double* xs, double* ys, double* zs, const double* ws, size_t n) const
+{
+	double m[4][3];
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 3; j++)
+			m[i][j] = data[i][j];
+
+	size_t i = 0;
+#ifdef CPU_AVX_KERNELS
+	if (CpuFeatures::HasAvx())
+		i = PerspectiveDivideAvx(m, xs, ys, zs, ws, n);
+#endif
+	for (; i < n; i++)
+	{
+		double invW = 1.0 / ws[i];
+		double x = xs[i] * invW;
+		double y = ys[i] * invW;
+		double z = zs[i] * invW;
+		xs[i] = x * m[0][0] + y * m[1][0] + z * m[2][0] + m[3][0];
+		ys[i] = x * m[0][1] + y * m[1][1] + z * m[2][1] + m[3][1];
+		zs[i] = x * m[0][2] + y * m[1][2] + z * m[2][2] + m[3][2];
+	}
+}
+
 // Static Methods
 Mat4 Mat4::Translate(double x, double y, double z)
 {
@@ -242,3 +460,141 @@ Mat4 Mat4::RotateZ(double angleInDegrees)
 	result[1][0] = -result[0][1];
 	return result;
 }
+
+// General inverse using cofactors (2x2 sub-determinants)
+Mat4 Mat4::Inverse(const Mat4& m)
+{
+	if (m.IsAffine())
+		return InverseAffine(m);
+
+#ifdef CPU_AVX_KERNELS
+	if (CpuFeatures::HasAvx())
+	{
+		Mat4 result;
+		double det = InverseAvx(m, result);
+		assert(abs(det) > AL_DBL_EPSILON * AL_DBL_EPSILON);
+		(void)det;
+		return result;
+	}
+#endif
+
+	double s0 = m[0][0] * m[1][1] - m[1][0] * m[0][1];
+	double s1 = m[0][0] * m[1][2] - m[1][0] * m[0][2];
+	double s2 = m[0][0] * m[1][3] - m[1][0] * m[0][3];
+	double s3 = m[0][1] * m[1][2] - m[1][1] * m[0][2];
+	double s4 = m[0][1] * m[1][3] - m[1][1] * m[0][3];
+	double s5 = m[0][2] * m[1][3] - m[1][2] * m[0][3];
+
+	double c5 = m[2][2] * m[3][3] - m[3][2] * m[2][3];
+	double c4 = m[2][1] * m[3][3] - m[3][1] * m[2][3];
+	double c3 = m[2][1] * m[3][2] - m[3][1] * m[2][2];
+	double c2 = m[2][0] * m[3][3] - m[3][0] * m[2][3];
+	double c1 = m[2][0] * m[3][2] - m[3][0] * m[2][2];
+	double c0 = m[2][0] * m[3][1] - m[3][0] * m[2][1];
+
+	double det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+	assert(abs(det) > AL_DBL_EPSILON * AL_DBL_EPSILON);
+	double invDet = 1.0 / det;
+
+	Mat4 result;
+	result[0][0] = ( m[1][1] * c5 - m[1][2] * c4 + m[1][3] * c3) * invDet;
+	result[0][1] = (-m[0][1] * c5 + m[0][2] * c4 - m[0][3] * c3) * invDet;
+	result[0][2] = ( m[3][1] * s5 - m[3][2] * s4 + m[3][3] * s3) * invDet;
+	result[0][3] = (-m[2][1] * s5 + m[2][2] * s4 - m[2][3] * s3) * invDet;
+
+	result[1][0] = (-m[1][0] * c5 + m[1][2] * c2 - m[1][3] * c1) * invDet;
+	result[1][1] = ( m[0][0] * c5 - m[0][2] * c2 + m[0][3] * c1) * invDet;
+	result[1][2] = (-m[3][0] * s5 + m[3][2] * s2 - m[3][3] * s1) * invDet;
+	result[1][3] = ( m[2][0] * s5 - m[2][2] * s2 + m[2][3] * s1) * invDet;
+
+	result[2][0] = ( m[1][0] * c4 - m[1][1] * c2 + m[1][3] * c0) * invDet;
+	result[2][1] = (-m[0][0] * c4 + m[0][1] * c2 - m[0][3] * c0) * invDet;
+	result[2][2] = ( m[3][0] * s4 - m[3][1] * s2 + m[3][3] * s0) * invDet;
+	result[2][3] = (-m[2][0] * s4 + m[2][1] * s2 - m[2][3] * s0) * invDet;
+
+	result[3][0] = (-m[1][0] * c3 + m[1][1] * c1 - m[1][2] * c0) * invDet;
+	result[3][1] = ( m[0][0] * c3 - m[0][1] * c1 + m[0][2] * c0) * invDet;
+	result[3][2] = (-m[3][0] * s3 + m[3][1] * s1 - m[3][2] * s0) * invDet;
+	result[3][3] = ( m[2][0] * s3 - m[2][1] * s1 + m[2][2] * s0) * invDet;
+
+	return result;
+}
+
+// Inverse of [A 0; t 1] is [A^-1 0; -t * A^-1 1]. When A is orthonormal
+// (rotation only) A^-1 is its transpose.
+Mat4 Mat4::InverseAffine(const Mat4& m)
+{
+	Mat4 result;
+
+	bool isRigid = true;
+	for (int i = 0; i < 3 && isRigid; i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			double dot = m[i][0] * m[j][0] + m[i][1] * m[j][1] + m[i][2] * m[j][2];
+			if (abs(dot - ((i == j) ? 1.0 : 0.0)) > AL_DBL_EPSILON)
+			{
+				isRigid = false;
+				break;
+			}
+		}
+	}
+
+	if (isRigid)
+	{
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++)
+				result[i][j] = m[j][i];
+	}
+	else
+	{
+		// 3x3 inverse through the adjugate
+		double c00 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+		double c01 = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+		double c02 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+		double det = m[0][0] * c00 + m[0][1] * c01 + m[0][2] * c02;
+		assert(abs(det) > AL_DBL_EPSILON * AL_DBL_EPSILON);
+		double invDet = 1.0 / det;
+
+		result[0][0] = c00 * invDet;
+		result[1][0] = c01 * invDet;
+		result[2][0] = c02 * invDet;
+		result[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * invDet;
+		result[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * invDet;
+		result[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * invDet;
+		result[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * invDet;
+		result[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * invDet;
+		result[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * invDet;
+	}
+
+	for (int j = 0; j < 3; j++)
+		result[3][j] = -(m[3][0] * result[0][j] + m[3][1] * result[1][j] + m[3][2] * result[2][j]);
+
+	return result;
+}
+
+// Inverse transpose of the upper 3x3, used to transform normals (w = 0).
+// The columns of the inverse are the cross products of the rows over the
+// determinant, so its transpose has them as rows.
+Mat4 Mat4::NormalMatrix(const Mat4& m)
+{
+	Mat4 result;
+	result[0][0] = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+	result[0][1] = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+	result[0][2] = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+	result[1][0] = m[2][1] * m[0][2] - m[2][2] * m[0][1];
+	result[1][1] = m[2][2] * m[0][0] - m[2][0] * m[0][2];
+	result[1][2] = m[2][0] * m[0][1] - m[2][1] * m[0][0];
+	result[2][0] = m[0][1] * m[1][2] - m[0][2] * m[1][1];
+	result[2][1] = m[0][2] * m[1][0] - m[0][0] * m[1][2];
+	result[2][2] = m[0][0] * m[1][1] - m[0][1] * m[1][0];
+
+	double det = m[0][0] * result[0][0] + m[0][1] * result[0][1] + m[0][2] * result[0][2];
+	assert(abs(det) > AL_DBL_EPSILON * AL_DBL_EPSILON);
+	double invDet = 1.0 / det;
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++)
+			result[i][j] *= invDet;
+
+	return result;
+}
\ No newline at end of file
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "Vec4.h"
+#include <cstddef>
+#include <cstdint>
 
 class Mat4
 {
@@ -17,13 +19,13 @@ public:
 		 double m30, double m31, double m32, double m33);
 
 	// Destructor
-	~Mat4() { }
+	~Mat4() = default;
 
 	// Copy Constructor
-	Mat4(const Mat4& m);
+	Mat4(const Mat4& m) = default;
 
 	// Assignment operator overloading
-	Mat4& operator =(const Mat4& m);
+	Mat4& operator =(const Mat4& m) = default;
 
 	// Addition operator overloading
 	Mat4 operator +(const Mat4& m) const;
@@ -36,7 +38,7 @@ public:
 	// Multiplication operator overloading
 	Mat4 operator *(double c) const;
 	Mat4& operator *=(double c);
-	Mat4 operator *(const Mat4& m) const;
+	inline Mat4 operator *(const Mat4& m) const;
 	Mat4& operator *=(const Mat4& m);
 	Vec4 operator *(const Vec4& v) const;
 
@@ -45,14 +47,36 @@ public:
 	Mat4& operator /=(double c);
 
 	// Subscript operator overloading
-	const Vec4& operator [](int i) const;
-	Vec4& operator [](int i);
+	const Vec4& operator [](int i) const
+	{
+		assert(i >= 0 && i < 4);
+		return data[i];
+	}
+	Vec4& operator [](int i)
+	{
+		assert(i >= 0 && i < 4);
+		return data[i];
+	}
 
 	// Cout overloading
 	friend std::ostream& operator<<(std::ostream& os, const Mat4& v);
 
 	// Public methods
 	void Transpose();
+	bool IsAffine() const;
+	Vec4 TransformNormal(const Vec4& n) const;
+
+	// Batch methods (structure of arrays). Transforms n points (w = 1)
+	// by this matrix, writing the homogeneous result to the out arrays.
+	void TransformPoints(const double* xs, const double* ys, const double* zs, size_t n,
+		double* outXs, double* outYs, double* outZs, double* outWs) const;
+	// Same for points stored as unsigned 16 bit values, which are widened
+	// inside the transform. Fold the dequantization into this matrix.
+	void TransformQuantizedPoints(const uint16_t* xs, const uint16_t* ys, const uint16_t* zs, size_t n,
+		double* outXs, double* outYs, double* outZs, double* outWs) const;
+	// Divides n homogeneous points by w in place, then maps them through
+	// this matrix, which must be affine (e.g. the renderer's viewport matrix).
+	void PerspectiveDivide(double* xs, double* ys, double* zs, const double* ws, size_t n) const;
 
 	// Static Methods
 	static Mat4 Translate(double x, double y, double z);
@@ -63,5 +87,25 @@ public:
 	static Mat4 RotateX(double angleInDegrees);
 	static Mat4 RotateY(double angleInDegrees);
 	static Mat4 RotateZ(double angleInDegrees);
+	static Mat4 Inverse(const Mat4& m);
+	static Mat4 InverseAffine(const Mat4& m);
+	static Mat4 NormalMatrix(const Mat4& m);
 };
 
+// Hot products are defined here so they can be inlined at every call site
+inline Vec4 Vec4::operator*(const Mat4& m) const
+{
+	return Vec4(
+		data[0] * m[0][0] + data[1] * m[1][0] + data[2] * m[2][0] + data[3] * m[3][0],
+		data[0] * m[0][1] + data[1] * m[1][1] + data[2] * m[2][1] + data[3] * m[3][1],
+		data[0] * m[0][2] + data[1] * m[1][2] + data[2] * m[2][2] + data[3] * m[3][2],
+		data[0] * m[0][3] + data[1] * m[1][3] + data[2] * m[2][3] + data[3] * m[3][3]);
+}
+
+inline Mat4 Mat4::operator*(const Mat4& m) const
+{
+	Mat4 result(0.0);
+	for (int i = 0; i < 4; i++)
+		result.data[i] = data[i] * m;
+	return result;
+}
@@ -0,0 +1,969 @@
+#include "Mesh.h"
+#include "ObjParser.h"
+#include "StlParser.h"
+#include "PlyParser.h"
+#include "VertexWelder.h"
+#include "ModelCache.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "ModelPreview.h"
+#include "CpuFeatures.h"
+
+#include <exception>
+#include <chrono>
+#ifdef CPU_AVX_KERNELS
+#include <immintrin.h>
+#endif
+
+#define MESH_LOD_LEVELS 4
+// Vertices per thread below which fewer threads calculate normals
+#define NORMALS_MIN_VERTICES_PER_THREAD 16384
+
+// Scratch buffers reused for every face while triangulating
+struct TriangulationBuffers
+{
+    std::vector<unsigned int> Vertices;
+    std::vector<Vec4> Points;
+    std::vector<unsigned int> Remaining;
+    std::vector<unsigned int> Triangles;
+};
+
+// z of the cross product of (b - a) and (c - b), positive for a left turn
+static double Cross2(const Vec4& a, const Vec4& b, const Vec4& c)
+{
+    return (b[0] - a[0]) * (c[1] - b[1]) - (b[1] - a[1]) * (c[0] - b[0]);
+}
+
+static bool IsPointInTriangle(const Vec4& p, const Vec4& a, const Vec4& b, const Vec4& c)
+{
+    return (Cross2(a, b, p) >= 0.0) && (Cross2(b, c, p) >= 0.0) && (Cross2(c, a, p) >= 0.0);
+}
+
+// Triangulates a counter clockwise 2D polygon. Convex polygons are split
+// as a fan, concave ones by ear clipping. Triangles are returned as
+// triplets of point indices with the winding of the polygon.
+static void TriangulatePolygon(const std::vector<Vec4>& points, 
+    std::vector<unsigned int>& remaining, std::vector<unsigned int>& triangles)
+{
+    unsigned int size = points.size();
+    triangles.clear();
+
+    bool isConvex = true;
+    for (unsigned int i = 0; (i < size) && isConvex; i++)
+        isConvex = Cross2(points[i], points[(i + 1) % size], points[(i + 2) % size]) >= 0.0;
+
+    remaining.resize(size);
+    for (unsigned int i = 0; i < size; i++)
+        remaining[i] = i;
+
+    while (!isConvex && (remaining.size() > 3))
+    {
+        unsigned int count = remaining.size();
+        bool isEarFound = false;
+        for (unsigned int i = 0; (i < count) && !isEarFound; i++)
+        {
+            unsigned int prev = remaining[(i + count - 1) % count];
+            unsigned int cur = remaining[i];
+            unsigned int next = remaining[(i + 1) % count];
+
+            // Reflex or degenerate corner
+            if (Cross2(points[prev], points[cur], points[next]) <= 0.0)
+                continue;
+
+            bool isEar = true;
+            for (unsigned int j = 0; (j < count) && isEar; j++)
+            {
+                unsigned int other = remaining[j];
+                if ((other != prev) && (other != cur) && (other != next))
+                    isEar = !IsPointInTriangle(points[other], points[prev], points[cur], points[next]);
+            }
+
+            if (isEar)
+            {
+                triangles.push_back(prev);
+                triangles.push_back(cur);
+                triangles.push_back(next);
+                remaining.erase(remaining.begin() + i);
+                isEarFound = true;
+            }
+        }
+
+        // Self intersecting or degenerate, fan what is left
+        if (!isEarFound)
+            break;
+    }
+
+    for (unsigned int i = 1; i + 1 < remaining.size(); i++)
+    {
+        triangles.push_back(remaining[0]);
+        triangles.push_back(remaining[i]);
+        triangles.push_back(remaining[i + 1]);
+    }
+}
+
+Mesh::Mesh()
+    : BoundingBox(NULL), isCompact(false), areLodsReady(false), isLodCancelled(false)
+{
+    VertexPositions.reserve(10);
+    VertexNormals.reserve(10);
+    VertexTexCoords.reserve(10);
+}
+
+Mesh::~Mesh()
+{
+    isLodCancelled = true;
+    if (lodThread.joinable())
+        lodThread.join();
+
+    delete BoundingBox;
+
+    while (geos.size() > 0)
+    {
+        Geometry* geo = geos.back();
+        geos.pop_back();
+        delete geo;
+    }
+}
+
+bool Mesh::LoadFromFile(const std::string& filename, LoadProgress* progress)
+{
+    bool isCached = Settings::IsModelCacheEnabled && LoadFromCache(filename);
+    if (!isCached)
+    {
+        if (!LoadFromSource(filename, progress))
+            return false;
+
+        if (Settings::IsModelCacheEnabled)
+            SaveToCache(filename);
+    }
+    if (IsLoadCancelled(progress))
+        return false;
+    CalculateMinMaxDimensions();
+
+    // Build Bounding Boxes
+    for (Geometry* geo : geos)
+        BuildGeoBoundingBox(geo);
+    BuildMeshBoundingBox();
+
+    // Bounding box vertices are included, they are drawn through the same stream
+    BuildPositionStream();
+    if (Settings::IsCompactVertexStorageEnabled)
+        Compact();
+    else
+        bvh.Build(geos, VertexPositions);
+
+    unsigned int polygonCount = 0;
+    for (const Geometry* geo : geos)
+        polygonCount += geo->GetPolygonCount();
+    size_t bytes = GetMemoryUsage();
+    LOG_INFO("Mesh memory: {0} MB ({1} bytes per polygon).", bytes / (1024.0 * 1024.0), 
+        (polygonCount > 0) ? (double)bytes / polygonCount : 0.0);
+
+    // Nothing writes the vertex arrays or geometries after this point
+    if (Settings::IsLodEnabled)
+        lodThread = std::thread(&Mesh::BuildLods, this);
+
+    return true;
+}
+
+unsigned int Mesh::GetGeometryCount() const
+{
+    return geos.size();
+}
+
+const Geometry* Mesh::GetGeometry(unsigned int index) const
+{
+    return geos[index];
+}
+
+size_t Mesh::GetMemoryUsage() const
+{
+    size_t bytes = sizeof(Mesh) + GetVectorBytes(VertexTexCoords) + 
+        GetVectorBytes(VertexPositions) + GetVectorBytes(VertexNormals) +
+        GetVectorBytes(PositionStream.X) + GetVectorBytes(PositionStream.Y) + 
+        GetVectorBytes(PositionStream.Z) + GetVectorBytes(PositionStream.W) + 
+        GetVectorBytes(geos) + bvh.GetMemoryUsage() + GetVectorBytes(QuantizedPositions.X) + 
+        GetVectorBytes(QuantizedPositions.Y) + GetVectorBytes(QuantizedPositions.Z) + 
+        GetVectorBytes(EncodedNormals) + GetVectorBytes(EncodedTexCoords);
+
+    // Levels of detail are still being written until they are ready
+    bool areLodsCounted = AreLodsReady();
+    for (const Geometry* geo : geos)
+    {
+        bytes += geo->GetMemoryUsage();
+        for (unsigned int i = 0; areLodsCounted && (i < geo->Lods.size()); i++)
+            bytes += geo->Lods[i]->GetMemoryUsage();
+    }
+
+    if (BoundingBox != NULL)
+        bytes += BoundingBox->GetMemoryUsage();
+
+    return bytes;
+}
+
+const Vec4& Mesh::GetMinDimensions() const
+{
+    return minDimensions;
+}
+
+const Vec4& Mesh::GetMaxDimensions() const
+{
+    return maxDimensions;
+}
+
+Vec4 Mesh::GetDimensions() const
+{
+    Vec4 result;
+    for (int i = 0; i < 3; i++)
+        result[i] = abs(maxDimensions[i] - minDimensions[i]);
+    
+    return result;
+}
+
+Vec4 Mesh::GetBBoxCenter() const
+{
+    Vec4 result;
+    Vec4 dimensions = GetDimensions();
+
+    for (int i = 0; i < 3; i++)
+        result[i] = minDimensions[i] + dimensions[i] / 2.0;
+    result[3] = 1.0;
+    
+    return result;
+}
+
+bool Mesh::AreLodsReady() const
+{
+    return areLodsReady.load(std::memory_order_acquire);
+}
+
+bool Mesh::Intersect(const Vec4& origin, const Vec4& direction, MeshBVHHit& hit) const
+{
+    return bvh.Intersect(this, origin, direction, hit);
+}
+
+Vec4 Mesh::GetNormal(unsigned int id) const
+{
+    return isCompact ? AttributeCompression::DecodeNormal(EncodedNormals[id]) : VertexNormals[id];
+}
+
+Vec4 Mesh::GetTexCoord(unsigned int id) const
+{
+    return isCompact ? AttributeCompression::DecodeTexCoord(EncodedTexCoords[id]) : VertexTexCoords[id];
+}
+
+void Mesh::TransformPositions(const Mat4& transform, PointStream& transformed) const
+{
+    if (isCompact)
+    {
+        const QuantizedPointStream& positions = QuantizedPositions;
+        transformed.Resize(positions.Size());
+        Mat4 decodeAndTransform = positions.GetDecodeTransform() * transform;
+        decodeAndTransform.TransformQuantizedPoints(positions.X.data(), positions.Y.data(), 
+            positions.Z.data(), positions.Size(), transformed.X.data(), transformed.Y.data(), 
+            transformed.Z.data(), transformed.W.data());
+        return;
+    }
+
+    const PointStream& positions = PositionStream;
+    transformed.Resize(positions.Size());
+    transform.TransformPoints(positions.X.data(), positions.Y.data(), positions.Z.data(), 
+        positions.Size(), transformed.X.data(), transformed.Y.data(), transformed.Z.data(), 
+        transformed.W.data());
+}
+
+bool Mesh::LoadFromSource(const std::string& filename, LoadProgress* progress)
+{
+    ModelPreview* preview = (progress != NULL) ? progress->Preview : NULL;
+    unsigned int batchSize = Settings::ProgressiveLoadingBatchSize;
+    ObjBlockCallback onBlock;
+    if (preview != NULL)
+        onBlock = [preview, batchSize](const ObjData& parsed) { preview->Publish(parsed, batchSize, false); };
+
+    std::string extension;
+    size_t dot = filename.find_last_of('.');
+    if (dot != std::string::npos)
+        extension = filename.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+    // STL and PLY are parsed in one pass, the preview shows once they are done
+    ObjData data;
+    bool isParsed;
+    if (extension == "stl")
+        isParsed = StlParser::Parse(filename, data, 0, progress);
+    else if (extension == "ply")
+        isParsed = PlyParser::Parse(filename, data, 0, progress);
+    else
+        isParsed = ObjParser::Parse(filename, data, 0, progress, onBlock);
+    if (!isParsed)
+    {
+        if (IsLoadCancelled(progress))
+            return false;
+
+        LOG_ERROR("{0} was not opened!", filename.c_str());
+        // TODO: throw exception
+        return false;
+    }
+
+    // The last batch arrives after the last progress report, report again
+    if (preview != NULL)
+    {
+        preview->Publish(data, batchSize, true);
+        progress->AddBytes(0);
+    }
+
+    // After the preview, which shows the faces as they were parsed
+    if (Settings::IsVertexWeldingEnabled)
+        VertexWelder::Weld(data, Settings::VertexWeldEpsilon);
+
+    VertexPositions.swap(data.Positions);
+    VertexTexCoords.swap(data.TexCoords);
+    VertexNormals.swap(data.Normals);
+
+    // Geometry vertex of every position, -1 if the current geometry doesn't use it
+    std::vector<int> vertexIndices(VertexPositions.size(), -1);
+    TriangulationBuffers buffers;
+
+    for (unsigned int g = 0; g < data.GroupFaces.size(); g++)
+    {
+        if (IsLoadCancelled(progress))
+            return false;
+
+        unsigned int firstFace = data.GroupFaces[g];
+        unsigned int lastFace = (g + 1 < data.GroupFaces.size()) ? 
+            data.GroupFaces[g + 1] : data.GetFaceCount();
+        if (firstFace == lastFace)
+            continue;
+
+        // Create Geometry
+        Geometry* geo = new Geometry();
+        geo->PolygonOffsets.reserve(lastFace - firstFace + 1);
+        geo->PolygonVertices.reserve(data.FaceOffsets[lastFace] - data.FaceOffsets[firstFace]);
+        geo->PolygonNormals.reserve(lastFace - firstFace);
+        geo->PolygonCenters.reserve(lastFace - firstFace);
+
+        for (unsigned int f = firstFace; f < lastFace; f++)
+        {
+            Vec4 center(0.0, 0.0, 0.0, 0.0);
+            for (unsigned int i = data.FaceOffsets[f]; i < data.FaceOffsets[f + 1]; i++)
+            {
+                const ObjIndex& index = data.Indices[i];
+                if ((index.PositionID < 0) || (index.PositionID >= (int)VertexPositions.size()))
+                    continue;
+
+                int& vertex = vertexIndices[index.PositionID];
+                if (vertex == -1)
+                    vertex = AddVertex(geo, index.PositionID, index.TexCoordID, index.NormalID);
+
+                geo->PolygonVertices.push_back(vertex);
+
+                // Add the vertex position to the center calculation
+                center += VertexPositions[index.PositionID];
+            }
+
+            unsigned int first = geo->PolygonOffsets.back();
+            unsigned int size = geo->PolygonVertices.size() - first;
+            if (size == 0)
+                continue;
+
+            if (Settings::IsTriangulationEnabled)
+            {
+                TriangulateFace(geo, f - firstFace, buffers);
+                continue;
+            }
+
+            center /= size;
+            center[3] = 1.0;
+
+            geo->EndPolygon(CalculatePolyNormal(geo, &geo->PolygonVertices[first], size), center);
+        }
+
+        for (int posID : geo->VertexPositionIDs)
+            vertexIndices[posID] = -1;
+
+        // Add Geometry to mesh, bounding boxes are built once all are loaded
+        geo->BuildAdjacency();
+        if (Settings::IsMeshOptimizationEnabled)
+            MeshOptimizer::Optimize(geo);
+        MeshOptimizer::BuildClusters(geo, VertexPositions);
+        CalculateVertexNormals(geo);
+        geos.push_back(geo);
+    }
+
+    // Lay the attribute arrays out in the order the optimized polygons use them
+    if (Settings::IsMeshOptimizationEnabled)
+    {
+        SortByFirstUse(VertexPositions, &Geometry::VertexPositionIDs);
+        SortByFirstUse(VertexTexCoords, &Geometry::VertexTexCoordIDs);
+        SortByFirstUse(VertexNormals, &Geometry::VertexNormalIDs);
+    }
+
+    return true;
+}
+
+Mesh* Mesh::BuildPreview(const ObjData& data, unsigned int firstFace, unsigned int lastFace, 
+    std::vector<int>& vertexIndices)
+{
+    Mesh* mesh = new Mesh();
+    Geometry* geo = new Geometry();
+    std::vector<int> usedPositions;
+
+    // The geometry's vertices are the mesh's positions, in order of first use
+    for (unsigned int f = firstFace; f < lastFace; f++)
+    {
+        Vec4 center(0.0, 0.0, 0.0, 0.0);
+        for (unsigned int i = data.FaceOffsets[f]; i < data.FaceOffsets[f + 1]; i++)
+        {
+            int posID = data.Indices[i].PositionID;
+            if ((posID < 0) || (posID >= (int)data.Positions.size()))
+                continue;
+
+            int& vertex = vertexIndices[posID];
+            if (vertex == -1)
+            {
+                vertex = mesh->VertexPositions.size();
+                mesh->VertexPositions.push_back(data.Positions[posID]);
+                mesh->AddVertex(geo, vertex, -1, -1);
+                usedPositions.push_back(posID);
+            }
+
+            geo->PolygonVertices.push_back(vertex);
+            center += data.Positions[posID];
+        }
+
+        unsigned int first = geo->PolygonOffsets.back();
+        unsigned int size = geo->PolygonVertices.size() - first;
+        if (size == 0)
+            continue;
+
+        center /= size;
+        center[3] = 1.0;
+        geo->EndPolygon(mesh->CalculatePolyNormal(geo, &geo->PolygonVertices[first], size), center);
+    }
+
+    for (int posID : usedPositions)
+        vertexIndices[posID] = -1;
+
+    mesh->geos.push_back(geo);
+    mesh->CalculateMinMaxDimensions();
+    mesh->BuildPositionStream();
+
+    return mesh;
+}
+
+bool Mesh::LoadFromCache(const std::string& filename)
+{
+    CachedModel data;
+    data.IsTriangulated = Settings::IsTriangulationEnabled;
+    data.IsOptimized = Settings::IsMeshOptimizationEnabled;
+    data.WeldEpsilon = Settings::IsVertexWeldingEnabled ? Settings::VertexWeldEpsilon : -1.0;
+    if (!ModelCache::Load(filename, data))
+        return false;
+
+    VertexPositions.swap(data.Positions);
+    VertexTexCoords.swap(data.TexCoords);
+    VertexNormals.swap(data.Normals);
+    geos.swap(data.Geometries);
+
+    return true;
+}
+
+void Mesh::SaveToCache(const std::string& filename)
+{
+    // Lend the arrays to the cache instead of copying them
+    CachedModel data;
+    data.IsTriangulated = Settings::IsTriangulationEnabled;
+    data.IsOptimized = Settings::IsMeshOptimizationEnabled;
+    data.WeldEpsilon = Settings::IsVertexWeldingEnabled ? Settings::VertexWeldEpsilon : -1.0;
+    data.Positions.swap(VertexPositions);
+    data.TexCoords.swap(VertexTexCoords);
+    data.Normals.swap(VertexNormals);
+    data.Geometries.swap(geos);
+
+    ModelCache::Save(filename, data);
+
+    VertexPositions.swap(data.Positions);
+    VertexTexCoords.swap(data.TexCoords);
+    VertexNormals.swap(data.Normals);
+    geos.swap(data.Geometries);
+}
+
+Vec4 Mesh::CalculatePolyNormal(const Geometry* geo, const unsigned int* vertices, 
+    unsigned int size) const
+{
+    Vec4 normal(0.0, 0.0, 1.0, 0.0);
+    
+    if (size >= 3)
+    {
+        Vec4 u = VertexPositions[geo->VertexPositionIDs[vertices[0]]];
+        Vec4 v = VertexPositions[geo->VertexPositionIDs[vertices[1]]];
+        Vec4 w = VertexPositions[geo->VertexPositionIDs[vertices[2]]];
+
+        Vec4 e1 = v - u;
+        Vec4 e2 = w - v;
+
+        if (size == 4)
+        {
+            Vec4 z = VertexPositions[geo->VertexPositionIDs[vertices[3]]];
+
+            if (Vec4::Length3(e1) < AL_DBL_EPSILON)
+            {
+                e1 = e2;
+                e2 = z - w;
+            }
+            else if (Vec4::Length3(e2) < AL_DBL_EPSILON)
+            {
+                e2 = z - w;
+            }
+        }
+
+        Vec4 temp = Vec4::Cross(e1, e2); // TODO: maybe change order (or negate)
+        if (Vec4::Length3(temp) >= AL_DBL_EPSILON)
+            normal = temp;
+        
+        normal = Vec4::Normalize3(normal);
+        normal[3] = 0.0;
+    }
+    
+    return normal;
+}
+
+Vec4 Mesh::CalculateVertexNormal(const Geometry* geo, unsigned int v) const
+{
+    // Normals of the polygons around the vertex, weighted by their angle at it
+    const Vec4& position = VertexPositions[geo->VertexPositionIDs[v]];
+    Vec4 normal(0.0, 0.0, 0.0, 0.0);
+    for (unsigned int i = geo->VertexPolygonOffsets[v]; i < geo->VertexPolygonOffsets[v + 1]; i++)
+    {
+        unsigned int p = geo->VertexPolygons[i];
+        const unsigned int* vertices = geo->GetPolygonVertices(p);
+        unsigned int size = geo->GetPolygonSize(p);
+        unsigned int corner = 0;
+        while ((corner < size) && (vertices[corner] != v))
+            corner++;
+        if (corner == size)
+            continue;
+
+        const Vec4& previous = VertexPositions[geo->VertexPositionIDs[vertices[(corner + size - 1) % size]]];
+        const Vec4& next = VertexPositions[geo->VertexPositionIDs[vertices[(corner + 1) % size]]];
+        double toPrevious[3], toNext[3];
+        for (int j = 0; j < 3; j++)
+        {
+            toPrevious[j] = previous[j] - position[j];
+            toNext[j] = next[j] - position[j];
+        }
+
+        double dot = toPrevious[0] * toNext[0] + toPrevious[1] * toNext[1] + toPrevious[2] * toNext[2];
+        double lengthsSquared = (toPrevious[0] * toPrevious[0] + toPrevious[1] * toPrevious[1] + toPrevious[2] * toPrevious[2]) * 
+            (toNext[0] * toNext[0] + toNext[1] * toNext[1] + toNext[2] * toNext[2]);
+        if (lengthsSquared < AL_DBL_EPSILON * AL_DBL_EPSILON)
+            continue;
+
+        double angle = acos(std::min(std::max(dot / sqrt(lengthsSquared), -1.0), 1.0));
+        const Vec4& polygonNormal = geo->PolygonNormals[p];
+        for (int j = 0; j < 3; j++)
+            normal[j] += angle * polygonNormal[j];
+    }
+
+    return normal;
+}
+
+#ifdef CPU_AVX_KERNELS
+// Normalizes 4 vectors per iteration, returns how many it did
+CPU_TARGET_AVX static size_t NormalizeVectorsAvx(double* xs, double* ys, double* zs, size_t n)
+{
+    size_t i = 0;
+    __m256d zero = _mm256_setzero_pd();
+    __m256d one = _mm256_set1_pd(1.0);
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d x = _mm256_loadu_pd(xs + i);
+        __m256d y = _mm256_loadu_pd(ys + i);
+        __m256d z = _mm256_loadu_pd(zs + i);
+
+        __m256d lengthSquared = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(x, x), _mm256_mul_pd(y, y)), 
+            _mm256_mul_pd(z, z));
+        __m256d isZero = _mm256_cmp_pd(lengthSquared, zero, _CMP_EQ_OQ);
+        __m256d inverse = _mm256_div_pd(one, _mm256_sqrt_pd(lengthSquared));
+
+        _mm256_storeu_pd(xs + i, _mm256_blendv_pd(_mm256_mul_pd(x, inverse), zero, isZero));
+        _mm256_storeu_pd(ys + i, _mm256_blendv_pd(_mm256_mul_pd(y, inverse), zero, isZero));
+        _mm256_storeu_pd(zs + i, _mm256_blendv_pd(_mm256_mul_pd(z, inverse), one, isZero));
+    }
+    _mm256_zeroupper();
+    return i;
+}
+#endif
+
+// Normalizes n vectors given as separate x, y and z arrays, zero vectors
+// become (0, 0, 1)
+static void NormalizeVectors(double* xs, double* ys, double* zs, size_t n)
+{
+    size_t i = 0;
+#ifdef CPU_AVX_KERNELS
+    if (CpuFeatures::HasAvx())
+        i = NormalizeVectorsAvx(xs, ys, zs, n);
+#endif
+    for (; i < n; i++)
+    {
+        double lengthSquared = xs[i] * xs[i] + ys[i] * ys[i] + zs[i] * zs[i];
+        if (lengthSquared == 0.0)
+        {
+            xs[i] = 0.0;
+            ys[i] = 0.0;
+            zs[i] = 1.0;
+            continue;
+        }
+
+        double inverse = 1.0 / sqrt(lengthSquared);
+        xs[i] *= inverse;
+        ys[i] *= inverse;
+        zs[i] *= inverse;
+    }
+}
+
+void Mesh::CalculateVertexNormals(Geometry* geo, unsigned int threadCount)
+{
+    std::chrono::steady_clock::time_point before = std::chrono::steady_clock::now();
+
+    // Vertices without a normal from the file get new ones in vertex order
+    unsigned int firstNormal = VertexNormals.size();
+    std::vector<unsigned int> vertices;
+    for (unsigned int v = 0; v < geo->GetVertexCount(); v++)
+    {
+        if (geo->VertexNormalIDs[v] != -1)
+            continue;
+
+        geo->VertexNormalIDs[v] = firstNormal + vertices.size();
+        vertices.push_back(v);
+    }
+    if (vertices.empty())
+        return;
+    VertexNormals.resize(firstNormal + vertices.size());
+
+    if (threadCount == 0)
+    {
+        threadCount = MaxInt(1, std::thread::hardware_concurrency());
+        threadCount = MinInt(threadCount, MaxInt(1, vertices.size() / NORMALS_MIN_VERTICES_PER_THREAD));
+    }
+
+    // Every thread gathers the normals of its own range of vertices, so no
+    // two threads write the same normal
+    std::vector<double> xs(vertices.size()), ys(vertices.size()), zs(vertices.size());
+    auto calculateRange = [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            Vec4 normal = CalculateVertexNormal(geo, vertices[i]);
+            xs[i] = normal[0];
+            ys[i] = normal[1];
+            zs[i] = normal[2];
+        }
+
+        NormalizeVectors(&xs[begin], &ys[begin], &zs[begin], end - begin);
+        for (size_t i = begin; i < end; i++)
+            VertexNormals[firstNormal + i] = Vec4(xs[i], ys[i], zs[i], 0.0);
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int t = 1; t < threadCount; t++)
+    {
+        threads.push_back(std::thread(calculateRange, vertices.size() * t / threadCount, 
+            vertices.size() * (t + 1) / threadCount));
+    }
+    calculateRange(0, vertices.size() / threadCount);
+    for (std::thread& thread : threads)
+        thread.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - before).count();
+    LOG_TRACE("Mesh::CalculateVertexNormals: {0} normals on {1} threads in {2} s.", 
+        vertices.size(), threadCount, seconds);
+}
+
+unsigned int Mesh::AddVertex(Geometry* geo, int posID, int texID, int normID)
+{
+    // Set maximum and minimum dimensions
+    const Vec4& pos = VertexPositions[posID];
+    if (geo->GetVertexCount() == 0)
+    {
+        geo->MaxDimensions = pos;
+        geo->MinDimensions = pos;
+    }
+    else
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            geo->MaxDimensions[i] = (pos[i] > geo->MaxDimensions[i]) ? pos[i] : geo->MaxDimensions[i];
+            geo->MinDimensions[i] = (pos[i] < geo->MinDimensions[i]) ? pos[i] : geo->MinDimensions[i];
+        }
+    }
+
+    return geo->AddVertex(posID, texID, normID);
+}
+
+void Mesh::TriangulateFace(Geometry* geo, unsigned int face, TriangulationBuffers& buffers)
+{
+    // Replace the face's vertices with its triangles
+    unsigned int first = geo->PolygonOffsets.back();
+    buffers.Vertices.assign(geo->PolygonVertices.begin() + first, geo->PolygonVertices.end());
+    geo->PolygonVertices.resize(first);
+
+    // Points and lines have no triangles
+    unsigned int size = buffers.Vertices.size();
+    if (size < 3)
+        return;
+
+    // Project on the plane most aligned with the face (Newell's normal),
+    // keeping the face counter clockwise
+    Vec4 normal(0.0, 0.0, 0.0, 0.0);
+    for (unsigned int i = 0; i < size; i++)
+    {
+        const Vec4& a = VertexPositions[geo->VertexPositionIDs[buffers.Vertices[i]]];
+        const Vec4& b = VertexPositions[geo->VertexPositionIDs[buffers.Vertices[(i + 1) % size]]];
+        normal[0] += (a[1] - b[1]) * (a[2] + b[2]);
+        normal[1] += (a[2] - b[2]) * (a[0] + b[0]);
+        normal[2] += (a[0] - b[0]) * (a[1] + b[1]);
+    }
+
+    int axis = 0;
+    for (int i = 1; i < 3; i++)
+        axis = (abs(normal[i]) > abs(normal[axis])) ? i : axis;
+    int u = (axis + 1) % 3;
+    int v = (axis + 2) % 3;
+    if (normal[axis] < 0.0)
+        std::swap(u, v);
+
+    buffers.Points.resize(size);
+    for (unsigned int i = 0; i < size; i++)
+    {
+        const Vec4& pos = VertexPositions[geo->VertexPositionIDs[buffers.Vertices[i]]];
+        buffers.Points[i] = Vec4(pos[u], pos[v], 0.0);
+    }
+
+    TriangulatePolygon(buffers.Points, buffers.Remaining, buffers.Triangles);
+
+    for (unsigned int t = 0; t < buffers.Triangles.size(); t += 3)
+    {
+        const unsigned int* corners = &buffers.Triangles[t];
+        unsigned char edges = 0;
+        Vec4 center(0.0, 0.0, 0.0, 0.0);
+        for (int i = 0; i < 3; i++)
+        {
+            unsigned int vertex = buffers.Vertices[corners[i]];
+            geo->PolygonVertices.push_back(vertex);
+            center += VertexPositions[geo->VertexPositionIDs[vertex]];
+
+            if (corners[(i + 1) % 3] == (corners[i] + 1) % size)
+                edges |= 1 << i;
+        }
+        center /= 3.0;
+        center[3] = 1.0;
+
+        unsigned int triangle = geo->PolygonVertices.size() - 3;
+        geo->EndPolygon(CalculatePolyNormal(geo, &geo->PolygonVertices[triangle], 3), center);
+        geo->PolygonFaces.push_back(face);
+        geo->PolygonEdges.push_back(edges);
+    }
+}
+
+void Mesh::SortByFirstUse(std::vector<Vec4>& values, std::vector<int> Geometry::* ids)
+{
+    const int unused = -1;
+    std::vector<int> remap(values.size(), unused);
+    std::vector<Vec4> sorted;
+    sorted.reserve(values.size());
+
+    for (Geometry* geo : geos)
+    {
+        for (int& id : geo->*ids)
+        {
+            if (id == -1)
+                continue;
+
+            if (remap[id] == unused)
+            {
+                remap[id] = sorted.size();
+                sorted.push_back(values[id]);
+            }
+            id = remap[id];
+        }
+    }
+
+    // Values no polygon refers to go last
+    for (unsigned int i = 0; i < values.size(); i++)
+    {
+        if (remap[i] == unused)
+            sorted.push_back(values[i]);
+    }
+
+    values.swap(sorted);
+}
+
+void Mesh::BuildGeoBoundingBox(Geometry* geo)
+{
+    if (geo == NULL)
+        return;
+    
+    delete geo->BoundingBox;
+    geo->BoundingBox = BuildBoundingBox(geo->MinDimensions, geo->MaxDimensions);
+}
+
+void Mesh::BuildMeshBoundingBox()
+{
+    delete BoundingBox;
+    BoundingBox = BuildBoundingBox(minDimensions, maxDimensions);
+
+    Vec4 dimensions = GetDimensions();
+    LOG_INFO("Mesh dimensions: ({0}, {1}, {2}).", dimensions[0], dimensions[1], dimensions[2]);
+}
+
+void Mesh::BuildLods()
+{
+    clock_t before = clock();
+
+    // Compact meshes are decoded for as long as the levels take to build
+    std::vector<Vec4> decoded;
+    for (unsigned int i = 0; isCompact && (i < QuantizedPositions.Size()); i++)
+        decoded.push_back(QuantizedPositions.Get(i));
+    const std::vector<Vec4>& positions = isCompact ? decoded : VertexPositions;
+
+    unsigned int lodCount = 0;
+    for (Geometry* geo : geos)
+    {
+        geo->Lods = MeshSimplifier::BuildLods(geo, positions, MESH_LOD_LEVELS, 
+            16, &isLodCancelled);
+        if (isLodCancelled)
+            return;
+
+        for (Geometry* lod : geo->Lods)
+            MeshOptimizer::BuildClusters(lod, positions);
+        lodCount += geo->Lods.size();
+    }
+
+    double seconds = (double)(clock() - before) / CLOCKS_PER_SEC;
+    LOG_INFO("Mesh::BuildLods: {0} levels for {1} geometries in {2} s.", lodCount, geos.size(), seconds);
+    areLodsReady.store(true, std::memory_order_release);
+}
+
+void Mesh::BuildPositionStream()
+{
+    PositionStream.Resize(VertexPositions.size());
+    for (unsigned int i = 0; i < VertexPositions.size(); i++)
+    {
+        PositionStream.X[i] = VertexPositions[i][0];
+        PositionStream.Y[i] = VertexPositions[i][1];
+        PositionStream.Z[i] = VertexPositions[i][2];
+        PositionStream.W[i] = VertexPositions[i][3];
+    }
+}
+
+void Mesh::Compact()
+{
+    size_t bytesBefore = GetMemoryUsage();
+
+    AttributeCompression::QuantizePositions(VertexPositions, QuantizedPositions);
+    EncodedNormals.resize(VertexNormals.size());
+    for (unsigned int i = 0; i < VertexNormals.size(); i++)
+        EncodedNormals[i] = AttributeCompression::EncodeNormal(VertexNormals[i]);
+    EncodedTexCoords.resize(VertexTexCoords.size());
+    for (unsigned int i = 0; i < VertexTexCoords.size(); i++)
+        EncodedTexCoords[i] = AttributeCompression::EncodeTexCoord(VertexTexCoords[i]);
+
+    // Error against the arrays about to be freed, positions relative to the diagonal
+    double diagonal = std::max(Vec4::Length3(GetDimensions()), AL_DBL_EPSILON);
+    double positionError = 0.0;
+    for (unsigned int i = 0; i < VertexPositions.size(); i++)
+        positionError = std::max(positionError, Vec4::Length3(QuantizedPositions.Get(i) - VertexPositions[i]));
+    double normalError = 0.0;
+    for (unsigned int i = 0; i < VertexNormals.size(); i++)
+    {
+        double cosine = Vec4::Dot3(AttributeCompression::DecodeNormal(EncodedNormals[i]), 
+            Vec4::Normalize3(VertexNormals[i]));
+        normalError = std::max(normalError, acos(std::min(std::max(cosine, -1.0), 1.0)));
+    }
+    double texCoordError = 0.0;
+    for (unsigned int i = 0; i < VertexTexCoords.size(); i++)
+    {
+        Vec4 decoded = AttributeCompression::DecodeTexCoord(EncodedTexCoords[i]);
+        for (int j = 0; j < 2; j++)
+            texCoordError = std::max(texCoordError, abs(decoded[j] - VertexTexCoords[i][j]));
+    }
+
+    // The hierarchy is built over the decoded positions so picking hits what is drawn
+    for (unsigned int i = 0; i < VertexPositions.size(); i++)
+        VertexPositions[i] = QuantizedPositions.Get(i);
+    bvh.Build(geos, VertexPositions);
+
+    std::vector<Vec4>().swap(VertexPositions);
+    std::vector<Vec4>().swap(VertexNormals);
+    std::vector<Vec4>().swap(VertexTexCoords);
+    PositionStream = PointStream();
+    isCompact = true;
+
+    size_t bytesAfter = GetMemoryUsage() - bvh.GetMemoryUsage();
+    LOG_INFO("Mesh::Compact: {0} MB of vertex data saved, max errors: position {1} of the diagonal, "
+        "normal {2} degrees, texture coordinate {3}.", (bytesBefore - bytesAfter) / (1024.0 * 1024.0), 
+        positionError / diagonal, ToDegrees(normalError), texCoordError);
+}
+
+void Mesh::CalculateMinMaxDimensions()
+{
+    if (VertexPositions.size() == 0)
+        return;
+
+    maxDimensions = VertexPositions[0];
+    minDimensions = VertexPositions[0];
+    for (const Vec4& vertPos : VertexPositions)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            maxDimensions[i] = (vertPos[i] > maxDimensions[i]) ? vertPos[i] : maxDimensions[i];
+            minDimensions[i] = (vertPos[i] < minDimensions[i]) ? vertPos[i] : minDimensions[i];
+        }
+    }
+}
+
+Geometry* Mesh::BuildBoundingBox(const Vec4& minDimensions, const Vec4& maxDimensions)
+{
+    Geometry* box = new Geometry();
+    box->MinDimensions = minDimensions;
+    box->MaxDimensions = maxDimensions;
+
+    int start = VertexPositions.size();
+    VertexPositions.push_back(Vec4(minDimensions[0], minDimensions[1], maxDimensions[2])); // front bottom left
+    VertexPositions.push_back(Vec4(minDimensions[0], maxDimensions[1], maxDimensions[2])); // front top left
+    VertexPositions.push_back(Vec4(maxDimensions[0], maxDimensions[1], maxDimensions[2])); // front top right
+    VertexPositions.push_back(Vec4(maxDimensions[0], minDimensions[1], maxDimensions[2])); // front bottom right
+    VertexPositions.push_back(Vec4(minDimensions[0], minDimensions[1], minDimensions[2])); // back bottom left
+    VertexPositions.push_back(Vec4(minDimensions[0], maxDimensions[1], minDimensions[2])); // back top left
+    VertexPositions.push_back(Vec4(maxDimensions[0], maxDimensions[1], minDimensions[2])); // back top right
+    VertexPositions.push_back(Vec4(maxDimensions[0], minDimensions[1], minDimensions[2])); // back bottom right
+
+    for (int i = 0; i < 8; i++)
+        box->AddVertex(start + i);
+
+    // Front, back, left, right, top and bottom faces
+    static const unsigned int faces[6][4] = { 
+        { 0, 1, 2, 3 }, { 4, 5, 6, 7 }, { 4, 5, 1, 0 }, 
+        { 7, 6, 2, 3 }, { 1, 5, 6, 2 }, { 0, 4, 7, 3 } 
+    };
+    Vec4 mid = (minDimensions + maxDimensions) * 0.5;
+    Vec4 normals[6] = { 
+        Vec4(0.0, 0.0, 1.0, 0.0), Vec4(0.0, 0.0, -1.0, 0.0), Vec4(-1.0, 0.0, 0.0, 0.0), 
+        Vec4(1.0, 0.0, 0.0, 0.0), Vec4(0.0, 1.0, 0.0, 0.0), Vec4(0.0, -1.0, 0.0, 0.0) 
+    };
+    Vec4 centers[6] = {
+        Vec4(mid[0], mid[1], maxDimensions[2]), Vec4(mid[0], mid[1], minDimensions[2]),
+        Vec4(minDimensions[0], mid[1], mid[2]), Vec4(maxDimensions[0], mid[1], mid[2]),
+        Vec4(mid[0], maxDimensions[1], mid[2]), Vec4(mid[0], minDimensions[1], mid[2])
+    };
+
+    for (int f = 0; f < 6; f++)
+    {
+        box->PolygonVertices.insert(box->PolygonVertices.end(), faces[f], faces[f] + 4);
+        box->EndPolygon(normals[f], centers[f]);
+    }
+    box->BuildAdjacency();
+
+    return box;
+}
\ No newline at end of file
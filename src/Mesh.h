@@ -0,0 +1,113 @@
+#pragma once
+
+#include "pch.h"
+#include "Geometry.h"
+#include "MeshBVH.h"
+#include "AttributeCompression.h"
+#include "LoadProgress.h"
+#include <thread>
+#include <atomic>
+
+struct TriangulationBuffers;
+struct ObjData;
+
+// Geometry loaded from a file, shared by every model placed from that file.
+// Nothing changes it once it is loaded, except its levels of detail which
+// are built in the background and only read once AreLodsReady.
+// With Settings::IsCompactVertexStorageEnabled the vertex arrays are encoded
+// once loaded and the Vec4 arrays are freed, read them through GetPosition,
+// GetNormal and GetTexCoord.
+class Mesh
+{
+public:
+    Mesh();
+    ~Mesh();
+
+    Mesh(Mesh const&) = delete;
+    void operator=(Mesh const&) = delete;
+
+    // Returns false if the file can't be read or progress was cancelled
+    bool LoadFromFile(const std::string& filename, LoadProgress* progress = NULL);
+    // Mesh of faces firstFace to lastFace - 1 of data to show while the file
+    // loads, with polygon normals only. vertexIndices must have a -1 for every
+    // position and is left that way.
+    static Mesh* BuildPreview(const ObjData& data, unsigned int firstFace, unsigned int lastFace,
+        std::vector<int>& vertexIndices);
+
+    unsigned int GetGeometryCount() const;
+    const Geometry* GetGeometry(unsigned int index) const;
+
+    // Bytes allocated for the vertex arrays, geometries and ready levels of detail
+    size_t GetMemoryUsage() const;
+
+    const Vec4& GetMinDimensions() const;
+    const Vec4& GetMaxDimensions() const;
+    Vec4 GetDimensions() const;
+    Vec4 GetBBoxCenter() const;
+
+    // Levels of detail are built in the background after loading
+    bool AreLodsReady() const;
+
+    // Nearest polygon hit by an object space ray at 0 < t < hit.T, updates hit
+    bool Intersect(const Vec4& origin, const Vec4& direction, MeshBVHHit& hit) const;
+
+    bool IsCompact() const { return isCompact; }
+    Vec4 GetPosition(unsigned int id) const { return isCompact ? QuantizedPositions.Get(id) : VertexPositions[id]; }
+    Vec4 GetNormal(unsigned int id) const;
+    Vec4 GetTexCoord(unsigned int id) const;
+    // Transforms every position (w = 1) by transform, compact positions are
+    // decoded inside the batch transform
+    void TransformPositions(const Mat4& transform, PointStream& transformed) const;
+
+private:
+    // Parses an OBJ, STL or PLY file by its extension into geometries
+    bool LoadFromSource(const std::string& filename, LoadProgress* progress);
+    bool LoadFromCache(const std::string& filename);
+    void SaveToCache(const std::string& filename);
+    Vec4 CalculatePolyNormal(const Geometry* geo, const unsigned int* vertices,
+        unsigned int size) const;
+    // Not normalized
+    Vec4 CalculateVertexNormal(const Geometry* geo, unsigned int v) const;
+    // Angle weighted average of the polygon normals for the vertices without
+    // one, threadCount 0 picks one thread per core for large geometries
+    void CalculateVertexNormals(Geometry* geo, unsigned int threadCount = 0);
+    unsigned int AddVertex(Geometry* geo, int posID, int texID, int normID);
+    void TriangulateFace(Geometry* geo, unsigned int face, TriangulationBuffers& buffers);
+    void SortByFirstUse(std::vector<Vec4>& values, std::vector<int> Geometry::* ids);
+    void CalculateMinMaxDimensions();
+    Geometry* BuildBoundingBox(const Vec4& minDimensions, const Vec4& maxDimensions);
+    void BuildGeoBoundingBox(Geometry* geo);
+    void BuildMeshBoundingBox();
+    void BuildPositionStream();
+    void BuildLods();
+    // Encodes the vertex arrays and frees them, logs the memory saved and the error
+    void Compact();
+
+public:
+    std::vector<Vec4> VertexTexCoords;
+    std::vector<Vec4> VertexPositions;
+    std::vector<Vec4> VertexNormals;
+
+    // VertexPositions laid out as structure of arrays for batch transforms
+    PointStream PositionStream;
+
+    Geometry* BoundingBox;
+
+    // Replace the arrays above once the mesh is compact. Normals are
+    // octahedral, texture coordinates are u and v as half floats.
+    QuantizedPointStream QuantizedPositions;
+    std::vector<uint32_t> EncodedNormals;
+    std::vector<uint32_t> EncodedTexCoords;
+
+private:
+    std::vector<Geometry*> geos;
+    MeshBVH bvh;
+    bool isCompact;
+
+    std::thread lodThread;
+    std::atomic<bool> areLodsReady;
+    std::atomic<bool> isLodCancelled;
+
+    Vec4 minDimensions;
+    Vec4 maxDimensions;
+};
\ No newline at end of file
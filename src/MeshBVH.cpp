@@ -0,0 +1,362 @@
+#include "MeshBVH.h"
+#include "Mesh.h"
+
+// SSE2 is part of x86-64, the box test needs no run time dispatch
+#if defined(__SSE2__) && !defined(CPU_NO_KERNELS)
+#define MESH_BVH_SSE2
+#include <emmintrin.h>
+#endif
+
+#define MESH_BVH_BIN_COUNT 16
+// Nodes with up to MIN polygons are never split, nodes with more than MAX
+// always are unless their centers are all equal
+#define MESH_BVH_MIN_LEAF_SIZE 4
+#define MESH_BVH_MAX_LEAF_SIZE 16
+// Cost of visiting a node, relative to testing a polygon
+#define MESH_BVH_TRAVERSAL_COST 1.0
+// Usual traversal stack depth, it grows past it if needed
+#define MESH_BVH_STACK_SIZE 64
+
+static double GetHalfArea(const double* min, const double* max)
+{
+    double dx = max[0] - min[0];
+    double dy = max[1] - min[1];
+    double dz = max[2] - min[2];
+    return dx * dy + dy * dz + dz * dx;
+}
+
+static void ResetBounds(double* min, double* max)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        min[i] = std::numeric_limits<double>::max();
+        max[i] = -std::numeric_limits<double>::max();
+    }
+    min[3] = 0.0;
+    max[3] = 0.0;
+}
+
+static void GrowBounds(double* min, double* max, const double* pMin, const double* pMax)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        min[i] = std::min(min[i], pMin[i]);
+        max[i] = std::max(max[i], pMax[i]);
+    }
+}
+
+// Entry distance of the ray into the node's box, false if it misses it before tMax
+static inline bool IntersectBox(const MeshBVHNode& node, const double* origin, const double* invDirection,
+    double tMax, double& tEnter)
+{
+#ifdef MESH_BVH_SSE2
+    // x and y in one register, z on its own. The operands are ordered like
+    // std::min and std::max so NaN slabs give the scalar result.
+    __m128d o = _mm_loadu_pd(origin);
+    __m128d inv = _mm_loadu_pd(invDirection);
+    __m128d t1 = _mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(node.Min), o), inv);
+    __m128d t2 = _mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(node.Max), o), inv);
+    __m128d tNear = _mm_min_pd(t2, t1);
+    __m128d tFar = _mm_max_pd(t2, t1);
+    tNear = _mm_max_sd(_mm_unpackhi_pd(tNear, tNear), tNear);
+    tFar = _mm_min_sd(_mm_unpackhi_pd(tFar, tFar), tFar);
+
+    double tz1 = (node.Min[2] - origin[2]) * invDirection[2];
+    double tz2 = (node.Max[2] - origin[2]) * invDirection[2];
+    tEnter = std::max(_mm_cvtsd_f64(tNear), std::max(std::min(tz1, tz2), 0.0));
+    double tExit = std::min(_mm_cvtsd_f64(tFar), std::min(std::max(tz1, tz2), tMax));
+#else
+    double tNear[3], tFar[3];
+    for (int i = 0; i < 3; i++)
+    {
+        double t1 = (node.Min[i] - origin[i]) * invDirection[i];
+        double t2 = (node.Max[i] - origin[i]) * invDirection[i];
+        tNear[i] = std::min(t1, t2);
+        tFar[i] = std::max(t1, t2);
+    }
+    tEnter = std::max(std::max(tNear[0], tNear[1]), std::max(tNear[2], 0.0));
+    double tExit = std::min(std::min(tFar[0], tFar[1]), std::min(tFar[2], tMax));
+#endif
+    return tEnter <= tExit;
+}
+
+// Moller-Trumbore, both sides
+static inline bool IntersectTriangle(const Vec4& origin, const Vec4& direction,
+    const Vec4& v0, const Vec4& v1, const Vec4& v2, double& t)
+{
+    Vec4 edge1 = v1 - v0;
+    Vec4 edge2 = v2 - v0;
+    Vec4 p = Vec4::Cross(direction, edge2);
+    double det = Vec4::Dot3(edge1, p);
+    if (det == 0.0)
+        return false;
+
+    double invDet = 1.0 / det;
+    Vec4 s = origin - v0;
+    double u = Vec4::Dot3(s, p) * invDet;
+    if ((u < 0.0) || (u > 1.0))
+        return false;
+
+    Vec4 q = Vec4::Cross(s, edge1);
+    double v = Vec4::Dot3(direction, q) * invDet;
+    if ((v < 0.0) || (u + v > 1.0))
+        return false;
+
+    t = Vec4::Dot3(edge2, q) * invDet;
+    return true;
+}
+
+void MeshBVH::Build(const std::vector<Geometry*>& geos, const std::vector<Vec4>& positions)
+{
+    Clear();
+    clock_t start = clock();
+
+    // Bounds and center of every polygon
+    std::vector<Vec4> mins;
+    std::vector<Vec4> maxs;
+    std::vector<Vec4> centers;
+    for (unsigned int g = 0; g < geos.size(); g++)
+    {
+        const Geometry* geo = geos[g];
+        for (unsigned int p = 0; p < geo->GetPolygonCount(); p++)
+        {
+            const unsigned int* vertices = geo->GetPolygonVertices(p);
+            unsigned int size = geo->GetPolygonSize(p);
+            if (size < 3)
+                continue;
+
+            Vec4 pMin = positions[geo->VertexPositionIDs[vertices[0]]];
+            Vec4 pMax = pMin;
+            for (unsigned int i = 1; i < size; i++)
+            {
+                const Vec4& pos = positions[geo->VertexPositionIDs[vertices[i]]];
+                for (int j = 0; j < 3; j++)
+                {
+                    pMin[j] = std::min(pMin[j], pos[j]);
+                    pMax[j] = std::max(pMax[j], pos[j]);
+                }
+            }
+
+            MeshBVHPolygon polygon = { g, p };
+            polygons.push_back(polygon);
+            mins.push_back(pMin);
+            maxs.push_back(pMax);
+            centers.push_back((pMin + pMax) / 2.0);
+        }
+    }
+
+    unsigned int polygonCount = polygons.size();
+    if (polygonCount == 0)
+        return;
+
+    // Polygons are sorted through this array, nodes own contiguous ranges of it
+    std::vector<unsigned int> order(polygonCount);
+    for (unsigned int i = 0; i < polygonCount; i++)
+        order[i] = i;
+
+    nodes.reserve(2 * polygonCount / MESH_BVH_MIN_LEAF_SIZE + 1);
+    MeshBVHNode root;
+    root.First = 0;
+    root.Count = polygonCount;
+    nodes.push_back(root);
+
+    std::vector<unsigned int> stack(1, 0);
+    while (!stack.empty())
+    {
+        unsigned int n = stack.back();
+        stack.pop_back();
+        unsigned int first = nodes[n].First;
+        unsigned int count = nodes[n].Count;
+
+        double centerMin[4], centerMax[4];
+        ResetBounds(nodes[n].Min, nodes[n].Max);
+        ResetBounds(centerMin, centerMax);
+        for (unsigned int i = first; i < first + count; i++)
+        {
+            const double* center = &centers[order[i]][0];
+            GrowBounds(nodes[n].Min, nodes[n].Max, &mins[order[i]][0], &maxs[order[i]][0]);
+            GrowBounds(centerMin, centerMax, center, center);
+        }
+
+        // Cheapest split over the bins of every axis
+        double area = GetHalfArea(nodes[n].Min, nodes[n].Max);
+        double leafCost = count * area;
+        double bestCost = std::numeric_limits<double>::max();
+        int bestAxis = -1;
+        int bestBin = 0;
+        for (int axis = 0; (axis < 3) && (count > MESH_BVH_MIN_LEAF_SIZE); axis++)
+        {
+            double extent = centerMax[axis] - centerMin[axis];
+            if (extent <= 0.0)
+                continue;
+
+            double binMin[MESH_BVH_BIN_COUNT][4], binMax[MESH_BVH_BIN_COUNT][4];
+            unsigned int binCounts[MESH_BVH_BIN_COUNT] = { 0 };
+            for (int b = 0; b < MESH_BVH_BIN_COUNT; b++)
+                ResetBounds(binMin[b], binMax[b]);
+
+            double scale = MESH_BVH_BIN_COUNT / extent;
+            for (unsigned int i = first; i < first + count; i++)
+            {
+                unsigned int id = order[i];
+                int b = std::min((int)((centers[id][axis] - centerMin[axis]) * scale), MESH_BVH_BIN_COUNT - 1);
+                binCounts[b]++;
+                GrowBounds(binMin[b], binMax[b], &mins[id][0], &maxs[id][0]);
+            }
+
+            // Right side areas from the top, then sweep the left side up
+            double rightCosts[MESH_BVH_BIN_COUNT];
+            double sideMin[4], sideMax[4];
+            unsigned int sideCount = 0;
+            ResetBounds(sideMin, sideMax);
+            for (int b = MESH_BVH_BIN_COUNT - 1; b > 0; b--)
+            {
+                sideCount += binCounts[b];
+                GrowBounds(sideMin, sideMax, binMin[b], binMax[b]);
+                rightCosts[b] = (sideCount > 0) ? sideCount * GetHalfArea(sideMin, sideMax) : 0.0;
+            }
+
+            sideCount = 0;
+            ResetBounds(sideMin, sideMax);
+            for (int b = 0; b < MESH_BVH_BIN_COUNT - 1; b++)
+            {
+                sideCount += binCounts[b];
+                GrowBounds(sideMin, sideMax, binMin[b], binMax[b]);
+                if ((sideCount == 0) || (sideCount == count))
+                    continue;
+
+                double cost = sideCount * GetHalfArea(sideMin, sideMax) + rightCosts[b + 1];
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = b;
+                }
+            }
+        }
+
+        if ((bestAxis < 0) || 
+            ((bestCost + MESH_BVH_TRAVERSAL_COST * area >= leafCost) && (count <= MESH_BVH_MAX_LEAF_SIZE)))
+            continue;
+
+        // Polygons in bins up to bestBin go left
+        double splitMin = centerMin[bestAxis];
+        double scale = MESH_BVH_BIN_COUNT / (centerMax[bestAxis] - centerMin[bestAxis]);
+        unsigned int* middle = std::partition(&order[first], &order[first] + count,
+            [&](unsigned int id) {
+                int b = std::min((int)((centers[id][bestAxis] - splitMin) * scale), MESH_BVH_BIN_COUNT - 1);
+                return b <= bestBin;
+            });
+        unsigned int leftCount = middle - &order[first];
+
+        MeshBVHNode left, right;
+        left.First = first;
+        left.Count = leftCount;
+        right.First = first + leftCount;
+        right.Count = count - leftCount;
+
+        nodes[n].First = nodes.size();
+        nodes[n].Count = 0;
+        nodes.push_back(left);
+        nodes.push_back(right);
+        stack.push_back(nodes.size() - 2);
+        stack.push_back(nodes.size() - 1);
+    }
+
+    std::vector<MeshBVHPolygon> sorted(polygonCount);
+    for (unsigned int i = 0; i < polygonCount; i++)
+        sorted[i] = polygons[order[i]];
+    polygons.swap(sorted);
+
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    LOG_INFO("MeshBVH: {0} polygons, {1} nodes in {2} s.", polygonCount, nodes.size(), seconds);
+}
+
+void MeshBVH::Clear()
+{
+    std::vector<MeshBVHNode>().swap(nodes);
+    std::vector<MeshBVHPolygon>().swap(polygons);
+}
+
+bool MeshBVH::Intersect(const Mesh* mesh, const Vec4& origin, const Vec4& direction, 
+    MeshBVHHit& hit) const
+{
+    if (nodes.empty())
+        return false;
+
+    // Zero components would give 0 * infinity in the slab test
+    double rayOrigin[4] = { origin[0], origin[1], origin[2], 0.0 };
+    double invDirection[4] = { 0.0, 0.0, 0.0, 0.0 };
+    for (int i = 0; i < 3; i++)
+    {
+        double d = (abs(direction[i]) > 1e-300) ? direction[i] : 1e-300;
+        invDirection[i] = 1.0 / d;
+    }
+
+    bool isHit = false;
+    double tEnter;
+    if (!IntersectBox(nodes[0], rayOrigin, invDirection, hit.T, tEnter))
+        return false;
+
+    // Nodes to visit with their entry distance, they are skipped once a hit is nearer
+    std::vector<std::pair<unsigned int, double> > stack;
+    stack.reserve(MESH_BVH_STACK_SIZE);
+    stack.push_back(std::make_pair(0u, tEnter));
+    while (!stack.empty())
+    {
+        std::pair<unsigned int, double> entry = stack.back();
+        stack.pop_back();
+        if (entry.second >= hit.T)
+            continue;
+
+        const MeshBVHNode& node = nodes[entry.first];
+        if (node.Count > 0)
+        {
+            for (unsigned int i = node.First; i < node.First + node.Count; i++)
+            {
+                const Geometry* geo = mesh->GetGeometry(polygons[i].GeometryIndex);
+                unsigned int p = polygons[i].Polygon;
+                const unsigned int* vertices = geo->GetPolygonVertices(p);
+                unsigned int size = geo->GetPolygonSize(p);
+                Vec4 v0 = mesh->GetPosition(geo->VertexPositionIDs[vertices[0]]);
+                for (unsigned int j = 1; j + 1 < size; j++)
+                {
+                    double t;
+                    if (IntersectTriangle(origin, direction, v0, mesh->GetPosition(geo->VertexPositionIDs[vertices[j]]),
+                        mesh->GetPosition(geo->VertexPositionIDs[vertices[j + 1]]), t) && (t > 0.0) && (t < hit.T))
+                    {
+                        hit.T = t;
+                        hit.GeometryIndex = polygons[i].GeometryIndex;
+                        hit.Polygon = p;
+                        isHit = true;
+                    }
+                }
+            }
+            continue;
+        }
+
+        // Push the farther child first so the nearer one is visited first
+        double tLeft, tRight;
+        bool isLeftHit = IntersectBox(nodes[node.First], rayOrigin, invDirection, hit.T, tLeft);
+        bool isRightHit = IntersectBox(nodes[node.First + 1], rayOrigin, invDirection, hit.T, tRight);
+        if (isLeftHit && isRightHit && (tLeft <= tRight))
+        {
+            stack.push_back(std::make_pair(node.First + 1, tRight));
+            stack.push_back(std::make_pair(node.First, tLeft));
+        }
+        else
+        {
+            if (isLeftHit)
+                stack.push_back(std::make_pair(node.First, tLeft));
+            if (isRightHit)
+                stack.push_back(std::make_pair(node.First + 1, tRight));
+        }
+    }
+
+    return isHit;
+}
+
+size_t MeshBVH::GetMemoryUsage() const
+{
+    return GetVectorBytes(nodes) + GetVectorBytes(polygons);
+}
\ No newline at end of file
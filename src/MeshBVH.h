@@ -0,0 +1,54 @@
+#pragma once
+
+#include "pch.h"
+#include "Geometry.h"
+
+class Mesh;
+
+// Nearest polygon hit by a ray, T is in units of the ray's direction
+struct MeshBVHHit
+{
+    double T;
+    unsigned int GeometryIndex;
+    unsigned int Polygon;
+
+    MeshBVHHit() : T(std::numeric_limits<double>::max()), GeometryIndex(0), Polygon(0) {}
+};
+
+// Bounds are padded to 4 doubles for the AVX slab test. Inner nodes have
+// Count 0 and their children at First and First + 1, leaves use polygons
+// First to First + Count - 1.
+struct MeshBVHNode
+{
+    double Min[4];
+    double Max[4];
+    unsigned int First;
+    unsigned int Count;
+};
+
+struct MeshBVHPolygon
+{
+    unsigned int GeometryIndex;
+    unsigned int Polygon;
+};
+
+// Bounding volume hierarchy over a model's polygons in object space, split
+// with the surface area heuristic over binned polygon centers.
+class MeshBVH
+{
+public:
+    void Build(const std::vector<Geometry*>& geos, const std::vector<Vec4>& positions);
+    void Clear();
+
+    // Finds the nearest polygon hit at 0 < t < hit.T and updates hit. The mesh
+    // must have the geometries and positions the hierarchy was built from.
+    // Polygons are tested as triangle fans.
+    bool Intersect(const Mesh* mesh, const Vec4& origin, const Vec4& direction, 
+        MeshBVHHit& hit) const;
+
+    size_t GetMemoryUsage() const;
+
+private:
+    std::vector<MeshBVHNode> nodes;
+    std::vector<MeshBVHPolygon> polygons;
+};
\ No newline at end of file
@@ -0,0 +1,130 @@
+#include "MeshCache.h"
+#include "ModelCache.h"
+
+#include <cstdlib>
+#include <climits>
+#include <cstdio>
+#include <chrono>
+
+// How often a load waiting for another thread's load checks its own cancellation
+#define MESH_CACHE_WAIT_MS 50
+
+std::mutex MeshCache::mutex;
+std::map<std::string, MeshCacheEntry> MeshCache::meshes;
+
+static std::string GetCanonicalPath(const std::string& filename)
+{
+#ifndef _WIN32
+    char path[PATH_MAX];
+    if (realpath(filename.c_str(), path) == NULL)
+        return filename;
+#else
+    char path[_MAX_PATH];
+    if (_fullpath(path, filename.c_str(), _MAX_PATH) == NULL)
+        return filename;
+#endif
+    return path;
+}
+
+std::shared_ptr<const Mesh> MeshCache::Load(const std::string& filename, LoadProgress* progress)
+{
+    std::string key = GetKey(filename);
+    if (key.empty())
+    {
+        std::shared_ptr<Mesh> loaded(new Mesh());
+        if (!loaded->LoadFromFile(filename, progress))
+            return std::shared_ptr<const Mesh>();
+        return loaded;
+    }
+
+    // Either share the loaded mesh, wait for the thread loading the file or
+    // mark the file as loading by this thread
+    std::promise<std::shared_ptr<const Mesh> > promise;
+    while (true)
+    {
+        std::shared_future<std::shared_ptr<const Mesh> > loading;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            MeshCacheEntry& entry = meshes[key];
+            std::shared_ptr<const Mesh> mesh = entry.Loaded.lock();
+            if (mesh)
+            {
+                LOG_INFO("MeshCache: {0} is already loaded, sharing its mesh.", filename.c_str());
+                return mesh;
+            }
+            if (!entry.Loading.valid())
+            {
+                entry.Loading = promise.get_future().share();
+                break;
+            }
+            loading = entry.Loading;
+        }
+
+        LOG_INFO("MeshCache: {0} is being loaded, waiting for it.", filename.c_str());
+        while (loading.wait_for(std::chrono::milliseconds(MESH_CACHE_WAIT_MS)) != std::future_status::ready)
+        {
+            if (IsLoadCancelled(progress))
+                return std::shared_ptr<const Mesh>();
+        }
+
+        // The other load failed or was cancelled, try again
+        std::shared_ptr<const Mesh> mesh = loading.get();
+        if (mesh)
+            return mesh;
+    }
+
+    std::shared_ptr<const Mesh> mesh;
+    std::shared_ptr<Mesh> loaded(new Mesh());
+    if (loaded->LoadFromFile(filename, progress))
+        mesh = loaded;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        MeshCacheEntry& entry = meshes[key];
+        entry.Loaded = mesh;
+        entry.Loading = std::shared_future<std::shared_ptr<const Mesh> >();
+
+        // Drop the entries of freed meshes
+        for (auto it = meshes.begin(); it != meshes.end();)
+        {
+            if (it->second.Loaded.expired() && !it->second.Loading.valid())
+                it = meshes.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    // Wakes the loads waiting for this one
+    promise.set_value(mesh);
+    return mesh;
+}
+
+unsigned int MeshCache::GetMeshCount()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    unsigned int count = 0;
+    for (const auto& entry : meshes)
+    {
+        if (!entry.second.Loaded.expired())
+            count++;
+    }
+    return count;
+}
+
+std::string MeshCache::GetKey(const std::string& filename)
+{
+    ModelSourceKey source;
+    if (!ModelCache::GetSourceKey(filename, source))
+        return std::string();
+
+    // Every digit, to_string would round small epsilons to 0
+    char weldEpsilon[32] = "-";
+    if (Settings::IsVertexWeldingEnabled)
+        snprintf(weldEpsilon, sizeof(weldEpsilon), "%.17g", Settings::VertexWeldEpsilon);
+
+    return GetCanonicalPath(filename) + "|" + std::to_string(source.Size) + "|" + 
+        std::to_string(source.Time) + "|" + std::to_string(source.Hash) + "|" + 
+        std::to_string(Settings::IsTriangulationEnabled) + 
+        std::to_string(Settings::IsMeshOptimizationEnabled) + std::to_string(Settings::IsLodEnabled) + 
+        std::to_string(Settings::IsCompactVertexStorageEnabled) + "|" + weldEpsilon;
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "pch.h"
+#include "Mesh.h"
+#include "LoadProgress.h"
+#include <map>
+#include <mutex>
+#include <future>
+
+struct MeshCacheEntry
+{
+    std::weak_ptr<const Mesh> Loaded;
+    // Valid while a thread loads the file, other loads of it wait for it
+    std::shared_future<std::shared_ptr<const Mesh> > Loading;
+};
+
+// Meshes loaded from files, shared by every model placed from the same file.
+// A mesh is found again by the file's canonical path, its size, modification
+// time and content hash and the settings that change what is loaded from it.
+// Only weak references are kept, a mesh is freed with the last model using it.
+// A file is parsed once even when several threads load it at the same time.
+class MeshCache
+{
+public:
+    // Returns NULL if the file can't be loaded or progress was cancelled.
+    // Safe to call from several loading threads at once, a thread loading a
+    // file that another one is loading waits for its mesh.
+    static std::shared_ptr<const Mesh> Load(const std::string& filename, LoadProgress* progress = NULL);
+
+    // Meshes still used by a model
+    static unsigned int GetMeshCount();
+
+private:
+    // Empty if the file can't be read
+    static std::string GetKey(const std::string& filename);
+
+private:
+    static std::mutex mutex;
+    static std::map<std::string, MeshCacheEntry> meshes;
+};
\ No newline at end of file
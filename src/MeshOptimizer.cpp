@@ -0,0 +1,307 @@
+#include "MeshOptimizer.h"
+
+#include <cstdint>
+
+// Polygons only join a cluster if their normal is within about 45 degrees of its first one
+#define CLUSTER_MIN_NORMAL_DOT 0.7
+
+// Spreads the low 10 bits of x to every third bit
+static uint32_t SpreadBits(uint32_t x)
+{
+    x &= 0x3ff;
+    x = (x | (x << 16)) & 0x030000ff;
+    x = (x | (x << 8)) & 0x0300f00f;
+    x = (x | (x << 4)) & 0x030c30c3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+void MeshOptimizer::Optimize(Geometry* geo, unsigned int cacheSize)
+{
+    if (geo->GetPolygonCount() == 0)
+        return;
+
+    double before = CalculateACMR(geo, cacheSize);
+    clock_t start = clock();
+
+    // Spatial order first, Tipsify falls back to it when it reaches a dead end
+    SortPolygonsMorton(geo);
+    SortVerticesByFirstUse(geo);
+    SortPolygonsTipsify(geo, cacheSize);
+    SortVerticesByFirstUse(geo);
+
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    LOG_INFO("MeshOptimizer: {0} polygons, ACMR {1} -> {2} (cache size {3}) in {4} s.", 
+        geo->GetPolygonCount(), before, CalculateACMR(geo, cacheSize), cacheSize, seconds);
+}
+
+double MeshOptimizer::CalculateACMR(const Geometry* geo, unsigned int cacheSize)
+{
+    unsigned int polygonCount = geo->GetPolygonCount();
+    if (polygonCount == 0)
+        return 0.0;
+
+    // A vertex is in the FIFO cache if fewer than cacheSize misses happened since it was loaded
+    std::vector<unsigned int> loadTime(geo->GetVertexCount(), 0);
+    unsigned int time = cacheSize + 1;
+    unsigned int misses = 0;
+    for (unsigned int v : geo->PolygonVertices)
+    {
+        if (time - loadTime[v] > cacheSize)
+        {
+            loadTime[v] = time++;
+            misses++;
+        }
+    }
+
+    return (double)misses / polygonCount;
+}
+
+void MeshOptimizer::SortPolygonsMorton(Geometry* geo)
+{
+    unsigned int polygonCount = geo->GetPolygonCount();
+
+    Vec4 extent = geo->MaxDimensions - geo->MinDimensions;
+    double scale[3];
+    for (int i = 0; i < 3; i++)
+        scale[i] = (extent[i] > AL_DBL_EPSILON) ? 1023.0 / extent[i] : 0.0;
+
+    // Sort (code, polygon) pairs, the polygon breaks ties so the sort is stable
+    std::vector<uint64_t> keys(polygonCount);
+    for (unsigned int p = 0; p < polygonCount; p++)
+    {
+        uint32_t code = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            double cell = (geo->PolygonCenters[p][i] - geo->MinDimensions[i]) * scale[i];
+            cell = std::min(std::max(cell, 0.0), 1023.0);
+            code |= SpreadBits((uint32_t)cell) << i;
+        }
+        keys[p] = ((uint64_t)code << 32) | p;
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<unsigned int> order(polygonCount);
+    for (unsigned int i = 0; i < polygonCount; i++)
+        order[i] = (unsigned int)keys[i];
+
+    geo->ReorderPolygons(order);
+}
+
+void MeshOptimizer::SortPolygonsTipsify(Geometry* geo, unsigned int cacheSize)
+{
+    unsigned int vertexCount = geo->GetVertexCount();
+    unsigned int polygonCount = geo->GetPolygonCount();
+    if (geo->VertexPolygonOffsets.empty())
+        geo->BuildAdjacency();
+
+    // Polygons not emitted yet around every vertex
+    std::vector<unsigned int> live(vertexCount);
+    for (unsigned int v = 0; v < vertexCount; v++)
+        live[v] = geo->VertexPolygonOffsets[v + 1] - geo->VertexPolygonOffsets[v];
+
+    std::vector<unsigned int> cacheTime(vertexCount, 0);
+    std::vector<bool> isEmitted(polygonCount, false);
+    std::vector<unsigned int> deadEnd;
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> order;
+    order.reserve(polygonCount);
+
+    unsigned int time = cacheSize + 1;
+    unsigned int cursor = 0;
+    int fanning = (vertexCount > 0) ? 0 : -1;
+
+    while (fanning >= 0)
+    {
+        // Emit every remaining polygon around the fanning vertex
+        candidates.clear();
+        for (unsigned int i = geo->VertexPolygonOffsets[fanning]; 
+            i < geo->VertexPolygonOffsets[fanning + 1]; i++)
+        {
+            unsigned int p = geo->VertexPolygons[i];
+            if (isEmitted[p])
+                continue;
+
+            isEmitted[p] = true;
+            order.push_back(p);
+
+            for (unsigned int j = geo->PolygonOffsets[p]; j < geo->PolygonOffsets[p + 1]; j++)
+            {
+                unsigned int v = geo->PolygonVertices[j];
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cacheTime[v] > cacheSize)
+                    cacheTime[v] = time++;
+            }
+        }
+
+        // Next fanning vertex: the candidate that stays longest in the cache
+        // and will still be there once its polygons are emitted
+        fanning = -1;
+        int bestPriority = -1;
+        for (unsigned int v : candidates)
+        {
+            if (live[v] == 0)
+                continue;
+
+            int priority = 0;
+            if (time - cacheTime[v] + 2 * live[v] <= cacheSize)
+                priority = time - cacheTime[v];
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                fanning = v;
+            }
+        }
+
+        // Dead end: go back to recently used vertices, then to input order
+        while ((fanning == -1) && !deadEnd.empty())
+        {
+            unsigned int v = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[v] > 0)
+                fanning = v;
+        }
+
+        while ((fanning == -1) && (cursor < vertexCount))
+        {
+            if (live[cursor] > 0)
+                fanning = cursor;
+            cursor++;
+        }
+    }
+
+    // Polygons without vertices are never reached
+    for (unsigned int p = 0; p < polygonCount; p++)
+    {
+        if (!isEmitted[p])
+            order.push_back(p);
+    }
+
+    geo->ReorderPolygons(order);
+}
+
+void MeshOptimizer::SortVerticesByFirstUse(Geometry* geo)
+{
+    unsigned int vertexCount = geo->GetVertexCount();
+    const unsigned int unused = std::numeric_limits<unsigned int>::max();
+
+    std::vector<unsigned int> remap(vertexCount, unused);
+    unsigned int next = 0;
+    for (unsigned int v : geo->PolygonVertices)
+    {
+        if (remap[v] == unused)
+            remap[v] = next++;
+    }
+
+    // Vertices of dropped faces go last
+    for (unsigned int v = 0; v < vertexCount; v++)
+    {
+        if (remap[v] == unused)
+            remap[v] = next++;
+    }
+
+    geo->ReorderVertices(remap);
+}
+
+void MeshOptimizer::BuildClusters(Geometry* geo, const std::vector<Vec4>& positions, 
+    unsigned int maxPolygons)
+{
+    unsigned int polygonCount = geo->GetPolygonCount();
+    if (geo->VertexPolygonOffsets.empty())
+        geo->BuildAdjacency();
+
+    // Grow every cluster breadth first over shared vertices, from the first
+    // polygon not in a cluster yet. The order so far keeps them in place.
+    std::vector<bool> isClustered(polygonCount, false);
+    std::vector<unsigned int> order;
+    std::vector<unsigned int> offsets(1, 0);
+    order.reserve(polygonCount);
+
+    for (unsigned int seed = 0; seed < polygonCount; seed++)
+    {
+        if (isClustered[seed])
+            continue;
+
+        const Vec4& seedNormal = geo->PolygonNormals[seed];
+        unsigned int first = order.size();
+        isClustered[seed] = true;
+        order.push_back(seed);
+
+        for (unsigned int i = first; (i < order.size()) && (order.size() - first < maxPolygons); i++)
+        {
+            unsigned int p = order[i];
+            for (unsigned int j = geo->PolygonOffsets[p]; j < geo->PolygonOffsets[p + 1]; j++)
+            {
+                unsigned int v = geo->PolygonVertices[j];
+                for (unsigned int k = geo->VertexPolygonOffsets[v]; 
+                    (k < geo->VertexPolygonOffsets[v + 1]) && (order.size() - first < maxPolygons); k++)
+                {
+                    unsigned int q = geo->VertexPolygons[k];
+                    if (isClustered[q] || 
+                        (Vec4::Dot3(geo->PolygonNormals[q], seedNormal) < CLUSTER_MIN_NORMAL_DOT))
+                        continue;
+
+                    isClustered[q] = true;
+                    order.push_back(q);
+                }
+            }
+        }
+        offsets.push_back(order.size());
+    }
+
+    geo->ReorderPolygons(order);
+    geo->ClusterOffsets.swap(offsets);
+
+    unsigned int clusterCount = geo->GetClusterCount();
+    geo->ClusterSpheres.resize(clusterCount);
+    geo->ClusterCones.resize(clusterCount);
+    for (unsigned int c = 0; c < clusterCount; c++)
+    {
+        unsigned int firstPolygon = geo->ClusterOffsets[c];
+        unsigned int lastPolygon = geo->ClusterOffsets[c + 1];
+        unsigned int firstCorner = geo->PolygonOffsets[firstPolygon];
+        unsigned int lastCorner = geo->PolygonOffsets[lastPolygon];
+
+        // Sphere around the center of the vertices' bounds
+        Vec4 minPos = positions[geo->VertexPositionIDs[geo->PolygonVertices[firstCorner]]];
+        Vec4 maxPos = minPos;
+        for (unsigned int i = firstCorner; i < lastCorner; i++)
+        {
+            const Vec4& pos = positions[geo->VertexPositionIDs[geo->PolygonVertices[i]]];
+            for (int j = 0; j < 3; j++)
+            {
+                minPos[j] = std::min(minPos[j], pos[j]);
+                maxPos[j] = std::max(maxPos[j], pos[j]);
+            }
+        }
+
+        Vec4 center = (minPos + maxPos) / 2.0;
+        double radiusSquared = 0.0;
+        for (unsigned int i = firstCorner; i < lastCorner; i++)
+        {
+            Vec4 offset = positions[geo->VertexPositionIDs[geo->PolygonVertices[i]]] - center;
+            radiusSquared = std::max(radiusSquared, Vec4::Dot3(offset, offset));
+        }
+        geo->ClusterSpheres[c] = Vec4(center[0], center[1], center[2], sqrt(radiusSquared));
+
+        // Cone around the average normal, wide enough for every polygon normal
+        Vec4 axis(0.0, 0.0, 0.0, 0.0);
+        for (unsigned int p = firstPolygon; p < lastPolygon; p++)
+            axis += geo->PolygonNormals[p];
+
+        double length = Vec4::Length3(axis);
+        double minDot = 0.0;
+        if (length > AL_DBL_EPSILON)
+        {
+            axis /= length;
+            minDot = 1.0;
+            for (unsigned int p = firstPolygon; p < lastPolygon; p++)
+                minDot = std::min(minDot, Vec4::Dot3(axis, geo->PolygonNormals[p]));
+        }
+
+        double cutoff = (minDot > 0.0) ? sqrt(std::max(1.0 - minDot * minDot, 0.0)) : 1.0;
+        geo->ClusterCones[c] = Vec4(axis[0], axis[1], axis[2], cutoff);
+    }
+}
\ No newline at end of file
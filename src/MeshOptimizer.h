@@ -0,0 +1,27 @@
+#pragma once
+
+#include "pch.h"
+#include "Geometry.h"
+
+// Reorders a geometry's polygons and vertices for locality. Polygons are
+// first sorted along a Morton curve of their centers, then reordered with
+// Tipsify (Sander et al. 2007) for the post transform vertex cache, and
+// vertices are renumbered by first use. Clusters group neighbouring polygons
+// that face about the same way so they can be culled together.
+class MeshOptimizer
+{
+public:
+    static void Optimize(Geometry* geo, unsigned int cacheSize = 32);
+
+    // Average cache miss ratio: vertex cache misses per polygon with a FIFO cache
+    static double CalculateACMR(const Geometry* geo, unsigned int cacheSize = 32);
+
+    static void SortPolygonsMorton(Geometry* geo);
+    static void SortPolygonsTipsify(Geometry* geo, unsigned int cacheSize);
+    static void SortVerticesByFirstUse(Geometry* geo);
+
+    // Makes polygons of a cluster contiguous and fills the geometry's cluster
+    // arrays. positions are the model's vertex positions.
+    static void BuildClusters(Geometry* geo, const std::vector<Vec4>& positions, 
+        unsigned int maxPolygons = 128);
+};
\ No newline at end of file
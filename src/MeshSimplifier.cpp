@@ -0,0 +1,384 @@
+#include "MeshSimplifier.h"
+
+#include <queue>
+#include <cstdint>
+
+// Boundary constraint planes weigh this much more than surface planes
+#define SIMPLIFIER_BOUNDARY_WEIGHT 100.0
+// A collapse may not turn a triangle's normal by more than about 80 degrees
+#define SIMPLIFIER_MIN_NORMAL_DOT 0.2
+// Collapses that would leave a vertex with more triangles are skipped, they
+// make slivers and only happen on tangled meshes
+#define SIMPLIFIER_MAX_VALENCE 32
+
+// Symmetric 4x4 matrix of the sum of squared distances to a set of planes
+struct Quadric
+{
+    double A[10];
+
+    Quadric()
+    {
+        for (int i = 0; i < 10; i++)
+            A[i] = 0.0;
+    }
+
+    // Plane n.p + d = 0 with unit normal n
+    void AddPlane(const Vec4& n, double d, double weight)
+    {
+        A[0] += weight * n[0] * n[0]; A[1] += weight * n[0] * n[1]; A[2] += weight * n[0] * n[2];
+        A[3] += weight * n[0] * d;    A[4] += weight * n[1] * n[1]; A[5] += weight * n[1] * n[2];
+        A[6] += weight * n[1] * d;    A[7] += weight * n[2] * n[2]; A[8] += weight * n[2] * d;
+        A[9] += weight * d * d;
+    }
+
+    Quadric& operator +=(const Quadric& q)
+    {
+        for (int i = 0; i < 10; i++)
+            A[i] += q.A[i];
+        return *this;
+    }
+
+    double GetError(const Vec4& p) const
+    {
+        double x = p[0], y = p[1], z = p[2];
+        return A[0] * x * x + 2.0 * A[1] * x * y + 2.0 * A[2] * x * z + 2.0 * A[3] * x +
+            A[4] * y * y + 2.0 * A[5] * y * z + 2.0 * A[6] * y + 
+            A[7] * z * z + 2.0 * A[8] * z + A[9];
+    }
+};
+
+struct EdgeCollapse
+{
+    double Cost;
+    unsigned int Removed;
+    unsigned int Kept;
+    unsigned int RemovedStamp;
+    unsigned int KeptStamp;
+
+    bool operator >(const EdgeCollapse& e) const { return Cost > e.Cost; }
+};
+
+typedef std::priority_queue<EdgeCollapse, std::vector<EdgeCollapse>, 
+    std::greater<EdgeCollapse> > CollapseQueue;
+
+// Working state of one simplification
+struct SimplifierMesh
+{
+    const Geometry* Source;
+    const std::vector<Vec4>* Positions;
+
+    std::vector<unsigned int> Triangles;
+    std::vector<bool> IsTriangleAlive;
+    unsigned int AliveTriangles;
+
+    std::vector<Quadric> Quadrics;
+    std::vector<std::vector<unsigned int> > VertexTriangles;
+    std::vector<bool> IsVertexRemoved;
+    std::vector<unsigned int> Stamps;
+
+    const Vec4& GetPosition(unsigned int v) const
+    {
+        return (*Positions)[Source->VertexPositionIDs[v]];
+    }
+};
+
+static Vec4 GetTriangleNormal(const Vec4& a, const Vec4& b, const Vec4& c)
+{
+    return Vec4::Cross(b - a, c - a);
+}
+
+static void PushCollapse(SimplifierMesh& mesh, CollapseQueue& queue, unsigned int a, unsigned int b)
+{
+    Quadric q = mesh.Quadrics[a];
+    q += mesh.Quadrics[b];
+
+    // Keep the endpoint with the smaller error
+    double errorA = q.GetError(mesh.GetPosition(a));
+    double errorB = q.GetError(mesh.GetPosition(b));
+
+    EdgeCollapse collapse;
+    collapse.Cost = std::min(errorA, errorB);
+    collapse.Kept = (errorA <= errorB) ? a : b;
+    collapse.Removed = (errorA <= errorB) ? b : a;
+    collapse.RemovedStamp = mesh.Stamps[collapse.Removed];
+    collapse.KeptStamp = mesh.Stamps[collapse.Kept];
+    queue.push(collapse);
+}
+
+// False if moving removed onto kept would flip or collapse a triangle
+static bool IsCollapseValid(const SimplifierMesh& mesh, unsigned int removed, unsigned int kept)
+{
+    if (mesh.VertexTriangles[removed].size() + mesh.VertexTriangles[kept].size() > SIMPLIFIER_MAX_VALENCE)
+        return false;
+
+    const Vec4& to = mesh.GetPosition(kept);
+    for (unsigned int t : mesh.VertexTriangles[removed])
+    {
+        if (!mesh.IsTriangleAlive[t])
+            continue;
+
+        const unsigned int* tri = &mesh.Triangles[3 * t];
+        if ((tri[0] == kept) || (tri[1] == kept) || (tri[2] == kept))
+            continue;
+
+        Vec4 p[3];
+        for (int i = 0; i < 3; i++)
+            p[i] = mesh.GetPosition(tri[i]);
+        Vec4 before = GetTriangleNormal(p[0], p[1], p[2]);
+        for (int i = 0; i < 3; i++)
+        {
+            if (tri[i] == removed)
+                p[i] = to;
+        }
+        Vec4 after = GetTriangleNormal(p[0], p[1], p[2]);
+
+        double lengths = Vec4::Length3(before) * Vec4::Length3(after);
+        if ((lengths <= 0.0) || (Vec4::Dot3(before, after) < SIMPLIFIER_MIN_NORMAL_DOT * lengths))
+            return false;
+    }
+
+    return true;
+}
+
+static void Collapse(SimplifierMesh& mesh, CollapseQueue& queue, unsigned int removed, unsigned int kept)
+{
+    mesh.Quadrics[kept] += mesh.Quadrics[removed];
+    mesh.IsVertexRemoved[removed] = true;
+    mesh.Stamps[kept]++;
+
+    for (unsigned int t : mesh.VertexTriangles[removed])
+    {
+        if (!mesh.IsTriangleAlive[t])
+            continue;
+
+        unsigned int* tri = &mesh.Triangles[3 * t];
+        if ((tri[0] == kept) || (tri[1] == kept) || (tri[2] == kept))
+        {
+            mesh.IsTriangleAlive[t] = false;
+            mesh.AliveTriangles--;
+            continue;
+        }
+
+        for (int i = 0; i < 3; i++)
+        {
+            if (tri[i] == removed)
+                tri[i] = kept;
+        }
+        mesh.VertexTriangles[kept].push_back(t);
+    }
+    std::vector<unsigned int>().swap(mesh.VertexTriangles[removed]);
+
+    // Drop dead triangles and queue the edges around the kept vertex again
+    std::vector<unsigned int>& around = mesh.VertexTriangles[kept];
+    unsigned int count = 0;
+    for (unsigned int t : around)
+    {
+        if (!mesh.IsTriangleAlive[t])
+            continue;
+        around[count++] = t;
+
+        const unsigned int* tri = &mesh.Triangles[3 * t];
+        for (int i = 0; i < 3; i++)
+        {
+            if (tri[i] != kept)
+                PushCollapse(mesh, queue, kept, tri[i]);
+        }
+    }
+    around.resize(count);
+}
+
+static Geometry* BuildLevel(const SimplifierMesh& mesh)
+{
+    const Geometry* source = mesh.Source;
+    Geometry* level = new Geometry();
+    level->MinDimensions = source->MinDimensions;
+    level->MaxDimensions = source->MaxDimensions;
+    level->PolygonVertices.reserve(3 * mesh.AliveTriangles);
+    level->PolygonOffsets.reserve(mesh.AliveTriangles + 1);
+    level->PolygonNormals.reserve(mesh.AliveTriangles);
+    level->PolygonCenters.reserve(mesh.AliveTriangles);
+
+    const int unused = -1;
+    std::vector<int> remap(source->GetVertexCount(), unused);
+    for (unsigned int t = 0; t < mesh.IsTriangleAlive.size(); t++)
+    {
+        if (!mesh.IsTriangleAlive[t])
+            continue;
+
+        const unsigned int* tri = &mesh.Triangles[3 * t];
+        Vec4 center(0.0, 0.0, 0.0, 0.0);
+        for (int i = 0; i < 3; i++)
+        {
+            unsigned int v = tri[i];
+            if (remap[v] == unused)
+            {
+                remap[v] = level->AddVertex(source->VertexPositionIDs[v], 
+                    source->VertexTexCoordIDs[v], source->VertexNormalIDs[v]);
+            }
+            level->PolygonVertices.push_back(remap[v]);
+            center += mesh.GetPosition(v);
+        }
+        center /= 3.0;
+        center[3] = 1.0;
+
+        Vec4 normal = GetTriangleNormal(mesh.GetPosition(tri[0]), mesh.GetPosition(tri[1]), 
+            mesh.GetPosition(tri[2]));
+        if (Vec4::Length3(normal) < AL_DBL_EPSILON)
+            normal = Vec4(0.0, 0.0, 1.0, 0.0);
+        normal = Vec4::Normalize3(normal);
+        normal[3] = 0.0;
+
+        level->EndPolygon(normal, center);
+    }
+
+    return level;
+}
+
+std::vector<Geometry*> MeshSimplifier::BuildLods(const Geometry* geo, const std::vector<Vec4>& positions,
+    unsigned int levelCount, unsigned int minPolygons, const std::atomic<bool>* cancel)
+{
+    std::vector<Geometry*> levels;
+    unsigned int vertexCount = geo->GetVertexCount();
+
+    SimplifierMesh mesh;
+    mesh.Source = geo;
+    mesh.Positions = &positions;
+
+    // Split polygons into fans
+    for (unsigned int p = 0; p < geo->GetPolygonCount(); p++)
+    {
+        const unsigned int* vertices = geo->GetPolygonVertices(p);
+        for (unsigned int i = 1; i + 1 < geo->GetPolygonSize(p); i++)
+        {
+            mesh.Triangles.push_back(vertices[0]);
+            mesh.Triangles.push_back(vertices[i]);
+            mesh.Triangles.push_back(vertices[i + 1]);
+        }
+    }
+    unsigned int triangleCount = mesh.Triangles.size() / 3;
+    mesh.IsTriangleAlive.assign(triangleCount, true);
+    mesh.AliveTriangles = triangleCount;
+
+    // Area weighted plane quadrics
+    mesh.Quadrics.resize(vertexCount);
+    mesh.VertexTriangles.resize(vertexCount);
+    mesh.IsVertexRemoved.assign(vertexCount, false);
+    mesh.Stamps.assign(vertexCount, 0);
+
+    std::vector<Vec4> triangleNormals(triangleCount);
+    for (unsigned int t = 0; t < triangleCount; t++)
+    {
+        const unsigned int* tri = &mesh.Triangles[3 * t];
+        const Vec4& p0 = mesh.GetPosition(tri[0]);
+        Vec4 normal = GetTriangleNormal(p0, mesh.GetPosition(tri[1]), mesh.GetPosition(tri[2]));
+        double length = Vec4::Length3(normal);
+        if (length > AL_DBL_EPSILON)
+        {
+            normal = normal / length;
+            for (int i = 0; i < 3; i++)
+                mesh.Quadrics[tri[i]].AddPlane(normal, -Vec4::Dot3(normal, p0), 0.5 * length);
+        }
+        triangleNormals[t] = normal;
+
+        for (int i = 0; i < 3; i++)
+            mesh.VertexTriangles[tri[i]].push_back(t);
+    }
+
+    // Unique edges, (low, high, triangle), boundary edges appear once
+    std::vector<std::pair<uint64_t, unsigned int> > edges;
+    edges.reserve(3 * triangleCount);
+    for (unsigned int t = 0; t < triangleCount; t++)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            uint64_t a = mesh.Triangles[3 * t + i];
+            uint64_t b = mesh.Triangles[3 * t + (i + 1) % 3];
+            edges.push_back(std::make_pair((std::min(a, b) << 32) | std::max(a, b), t));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+
+    CollapseQueue queue;
+    for (unsigned int i = 0; i < edges.size(); )
+    {
+        unsigned int j = i + 1;
+        while ((j < edges.size()) && (edges[j].first == edges[i].first))
+            j++;
+
+        unsigned int a = (unsigned int)(edges[i].first >> 32);
+        unsigned int b = (unsigned int)edges[i].first;
+        if ((j - i == 1) && (a != b))
+        {
+            // Plane through the boundary edge, perpendicular to its triangle
+            const Vec4& pa = mesh.GetPosition(a);
+            Vec4 edge = mesh.GetPosition(b) - pa;
+            Vec4 normal = Vec4::Cross(edge, triangleNormals[edges[i].second]);
+            double length = Vec4::Length3(normal);
+            if (length > AL_DBL_EPSILON)
+            {
+                normal = normal / length;
+                double weight = SIMPLIFIER_BOUNDARY_WEIGHT * Vec4::Dot3(edge, edge);
+                mesh.Quadrics[a].AddPlane(normal, -Vec4::Dot3(normal, pa), weight);
+                mesh.Quadrics[b].AddPlane(normal, -Vec4::Dot3(normal, pa), weight);
+            }
+        }
+        i = j;
+    }
+
+    for (unsigned int i = 0; i < edges.size(); i++)
+    {
+        if ((i > 0) && (edges[i].first == edges[i - 1].first))
+            continue;
+
+        unsigned int a = (unsigned int)(edges[i].first >> 32);
+        unsigned int b = (unsigned int)edges[i].first;
+        if (a != b)
+            PushCollapse(mesh, queue, a, b);
+    }
+    std::vector<std::pair<uint64_t, unsigned int> >().swap(edges);
+
+    unsigned int target = triangleCount / 4;
+    unsigned int collapses = 0;
+    bool isCancelled = false;
+    while ((levels.size() < levelCount) && (target >= minPolygons) && !isCancelled)
+    {
+        unsigned int previousTriangles = mesh.AliveTriangles;
+        while ((mesh.AliveTriangles > target) && !queue.empty())
+        {
+            if ((cancel != NULL) && ((++collapses & 0xfff) == 0) && cancel->load())
+            {
+                isCancelled = true;
+                break;
+            }
+
+            EdgeCollapse collapse = queue.top();
+            queue.pop();
+
+            if (mesh.IsVertexRemoved[collapse.Removed] || mesh.IsVertexRemoved[collapse.Kept] ||
+                (mesh.Stamps[collapse.Removed] != collapse.RemovedStamp) || 
+                (mesh.Stamps[collapse.Kept] != collapse.KeptStamp))
+                continue;
+
+            if (!IsCollapseValid(mesh, collapse.Removed, collapse.Kept))
+                continue;
+
+            Collapse(mesh, queue, collapse.Removed, collapse.Kept);
+        }
+
+        // Too little could be collapsed for a level to pay off
+        if (isCancelled || (mesh.AliveTriangles > previousTriangles / 2))
+            break;
+
+        levels.push_back(BuildLevel(mesh));
+        target /= 4;
+    }
+
+    if (isCancelled || ((cancel != NULL) && cancel->load()))
+    {
+        for (Geometry* level : levels)
+            delete level;
+        levels.clear();
+    }
+
+    return levels;
+}
\ No newline at end of file
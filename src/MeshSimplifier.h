@@ -0,0 +1,20 @@
+#pragma once
+
+#include "pch.h"
+#include "Geometry.h"
+#include <atomic>
+
+// Builds levels of detail with quadric error metric edge collapses
+// (Garland and Heckbert 1997). Vertices collapse onto one of the edge's
+// endpoints, so every level uses the source positions and no new ones are
+// created. Boundary edges are held in place by constraint planes.
+class MeshSimplifier
+{
+public:
+    // Level i keeps about a quarter of the triangles of level i - 1, stopping
+    // at levelCount levels, when a level would have fewer than minPolygons or
+    // when the mesh can't be simplified to half of the previous level.
+    // Returns an empty vector if cancel is set while working.
+    static std::vector<Geometry*> BuildLods(const Geometry* geo, const std::vector<Vec4>& positions,
+        unsigned int levelCount, unsigned int minPolygons = 16, const std::atomic<bool>* cancel = NULL);
+};
\ No newline at end of file
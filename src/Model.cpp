@@ -1,178 +1,82 @@
 #include "Model.h"
-
-#include <fstream>
-#include <sstream>
-#include <exception>
+#include "MeshCache.h"
+#include "SceneBVH.h"
+#include "SceneGraph.h"
 
 Model::Model()
-    : anim(new Animation()), material(new Material())
+    : mesh(new Mesh()), anim(new Animation()), material(new Material()), 
+    spatialIndex(NULL), spatialIndexID(0), sceneGraph(NULL), sceneNode(0)
 {
-    VertexPositions.reserve(10);
-    VertexNormals.reserve(10);
-    VertexTexCoords.reserve(10);
+
 }
 
-Model::~Model()
+Model::Model(const std::shared_ptr<const Mesh>& mesh)
+    : mesh(mesh), anim(new Animation()), material(new Material()), 
+    spatialIndex(NULL), spatialIndexID(0), sceneGraph(NULL), sceneNode(0)
 {
-    // Delete BBox verticies and polygons
-    while (BoundingBoxPolygons.size() > 0)
-    {
-        Polygon* poly = BoundingBoxPolygons.back();
-        BoundingBoxPolygons.pop_back();
-
-        for (Vertex* it : poly->Vertices)
-            delete it;
-
-        delete poly;
-    }
 
-    while (geos.size() > 0)
-    {
-        Geometry* geo = geos.back();
-        geos.pop_back();
-        delete geo;
-    }
+}
 
+Model::~Model()
+{
     delete anim;
     delete material;
 }
 
-void Model::LoadFromFile(const std::string& filename)
+bool Model::LoadFromFile(const std::string& filename, LoadProgress* progress)
 {
-    std::ifstream file(filename.c_str());
-    if (!file.is_open())
-    {
-        LOG_ERROR("{0} was not opened!", filename.c_str());
-        // TODO: throw exception
-    }
-
-    std::string line;
-    Geometry* geo = NULL;
-    while (getline(file, line))
-    {
-        std::stringstream ss(line);
-        std::string lineType;
-        ss >> std::ws >> lineType;
-
-        if (lineType == "g")
-        {
-            // Add Geometry to model
-            if (geo != NULL)
-                AddGeometry(geo);
-
-            // Create Geometry
-            geo = new Geometry();
-        }
-        else if (lineType == "v")
-        {
-            Vec4 position;
-            ss >> position[0] >> std::ws >> position[1] >> std::ws >> position[2];
-            position[3] = 1.0;
-            
-            VertexPositions.push_back(position);
-            SetMinMaxDimensions(position);
-        }
-        else if (lineType == "vt")
-        {
-            Vec4 texCoords;
-            ss >> texCoords[0] >> std::ws >> texCoords[1];
-            if (ss.peek() == ' ')
-                ss >> std::ws >> texCoords[2];
+    std::shared_ptr<const Mesh> loaded = MeshCache::Load(filename, progress);
+    if (!loaded)
+        return false;
+
+    mesh = loaded;
+    lodLevels.clear();
+    size_t slash = filename.find_last_of("/\\");
+    name = (slash != std::string::npos) ? filename.substr(slash + 1) : filename;
+    return true;
+}
 
-            VertexTexCoords.push_back(texCoords);
-        }
-        else if (lineType == "vn")
-        {
-            Vec4 normal;
-            ss >> normal[0] >> std::ws >> normal[1] >> std::ws >>  normal[2];
+const std::string& Model::GetName() const
+{
+    return name;
+}
 
-            VertexNormals.push_back(normal);
-        }
-        else if ((lineType == "f") && (geo != NULL))
-        {
-            Polygon* poly = new Polygon();
-
-            // Construct vertex
-            char c;
-            while (!ss.eof())
-            {
-                int posID, normID, texID;
-
-                ss >> std::ws >> posID >> std::ws;
-                --(posID);
-
-                if (ss.peek() != '/')
-                {
-                    AddVertexToPoly(geo, poly, posID, normID, texID);
-                    continue;
-                }
-                
-                ss >> c >> std::ws;
-                if (ss.peek() == '/')
-                {
-                    ss >> c >> std::ws >> normID;
-                    --(normID);
-                    AddVertexToPoly(geo, poly, posID, normID, texID);
-                    continue;
-                }
-                else
-                {
-                    ss >> texID;
-                    --(texID);
-                }
-                
-                if (ss.peek() != '/')
-                {
-                    AddVertexToPoly(geo, poly, posID, normID, texID);
-                    continue;
-                }
-                    
-                ss >> c >> normID;
-                --(normID);
-
-                AddVertexToPoly(geo, poly, posID, normID, texID);
-            }
-
-            // Calculate Normal
-            poly->Normal = CalculatePolyNormal(poly);
-
-            // Calculate center
-            poly->Center /= poly->Vertices.size();
-            poly->Center[3] = 1.0;
-
-            // Add poly to polygons vector
-            geo->Polygons.push_back(poly);
-        }
-        else
-        {
-            // Do nothing
-        }
-    }
-    file.close();
+const Mesh* Model::GetMesh() const
+{
+    return mesh.get();
+}
 
-    // Add last gemoetry in file
-    AddGeometry(geo);
+const std::shared_ptr<const Mesh>& Model::GetSharedMesh() const
+{
+    return mesh;
+}
 
-    // Build Bounding Box
-    BuildModelBoundingBox();
+unsigned int Model::GetGeometryCount() const
+{
+    return mesh->GetGeometryCount();
 }
 
-void Model::AddGeometry(Geometry* geo)
+const Geometry* Model::GetGeometry(unsigned int index) const
 {
-    CalculateVertexNormals(geo);
-    BuildGeoBoundingBox(geo);
+    return mesh->GetGeometry(index);
+}
 
-    geos.push_back(geo);
+const Mat4& Model::GetObjectToParentTransform() const
+{
+    return objectToParent;
 }
 
-const std::vector<Geometry*>& Model::GetGeometries() const
+void Model::SetObjectToParentTransform(const Mat4& transform)
 {
-    return geos;
+    objectToParent = transform;
+    MarkTransformChanged();
 }
 
 const Mat4& Model::GetObjectToWorldTransform() const
 {
-    return objectToWorld;
+    if (sceneGraph != NULL)
+        return sceneGraph->GetWorldTransform(sceneNode);
+    return objectToParent;
 }
 
 const Mat4& Model::GetViewTransform() const
@@ -182,19 +86,19 @@ const Mat4& Model::GetViewTransform() const
 
 void Model::Translate(const Mat4& T, int space)
 {
-    
     switch (space)
     {
         case ID_SPACE_OBJECT:
-            objectToWorld = T * objectToWorld;
+            objectToParent = T * objectToParent;
             break;
         case ID_SPACE_WORLD:
-            objectToWorld = objectToWorld * T;
+            ApplyWorldTransform(T);
             break;
         default:
             viewTransform = T * viewTransform;
             break;
     }
+    MarkTransformChanged();
 }
 
 void Model::Rotate(const Mat4& R, int space)
@@ -202,15 +106,16 @@ void Model::Rotate(const Mat4& R, int space)
     switch (space)
     {
         case ID_SPACE_OBJECT:
-            objectToWorld = R * objectToWorld;
+            objectToParent = R * objectToParent;
             break;
         case ID_SPACE_WORLD:
-            objectToWorld = objectToWorld * R;
+            ApplyWorldTransform(R);
             break;
         default:
             viewTransform = R * viewTransform;
             break;
     }
+    MarkTransformChanged();
 }
 
 void Model::Scale(const Mat4& S, int space)
@@ -218,288 +123,138 @@ void Model::Scale(const Mat4& S, int space)
     switch (space)
     {
         case ID_SPACE_OBJECT:
-            objectToWorld = S * objectToWorld;
+            objectToParent = S * objectToParent;
             break;
         case ID_SPACE_WORLD:
-            objectToWorld = objectToWorld * S;
+            ApplyWorldTransform(S);
             break;
         default:
             viewTransform = S * viewTransform;
             break;
     }
+    MarkTransformChanged();
 }
 
-Vec4 Model::GetModelDimensions() const
-{
-    Vec4 result;
-    for (int i = 0; i < 3; i++)
-        result[i] = abs(maxDimensions[i] - minDimensions[i]);
-    
-    return result;
-}
-
-Vec4 Model::GetModelBBoxCenter() const
+size_t Model::GetMemoryUsage() const
 {
-    Vec4 result;
-    Vec4 modelDimensions = GetModelDimensions();
-
-    for (int i = 0; i < 3; i++)
-        result[i] = minDimensions[i] + modelDimensions[i] / 2.0;
-    result[3] = 1.0;
-    
-    return result;
+    return sizeof(Model) + sizeof(Animation) + sizeof(Material);
 }
 
-Animation* Model::GetAnimation()
+Vec4 Model::GetModelDimensions() const
 {
-    return anim;
+    return mesh->GetDimensions();
 }
 
-Material* Model::GetMaterial()
+Vec4 Model::GetModelBBoxCenter() const
 {
-    return material;
+    return mesh->GetBBoxCenter();
 }
 
-Vec4 Model::CalculatePolyNormal(Polygon* p) const
+bool Model::GetWorldBounds(Vec4& min, Vec4& max) const
 {
-    Vec4 normal(0.0, 0.0, 1.0, 0.0);
-    
-    if (p->Vertices.size() >= 3)
+    Mat4 identity;
+    for (int i = 0; i < 4; i++)
     {
-        Vec4 u = VertexPositions[p->Vertices[0]->PositionID];
-        Vec4 v = VertexPositions[p->Vertices[1]->PositionID];
-        Vec4 w = VertexPositions[p->Vertices[2]->PositionID];
-
-        Vec4 e1 = v - u;
-        Vec4 e2 = w - v;
-
-        if (p->Vertices.size() == 4)
+        for (int j = 0; j < 4; j++)
         {
-            Vec4 z = VertexPositions[p->Vertices[3]->PositionID];
-
-            if (Vec4::Length3(e1) < AL_DBL_EPSILON)
-            {
-                e1 = e2;
-                e2 = z - w;
-            }
-            else if (Vec4::Length3(e2) < AL_DBL_EPSILON)
-            {
-                e2 = z - w;
-            }
+            if (viewTransform[i][j] != identity[i][j])
+                return false;
         }
+    }
 
-        Vec4 temp = Vec4::Cross(e1, e2); // TODO: maybe change order (or negate)
-        if (Vec4::Length3(temp) >= AL_DBL_EPSILON)
-            normal = temp;
-        
-        normal = Vec4::Normalize3(normal);
-        normal[3] = 0.0;
+    const Vec4& minDimensions = mesh->GetMinDimensions();
+    const Vec4& maxDimensions = mesh->GetMaxDimensions();
+    double xs[8], ys[8], zs[8];
+    for (int i = 0; i < 8; i++)
+    {
+        xs[i] = (i & 1) ? maxDimensions[0] : minDimensions[0];
+        ys[i] = (i & 2) ? maxDimensions[1] : minDimensions[1];
+        zs[i] = (i & 4) ? maxDimensions[2] : minDimensions[2];
     }
-    
-    return normal;
-}
+    double wxs[8], wys[8], wzs[8], wws[8];
+    GetObjectToWorldTransform().TransformPoints(xs, ys, zs, 8, wxs, wys, wzs, wws);
 
-Vec4 Model::CalculateVertexNormal(Vertex* v) const
-{
-    if (v->NeighborPolys.size() == 0)
-        return Vec4(0.0, 0.0, 1.0, 0.0);
-    
-    Vec4 normal(0.0, 0.0, 0.0, 0.0);
-    for (Polygon* poly : v->NeighborPolys)
+    min = Vec4(wxs[0], wys[0], wzs[0]);
+    max = Vec4(wxs[0], wys[0], wzs[0]);
+    for (int i = 1; i < 8; i++)
     {
-        normal += poly->Normal;
+        min = Vec4(std::min(min[0], wxs[i]), std::min(min[1], wys[i]), std::min(min[2], wzs[i]));
+        max = Vec4(std::max(max[0], wxs[i]), std::max(max[1], wys[i]), std::max(max[2], wzs[i]));
     }
 
-    normal /= v->NeighborPolys.size();
-    normal = Vec4::Normalize3(normal);
-    normal[3] = 0.0;
+    return true;
+}
 
-    return normal;
+void Model::SetSpatialIndex(SceneBVH* index, unsigned int id)
+{
+    spatialIndex = index;
+    spatialIndexID = id;
 }
 
-void Model::CalculateVertexNormals(Geometry* geo)
+void Model::SetSceneNode(SceneGraph* graph, unsigned int node)
 {
-    for (auto& it : geo->Vertices)
-    {
-        Vertex* v = (Vertex*)it.second;
-        if (v->NormalID != -1)
-            continue;
-        
-        // Get calulcated normal new index
-        int index = VertexNormals.size();
-        // Calculate normal
-        Vec4 normal = CalculateVertexNormal(v);
-        // Add normal to normals vector in geo
-        VertexNormals.push_back(normal);
-        // Save index in vertex
-        v->NormalID = index;
+    sceneGraph = graph;
+    sceneNode = node;
+    if (sceneGraph != NULL)
+        sceneGraph->SetLocalTransform(sceneNode, objectToParent);
+}
 
-    }
+void Model::OnWorldTransformChanged()
+{
+    if (spatialIndex != NULL)
+        spatialIndex->MarkDirty(spatialIndexID);
 }
 
-void Model::AddVertexToPoly(Geometry* geo, Polygon* poly, int posID, int normID, int texID)
+void Model::ApplyWorldTransform(const Mat4& M)
 {
-    Vertex* vert = NULL;
-    // Add it's poly to it's neighbor polys vector
-    // and Vertex to Vertices unordered map
-    auto it = geo->Vertices.find(posID);
-    if (it != geo->Vertices.end())
-    {
-        vert = geo->Vertices[posID];
-    }
-    else
+    if (sceneGraph == NULL)
     {
-        vert = new Vertex(posID, texID, normID);
-        geo->Vertices[posID] = vert;
+        objectToParent = objectToParent * M;
+        return;
     }
-    vert->NeighborPolys.push_back(poly);
-
-    // Add vertex to poly
-    poly->Vertices.push_back(vert);
 
-    // Add the vertex position to the center calculation
-    poly->Center += VertexPositions[posID];
+    // Into the parent's space, transformed there and back
+    Mat4 parentToWorld = sceneGraph->GetParentWorldTransform(sceneNode);
+    objectToParent = objectToParent * parentToWorld * M * Mat4::InverseAffine(parentToWorld);
+}
 
-    // Set maximum and minimum dimensions
-    if (geo->Vertices.size() == 1)
-    {
-        geo->MaxDimensions = VertexPositions[posID];
-        geo->MinDimensions = VertexPositions[posID];
-    }
+void Model::MarkTransformChanged()
+{
+    // The scene graph calls OnWorldTransformChanged on its next update
+    if (sceneGraph != NULL)
+        sceneGraph->SetLocalTransform(sceneNode, objectToParent);
     else
-    {
-        for (int i = 0; i < 3; i++)
-        {
-            geo->MaxDimensions[i] = ((VertexPositions[posID])[i] > geo->MaxDimensions[i]) ? 
-                (VertexPositions[posID])[i] : geo->MaxDimensions[i];
-            geo->MinDimensions[i] = ((VertexPositions[posID])[i] < geo->MinDimensions[i]) ? 
-                (VertexPositions[posID])[i] : geo->MinDimensions[i];
-        }
-    }
+        OnWorldTransformChanged();
 }
 
-void Model::BuildGeoBoundingBox(Geometry* geo)
+bool Model::AreLodsReady() const
 {
-    if (geo == NULL)
-        return;
-    
-    geo->BoundingBoxPolygons = BuildBoundingBox(geo->MinDimensions, geo->MaxDimensions);
+    return mesh->AreLodsReady();
 }
 
-void Model::BuildModelBoundingBox()
+int Model::GetLodLevel(unsigned int geometryIndex) const
 {
-    BoundingBoxPolygons = BuildBoundingBox(minDimensions, maxDimensions);
+    return (geometryIndex < lodLevels.size()) ? lodLevels[geometryIndex] : 0;
+}
 
-    Vec4 dimensions = GetModelDimensions();
-    LOG_INFO("Model dimensions: ({0}, {1}, {2}).", dimensions[0], dimensions[1], dimensions[2]);
+void Model::SetLodLevel(unsigned int geometryIndex, int level)
+{
+    if (geometryIndex >= lodLevels.size())
+        lodLevels.resize(mesh->GetGeometryCount(), 0);
+    lodLevels[geometryIndex] = level;
 }
 
-void Model::SetMinMaxDimensions(const Vec4& vertPos)
+bool Model::Intersect(const Vec4& origin, const Vec4& direction, MeshBVHHit& hit) const
 {
-    if (VertexPositions.size() == 1)
-    {
-        for (int i = 0; i < 3; i++)
-        {
-            maxDimensions[i] = vertPos[i];
-            minDimensions[i] = vertPos[i];
-        }
-    }
-    else
-    {
-        for (int i = 0; i < 3; i++)
-        {
-            maxDimensions[i] = (vertPos[i] > maxDimensions[i]) ? vertPos[i] : maxDimensions[i];
-            minDimensions[i] = (vertPos[i] < minDimensions[i]) ? vertPos[i] : minDimensions[i];
-        }
-    }
+    return mesh->Intersect(origin, direction, hit);
+}
+
+Animation* Model::GetAnimation()
+{
+    return anim;
 }
 
-std::vector<Polygon*> Model::BuildBoundingBox(const Vec4& minDimensions, const Vec4& maxDimensions)
+Material* Model::GetMaterial()
 {
-    std::vector<Polygon*> polygons;
-
-    int start = VertexPositions.size();
-    VertexPositions.push_back(Vec4(minDimensions[0], minDimensions[1], maxDimensions[2])); // front bottom left
-    VertexPositions.push_back(Vec4(minDimensions[0], maxDimensions[1], maxDimensions[2])); // front top left
-    VertexPositions.push_back(Vec4(maxDimensions[0], maxDimensions[1], maxDimensions[2])); // front top right
-    VertexPositions.push_back(Vec4(maxDimensions[0], minDimensions[1], maxDimensions[2])); // front bottom right
-    VertexPositions.push_back(Vec4(minDimensions[0], minDimensions[1], minDimensions[2])); // back bottom left
-    VertexPositions.push_back(Vec4(minDimensions[0], maxDimensions[1], minDimensions[2])); // back top left
-    VertexPositions.push_back(Vec4(maxDimensions[0], maxDimensions[1], minDimensions[2])); // back top right
-    VertexPositions.push_back(Vec4(maxDimensions[0], minDimensions[1], minDimensions[2])); // back bottom right
-
-    // Front face polygon
-    Polygon* front = new Polygon();
-    front->Vertices.push_back(new Vertex(start));
-    front->Vertices.push_back(new Vertex(start + 1));
-    front->Vertices.push_back(new Vertex(start + 2));
-    front->Vertices.push_back(new Vertex(start + 3));
-    front->Normal = Vec4(0.0, 0.0, 1.0);
-    front->Center = Vec4(minDimensions[0] + ((maxDimensions[0] - minDimensions[0]) / 2.0),
-        minDimensions[1] + ((maxDimensions[1] - minDimensions[1]) / 2.0), 
-        maxDimensions[2]);
-
-    // Back face Polygon
-    Polygon* back = new Polygon();
-    back->Vertices.push_back(new Vertex(start + 4));
-    back->Vertices.push_back(new Vertex(start + 5));
-    back->Vertices.push_back(new Vertex(start + 6));
-    back->Vertices.push_back(new Vertex(start + 7));
-    back->Normal = Vec4(0.0, 0.0, -1.0);
-    back->Center = Vec4(minDimensions[0] + ((maxDimensions[0] - minDimensions[0]) / 2.0),
-        minDimensions[1] + ((maxDimensions[1] - minDimensions[1]) / 2.0), 
-        minDimensions[2]);
-
-    // Left face Polygon
-    Polygon* left = new Polygon();
-    left->Vertices.push_back(new Vertex(start + 4));
-    left->Vertices.push_back(new Vertex(start + 5));
-    left->Vertices.push_back(new Vertex(start + 1));
-    left->Vertices.push_back(new Vertex(start));
-    left->Normal = Vec4(-1.0, 0.0, 0.0);
-    left->Center = Vec4(minDimensions[0], 
-        minDimensions[1] + ((maxDimensions[1] - minDimensions[1]) / 2.0), 
-        minDimensions[2] + ((maxDimensions[2] - minDimensions[2]) / 2.0));
-
-    // Right face Polygon
-    Polygon* right = new Polygon();
-    right->Vertices.push_back(new Vertex(start + 7));
-    right->Vertices.push_back(new Vertex(start + 6));
-    right->Vertices.push_back(new Vertex(start + 2));
-    right->Vertices.push_back(new Vertex(start + 3));
-    right->Normal = Vec4(1.0, 0.0, 0.0);
-    right->Center = Vec4(maxDimensions[0], 
-        minDimensions[1] + ((maxDimensions[1] - minDimensions[1]) / 2.0), 
-        minDimensions[2] + ((maxDimensions[2] - minDimensions[2]) / 2.0));
-
-    // Top face Polygon
-    Polygon* top = new Polygon();
-    top->Vertices.push_back(new Vertex(start + 1));
-    top->Vertices.push_back(new Vertex(start + 5));
-    top->Vertices.push_back(new Vertex(start + 6));
-    top->Vertices.push_back(new Vertex(start + 2));
-    top->Normal = Vec4(0.0, 1.0, 0.0);
-    top->Center = Vec4(minDimensions[0] + ((maxDimensions[0] - minDimensions[0]) / 2.0), 
-        maxDimensions[1], 
-        minDimensions[2] + ((maxDimensions[2] - minDimensions[2]) / 2.0));
-
-    // Bottom face Polygon
-    Polygon* bottom = new Polygon();
-    bottom->Vertices.push_back(new Vertex(start));
-    bottom->Vertices.push_back(new Vertex(start + 4));
-    bottom->Vertices.push_back(new Vertex(start + 7));
-    bottom->Vertices.push_back(new Vertex(start + 3));
-    bottom->Normal = Vec4(0.0, -1.0, 0.0);
-    bottom->Center = Vec4(minDimensions[0] + ((maxDimensions[0] - minDimensions[0]) / 2.0), 
-        minDimensions[1], 
-        minDimensions[2] + ((maxDimensions[2] - minDimensions[2]) / 2.0));
-    
-    polygons.push_back(front);
-    polygons.push_back(back);
-    polygons.push_back(left);
-    polygons.push_back(right);
-    polygons.push_back(top);
-    polygons.push_back(bottom);
-
-    return polygons;
+    return material;
 }
\ No newline at end of file
@@ -1,57 +1,89 @@
 #pragma once
 
 #include "pch.h"
-#include "Geometry.h"
+#include "Mesh.h"
 #include "Material.h"
 #include "Animation.h"
+#include "LoadProgress.h"
 
+class SceneBVH;
+class SceneGraph;
+
+// A placement of a mesh in the scene. The mesh is shared with every other
+// model loaded from the same file, a model only owns its transforms,
+// material, animation and the level of detail it draws of each geometry. Its transform is relative to its parent node in
+// the scene graph, or to the world while it isn't in one.
 class Model
 {
 public:
+    // Empty mesh
     Model();
+    Model(const std::shared_ptr<const Mesh>& mesh);
     ~Model();
 
-    void LoadFromFile(const std::string& filename);
+    // Returns false if the file can't be read or progress was cancelled.
+    // Files that are already loaded share their mesh.
+    bool LoadFromFile(const std::string& filename, LoadProgress* progress = NULL);
+    // File name of the loaded file, without its directory
+    const std::string& GetName() const;
 
-    void AddGeometry(Geometry* geo);
-    const std::vector<Geometry*>& GetGeometries() const;
+    const Mesh* GetMesh() const;
+    const std::shared_ptr<const Mesh>& GetSharedMesh() const;
+    unsigned int GetGeometryCount() const;
+    const Geometry* GetGeometry(unsigned int index) const;
 
+    const Mat4& GetObjectToParentTransform() const;
+    void SetObjectToParentTransform(const Mat4& transform);
     const Mat4& GetObjectToWorldTransform() const;
     const Mat4& GetViewTransform() const;
     void Translate(const Mat4& T, int space = ID_SPACE_OBJECT);
     void Rotate(const Mat4& R, int space = ID_SPACE_OBJECT);
     void Scale(const Mat4& S, int space = ID_SPACE_OBJECT);
 
+    // Bytes of the model itself, the mesh is counted separately since it's shared
+    size_t GetMemoryUsage() const;
+
     Vec4 GetModelDimensions() const;
     Vec4 GetModelBBoxCenter() const;
+    // World space bounds of the bounding box, false if the model has a view
+    // space transform and can't be bounded in world space
+    bool GetWorldBounds(Vec4& min, Vec4& max) const;
+
+    // Transforms mark the model's leaf in the scene's index for a refit
+    void SetSpatialIndex(SceneBVH* index, unsigned int id);
+    // The model's transform becomes the node's local transform
+    void SetSceneNode(SceneGraph* graph, unsigned int node);
+    unsigned int GetSceneNode() const { return sceneNode; }
+    // Called by the scene graph when a parent moved the model
+    void OnWorldTransformChanged();
+
+    // Levels of detail are built in the background after loading
+    bool AreLodsReady() const;
+    // Level of detail last drawn of a geometry, 0 is full detail
+    int GetLodLevel(unsigned int geometryIndex) const;
+    void SetLodLevel(unsigned int geometryIndex, int level);
+
+    // Nearest polygon hit by an object space ray at 0 < t < hit.T, updates hit
+    bool Intersect(const Vec4& origin, const Vec4& direction, MeshBVHHit& hit) const;
 
     Animation* GetAnimation();
     Material* GetMaterial();
 
 private:
-    Vec4 CalculatePolyNormal(Polygon* p) const;
-    Vec4 CalculateVertexNormal(Vertex* v) const;
-    void CalculateVertexNormals(Geometry* geo);
-    void AddVertexToPoly(Geometry* geo, Polygon* poly, int posID, int normID, int texID);
-    void SetMinMaxDimensions(const Vec4& vertPos);
-    std::vector<Polygon*> BuildBoundingBox(const Vec4& minDimensions, const Vec4& maxDimensions);
-    void BuildGeoBoundingBox(Geometry* geo);
-    void BuildModelBoundingBox();
-
-public:
-    std::vector<Vec4> VertexTexCoords;
-    std::vector<Vec4> VertexPositions;
-    std::vector<Vec4> VertexNormals;
-
-    std::vector<Polygon*> BoundingBoxPolygons;
+    // World space transforms are applied in the parent's space
+    void ApplyWorldTransform(const Mat4& M);
+    void MarkTransformChanged();
 
 private:
-    std::vector<Geometry*> geos;
-    Mat4 objectToWorld;
+    std::shared_ptr<const Mesh> mesh;
+    std::string name;
+    Mat4 objectToParent;
     Mat4 viewTransform;
     Animation* anim;
     Material* material;
-
-    Vec4 minDimensions;
-    Vec4 maxDimensions;
+    SceneBVH* spatialIndex;
+    unsigned int spatialIndexID;
+    SceneGraph* sceneGraph;
+    unsigned int sceneNode;
+    std::vector<int> lodLevels;
 };
\ No newline at end of file
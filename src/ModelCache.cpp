@@ -0,0 +1,369 @@
+#include "ModelCache.h"
+#include "MappedFile.h"
+
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <sys/stat.h>
+
+#define MODEL_CACHE_VERSION 6
+// Bytes hashed at the start and at the end of the source file
+#define MODEL_CACHE_HASH_SAMPLE (1 << 20)
+
+static_assert(sizeof(Vec4) == 4 * sizeof(double), "Vec4 is stored as 4 doubles");
+
+static const char ModelCacheMagic[8] = { 'C', 'G', 'M', 'O', 'D', 'E', 'L', '\0' };
+
+struct ModelCacheHeader
+{
+    char Magic[8];
+    uint32_t Version;
+    uint32_t GeometryCount;
+    uint32_t IsTriangulated;
+    uint32_t IsOptimized;
+    double WeldEpsilon;
+
+    // Source file key
+    uint64_t SourceSize;
+    int64_t SourceTime;
+    uint64_t SourceHash;
+
+    uint64_t PositionCount;
+    uint64_t TexCoordCount;
+    uint64_t NormalCount;
+};
+
+struct ModelCacheGeometryHeader
+{
+    uint64_t VertexCount;
+    uint64_t PolygonCount;
+    uint64_t CornerCount;
+    uint64_t ClusterCount;
+    Vec4 MinDimensions;
+    Vec4 MaxDimensions;
+};
+
+// FNV-1a
+static uint64_t HashBytes(const char* data, size_t size, uint64_t hash)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Hashing the whole file would cost as much as parsing it
+bool ModelCache::GetSourceKey(const std::string& filename, ModelSourceKey& key)
+{
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0)
+        return false;
+
+    key.Size = (uint64_t)st.st_size;
+    key.Time = (int64_t)st.st_mtime;
+
+    std::ifstream file(filename.c_str(), std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    std::vector<char> sample(MODEL_CACHE_HASH_SAMPLE);
+    uint64_t hash = 14695981039346656037ULL;
+
+    file.read(sample.data(), sample.size());
+    hash = HashBytes(sample.data(), (size_t)file.gcount(), hash);
+
+    if (key.Size > 2 * sample.size())
+    {
+        file.clear();
+        file.seekg(key.Size - sample.size());
+        file.read(sample.data(), sample.size());
+        hash = HashBytes(sample.data(), (size_t)file.gcount(), hash);
+    }
+    else if (key.Size > sample.size())
+    {
+        file.read(sample.data(), sample.size());
+        hash = HashBytes(sample.data(), (size_t)file.gcount(), hash);
+    }
+
+    key.Hash = hash;
+    return true;
+}
+
+// Arrays start on 8 byte boundaries
+static size_t GetPadding(size_t bytes)
+{
+    return (8 - bytes % 8) % 8;
+}
+
+template <typename T>
+static void WriteArray(std::ofstream& file, const std::vector<T>& v)
+{
+    static const char zeros[8] = { 0 };
+    size_t bytes = v.size() * sizeof(T);
+
+    file.write((const char*)v.data(), bytes);
+    file.write(zeros, GetPadding(bytes));
+}
+
+template <typename T>
+static bool ReadArray(const char*& cursor, const char* end, uint64_t count, std::vector<T>& v)
+{
+    if (count > (uint64_t)(end - cursor) / sizeof(T))
+        return false;
+
+    size_t bytes = (size_t)count * sizeof(T);
+    v.resize((size_t)count);
+    memcpy(v.data(), cursor, bytes);
+    cursor += bytes + GetPadding(bytes);
+    if (cursor > end)
+        cursor = end;
+
+    return true;
+}
+
+template <typename T>
+static bool ReadValue(const char*& cursor, const char* end, T& value)
+{
+    if ((size_t)(end - cursor) < sizeof(T))
+        return false;
+
+    memcpy(&value, cursor, sizeof(T));
+    cursor += sizeof(T) + GetPadding(sizeof(T));
+    if (cursor > end)
+        cursor = end;
+
+    return true;
+}
+
+// Offsets start at 0, never decrease and end at the element count
+static bool IsValidOffsets(const std::vector<unsigned int>& offsets, size_t count)
+{
+    if (offsets.empty() || (offsets.front() != 0) || (offsets.back() != count))
+        return false;
+
+    for (unsigned int i = 1; i < offsets.size(); i++)
+    {
+        if (offsets[i] < offsets[i - 1])
+            return false;
+    }
+
+    return true;
+}
+
+static bool IsValidIndices(const std::vector<unsigned int>& indices, size_t count)
+{
+    for (unsigned int index : indices)
+    {
+        if (index >= count)
+            return false;
+    }
+
+    return true;
+}
+
+static bool IsValidIDs(const std::vector<int>& ids, size_t count, int minID)
+{
+    for (int id : ids)
+    {
+        if ((id < minID) || (id >= (int)count))
+            return false;
+    }
+
+    return true;
+}
+
+static bool IsValidGeometry(const Geometry* geo, const CachedModel& model)
+{
+    if (model.IsTriangulated && (geo->PolygonVertices.size() != 3 * geo->GetPolygonCount()))
+        return false;
+
+    return IsValidOffsets(geo->PolygonOffsets, geo->PolygonVertices.size()) &&
+        IsValidOffsets(geo->VertexPolygonOffsets, geo->VertexPolygons.size()) &&
+        IsValidOffsets(geo->ClusterOffsets, geo->GetPolygonCount()) &&
+        IsValidIndices(geo->PolygonVertices, geo->GetVertexCount()) &&
+        IsValidIndices(geo->VertexPolygons, geo->GetPolygonCount()) &&
+        IsValidIDs(geo->VertexPositionIDs, model.Positions.size(), 0) &&
+        IsValidIDs(geo->VertexTexCoordIDs, model.TexCoords.size(), -1) &&
+        IsValidIDs(geo->VertexNormalIDs, model.Normals.size(), -1);
+}
+
+std::string ModelCache::GetCacheFilename(const std::string& filename)
+{
+    return filename + ".cache";
+}
+
+bool ModelCache::Load(const std::string& filename, CachedModel& model)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    ModelSourceKey key;
+    if (!GetSourceKey(filename, key))
+        return false;
+
+    std::string cacheFilename = GetCacheFilename(filename);
+    MappedFile file;
+    if (!file.Open(cacheFilename))
+        return false;
+
+    const char* cursor = file.GetData();
+    const char* end = cursor + file.GetSize();
+
+    ModelCacheHeader header;
+    if (!ReadValue(cursor, end, header) ||
+        (memcmp(header.Magic, ModelCacheMagic, sizeof(ModelCacheMagic)) != 0) ||
+        (header.Version != MODEL_CACHE_VERSION))
+    {
+        LOG_WARN("ModelCache: {0} is not a valid cache file.", cacheFilename.c_str());
+        return false;
+    }
+
+    if ((header.SourceSize != key.Size) || (header.SourceTime != key.Time) ||
+        (header.SourceHash != key.Hash) || 
+        (header.IsTriangulated != (uint32_t)model.IsTriangulated) ||
+        (header.IsOptimized != (uint32_t)model.IsOptimized) ||
+        (header.WeldEpsilon != model.WeldEpsilon))
+    {
+        LOG_INFO("ModelCache: {0} is out of date.", cacheFilename.c_str());
+        return false;
+    }
+
+    bool isValid = ReadArray(cursor, end, header.PositionCount, model.Positions) &&
+        ReadArray(cursor, end, header.TexCoordCount, model.TexCoords) &&
+        ReadArray(cursor, end, header.NormalCount, model.Normals);
+
+    for (uint32_t g = 0; isValid && (g < header.GeometryCount); g++)
+    {
+        Geometry* geo = new Geometry();
+        model.Geometries.push_back(geo);
+
+        ModelCacheGeometryHeader geoHeader = ModelCacheGeometryHeader();
+        isValid = ReadValue(cursor, end, geoHeader);
+        uint64_t triangleCount = header.IsTriangulated ? geoHeader.PolygonCount : 0;
+        isValid = isValid &&
+            ReadArray(cursor, end, geoHeader.VertexCount, geo->VertexPositionIDs) &&
+            ReadArray(cursor, end, geoHeader.VertexCount, geo->VertexTexCoordIDs) &&
+            ReadArray(cursor, end, geoHeader.VertexCount, geo->VertexNormalIDs) &&
+            ReadArray(cursor, end, geoHeader.PolygonCount + 1, geo->PolygonOffsets) &&
+            ReadArray(cursor, end, geoHeader.CornerCount, geo->PolygonVertices) &&
+            ReadArray(cursor, end, geoHeader.PolygonCount, geo->PolygonNormals) &&
+            ReadArray(cursor, end, geoHeader.PolygonCount, geo->PolygonCenters) &&
+            ReadArray(cursor, end, geoHeader.VertexCount + 1, geo->VertexPolygonOffsets) &&
+            ReadArray(cursor, end, geoHeader.CornerCount, geo->VertexPolygons) &&
+            ReadArray(cursor, end, triangleCount, geo->PolygonFaces) &&
+            ReadArray(cursor, end, triangleCount, geo->PolygonEdges) &&
+            ReadArray(cursor, end, geoHeader.ClusterCount + 1, geo->ClusterOffsets) &&
+            ReadArray(cursor, end, geoHeader.ClusterCount, geo->ClusterSpheres) &&
+            ReadArray(cursor, end, geoHeader.ClusterCount, geo->ClusterCones) &&
+            IsValidGeometry(geo, model);
+
+        geo->MinDimensions = geoHeader.MinDimensions;
+        geo->MaxDimensions = geoHeader.MaxDimensions;
+    }
+
+    if (!isValid)
+    {
+        LOG_WARN("ModelCache: {0} is corrupted.", cacheFilename.c_str());
+        for (Geometry* geo : model.Geometries)
+            delete geo;
+        model = CachedModel();
+        return false;
+    }
+
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+    LOG_INFO("ModelCache: Loaded {0} ({1} MB) in {2} s.", cacheFilename.c_str(),
+        file.GetSize() / (1024.0 * 1024.0), seconds.count());
+
+    return true;
+}
+
+bool ModelCache::Save(const std::string& filename, const CachedModel& model)
+{
+    ModelCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    ModelSourceKey key;
+    if (!GetSourceKey(filename, key))
+        return false;
+
+    memcpy(header.Magic, ModelCacheMagic, sizeof(ModelCacheMagic));
+    header.Version = MODEL_CACHE_VERSION;
+    header.SourceSize = key.Size;
+    header.SourceTime = key.Time;
+    header.SourceHash = key.Hash;
+    header.GeometryCount = (uint32_t)model.Geometries.size();
+    header.IsTriangulated = model.IsTriangulated;
+    header.IsOptimized = model.IsOptimized;
+    header.WeldEpsilon = model.WeldEpsilon;
+    header.PositionCount = model.Positions.size();
+    header.TexCoordCount = model.TexCoords.size();
+    header.NormalCount = model.Normals.size();
+
+    // Write to a temporary file so a failed write never leaves a broken cache,
+    // one per thread as the same file may be loaded twice at once
+    std::string cacheFilename = GetCacheFilename(filename);
+    std::string tempFilename = cacheFilename + "." + 
+        std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    {
+        std::ofstream file(tempFilename.c_str(), std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            LOG_WARN("ModelCache: Could not create {0}.", tempFilename.c_str());
+            return false;
+        }
+
+        file.write((const char*)&header, sizeof(header));
+        WriteArray(file, model.Positions);
+        WriteArray(file, model.TexCoords);
+        WriteArray(file, model.Normals);
+
+        for (const Geometry* geo : model.Geometries)
+        {
+            ModelCacheGeometryHeader geoHeader = ModelCacheGeometryHeader();
+            geoHeader.VertexCount = geo->GetVertexCount();
+            geoHeader.PolygonCount = geo->GetPolygonCount();
+            geoHeader.CornerCount = geo->PolygonVertices.size();
+            geoHeader.ClusterCount = geo->GetClusterCount();
+            geoHeader.MinDimensions = geo->MinDimensions;
+            geoHeader.MaxDimensions = geo->MaxDimensions;
+
+            file.write((const char*)&geoHeader, sizeof(geoHeader));
+            WriteArray(file, geo->VertexPositionIDs);
+            WriteArray(file, geo->VertexTexCoordIDs);
+            WriteArray(file, geo->VertexNormalIDs);
+            WriteArray(file, geo->PolygonOffsets);
+            WriteArray(file, geo->PolygonVertices);
+            WriteArray(file, geo->PolygonNormals);
+            WriteArray(file, geo->PolygonCenters);
+            WriteArray(file, geo->VertexPolygonOffsets);
+            WriteArray(file, geo->VertexPolygons);
+            WriteArray(file, geo->PolygonFaces);
+            WriteArray(file, geo->PolygonEdges);
+            WriteArray(file, geo->ClusterOffsets);
+            WriteArray(file, geo->ClusterSpheres);
+            WriteArray(file, geo->ClusterCones);
+        }
+
+        if (!file.good())
+        {
+            LOG_WARN("ModelCache: Failed writing {0}.", tempFilename.c_str());
+            file.close();
+            std::remove(tempFilename.c_str());
+            return false;
+        }
+    }
+
+    std::remove(cacheFilename.c_str());
+    if (std::rename(tempFilename.c_str(), cacheFilename.c_str()) != 0)
+    {
+        std::remove(tempFilename.c_str());
+        return false;
+    }
+
+    LOG_INFO("ModelCache: Saved {0}.", cacheFilename.c_str());
+    return true;
+}
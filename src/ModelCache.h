@@ -0,0 +1,48 @@
+#pragma once
+
+#include "pch.h"
+#include "Geometry.h"
+#include <cstdint>
+
+// Fully processed model, ready to be used without recomputing normals,
+// centers or bounds. Geometries returned by ModelCache::Load are owned by
+// the caller. A cache is only loaded if it was triangulated, optimized and
+// welded the same way.
+struct CachedModel
+{
+    bool IsTriangulated;
+    bool IsOptimized;
+    // Negative if the positions were not welded
+    double WeldEpsilon;
+
+    std::vector<Vec4> Positions;
+    std::vector<Vec4> TexCoords;
+    std::vector<Vec4> Normals;
+    std::vector<Geometry*> Geometries;
+
+    CachedModel() : IsTriangulated(false), IsOptimized(false), WeldEpsilon(-1.0) {}
+};
+
+// Size, modification time and a hash of the first and last bytes of a
+// source file
+struct ModelSourceKey
+{
+    uint64_t Size;
+    int64_t Time;
+    uint64_t Hash;
+};
+
+// Binary cache written next to the source file (<file>.cache). It is keyed
+// by the source size, modification time and a hash of its contents and read
+// back through a memory mapping.
+class ModelCache
+{
+public:
+    static std::string GetCacheFilename(const std::string& filename);
+    // Returns false if the file can't be read
+    static bool GetSourceKey(const std::string& filename, ModelSourceKey& key);
+
+    // Returns false if there is no cache or it is out of date
+    static bool Load(const std::string& filename, CachedModel& model);
+    static bool Save(const std::string& filename, const CachedModel& model);
+};
@@ -0,0 +1,172 @@
+#include "ModelLoader.h"
+#include "Model.h"
+
+#include <chrono>
+
+ModelLoader::ModelLoader()
+    : nextID(0)
+{
+
+}
+
+ModelLoader::~ModelLoader()
+{
+    CancelAll();
+    Wait();
+
+    for (Model* model : TakeFinished())
+        delete model;
+}
+
+unsigned int ModelLoader::Start(const std::string& filename, const ModelLoadProgressCallback& onProgress, 
+    const ModelLoadDoneCallback& onDone)
+{
+    ModelLoadJob* job = new ModelLoadJob();
+    job->Filename = filename;
+    job->IsDone = false;
+    job->Result = NULL;
+    if (Settings::IsProgressiveLoadingEnabled)
+        job->Progress.Preview = &job->Preview;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    job->ID = nextID++;
+    if (onProgress)
+    {
+        unsigned int id = job->ID;
+        job->Progress.Callback = [onProgress, id](size_t bytesRead, size_t totalBytes) 
+        { 
+            onProgress(id, bytesRead, totalBytes); 
+        };
+    }
+    jobs.push_back(job);
+    job->Thread = std::thread(&ModelLoader::Run, this, job, onDone);
+
+    LOG_INFO("ModelLoader: Started loading {0} ({1}).", filename.c_str(), job->ID);
+    return job->ID;
+}
+
+void ModelLoader::Cancel(unsigned int id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (ModelLoadJob* job : jobs)
+    {
+        if (job->ID == id)
+            job->Progress.IsCancelled = true;
+    }
+}
+
+void ModelLoader::CancelAll()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (ModelLoadJob* job : jobs)
+        job->Progress.IsCancelled = true;
+}
+
+void ModelLoader::Wait()
+{
+    // Threads are joined outside the lock, the jobs stay until TakeFinished
+    std::vector<std::thread*> threads;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (ModelLoadJob* job : jobs)
+            threads.push_back(&job->Thread);
+    }
+
+    for (std::thread* thread : threads)
+    {
+        if (thread->joinable())
+            thread->join();
+    }
+}
+
+std::vector<Model*> ModelLoader::TakeFinished()
+{
+    std::vector<Model*> models;
+    std::vector<ModelLoadJob*> finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        unsigned int active = 0;
+        for (ModelLoadJob* job : jobs)
+        {
+            if (job->IsDone)
+                finished.push_back(job);
+            else
+                jobs[active++] = job;
+        }
+        jobs.resize(active);
+    }
+
+    for (ModelLoadJob* job : finished)
+    {
+        // The thread may still be calling onDone
+        if (job->Thread.joinable())
+            job->Thread.join();
+        if (job->Result != NULL)
+            models.push_back(job->Result);
+        delete job;
+    }
+
+    return models;
+}
+
+unsigned int ModelLoader::GetActiveCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    unsigned int count = 0;
+    for (const ModelLoadJob* job : jobs)
+        count += job->IsDone ? 0 : 1;
+    return count;
+}
+
+void ModelLoader::GetProgress(size_t& bytesRead, size_t& totalBytes) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    bytesRead = 0;
+    totalBytes = 0;
+    for (const ModelLoadJob* job : jobs)
+    {
+        if (job->IsDone)
+            continue;
+        bytesRead += job->Progress.BytesRead;
+        totalBytes += job->Progress.TotalBytes;
+    }
+}
+
+void ModelLoader::GetPreviews(std::vector<ModelPreview*>& previews)
+{
+    previews.clear();
+    for (ModelLoadJob* job : jobs)
+    {
+        if (job->Progress.Preview != NULL)
+            previews.push_back(job->Progress.Preview);
+    }
+}
+
+void ModelLoader::Run(ModelLoadJob* job, ModelLoadDoneCallback onDone)
+{
+    std::chrono::steady_clock::time_point before = std::chrono::steady_clock::now();
+
+    Model* model = new Model();
+    if (!model->LoadFromFile(job->Filename, &job->Progress) || job->Progress.IsCancelled)
+    {
+        delete model;
+        model = NULL;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - before).count();
+    if (model != NULL)
+        LOG_INFO("ModelLoader: Loaded {0} in {1} s.", job->Filename.c_str(), seconds);
+    else if (job->Progress.IsCancelled)
+        LOG_INFO("ModelLoader: Cancelled loading {0} after {1} s.", job->Filename.c_str(), seconds);
+    else
+        LOG_ERROR("ModelLoader: Could not load {0}.", job->Filename.c_str());
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job->Result = model;
+        job->IsDone = true;
+    }
+
+    if (onDone)
+        onDone(job->ID);
+}
\ No newline at end of file
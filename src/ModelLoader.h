@@ -0,0 +1,65 @@
+#pragma once
+
+#include "pch.h"
+#include "LoadProgress.h"
+#include "ModelPreview.h"
+#include <thread>
+#include <mutex>
+
+class Model;
+
+// Both run on the loading threads, they must not call back into the loader
+typedef std::function<void(unsigned int id, size_t bytesRead, size_t totalBytes)> ModelLoadProgressCallback;
+typedef std::function<void(unsigned int id)> ModelLoadDoneCallback;
+
+// A load running on its own thread. Result is set once IsDone, it stays NULL
+// if the load failed or was cancelled.
+struct ModelLoadJob
+{
+    unsigned int ID;
+    std::string Filename;
+    LoadProgress Progress;
+    ModelPreview Preview;
+    std::thread Thread;
+    bool IsDone;
+    Model* Result;
+};
+
+// Loads models on background threads, one per file. Finished models wait
+// until the owner takes them, so whatever they are added to is only changed
+// on the owner's thread.
+class ModelLoader
+{
+public:
+    ModelLoader();
+    ~ModelLoader();
+
+    ModelLoader(ModelLoader const&) = delete;
+    void operator=(ModelLoader const&) = delete;
+
+    // Returns the load's id
+    unsigned int Start(const std::string& filename, const ModelLoadProgressCallback& onProgress, 
+        const ModelLoadDoneCallback& onDone);
+    void Cancel(unsigned int id);
+    void CancelAll();
+    // Blocks until every load has finished
+    void Wait();
+
+    // Models of the finished loads in the order they were started
+    std::vector<Model*> TakeFinished();
+
+    unsigned int GetActiveCount() const;
+    // Summed over the active loads
+    void GetProgress(size_t& bytesRead, size_t& totalBytes) const;
+    // Partial geometry of the loads not taken yet. Doesn't lock, jobs are only
+    // added and removed on the owner's thread which must be the caller.
+    void GetPreviews(std::vector<ModelPreview*>& previews);
+
+private:
+    void Run(ModelLoadJob* job, ModelLoadDoneCallback onDone);
+
+private:
+    std::vector<ModelLoadJob*> jobs;
+    mutable std::mutex mutex;
+    unsigned int nextID;
+};
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include "ModelPreview.h"
+#include "Model.h"
+#include "ObjParser.h"
+
+ModelPreview::ModelPreview()
+    : SeenVersion(0), FramedBounds(NULL), bounds(NULL), first(NULL), version(0), 
+    last(NULL), publishedFaces(0), boundedPositions(0)
+{
+
+}
+
+ModelPreview::~ModelPreview()
+{
+    ModelPreviewBounds* snapshot = bounds.load();
+    while (snapshot != NULL)
+    {
+        ModelPreviewBounds* previous = snapshot->Previous;
+        delete snapshot;
+        snapshot = previous;
+    }
+
+    ModelPreviewBatch* batch = first.load();
+    while (batch != NULL)
+    {
+        ModelPreviewBatch* next = batch->Next.load();
+        delete batch->Batch;
+        delete batch;
+        batch = next;
+    }
+}
+
+void ModelPreview::Publish(const ObjData& data, unsigned int batchSize, bool isLast)
+{
+    unsigned int faceCount = data.GetFaceCount();
+    if (faceCount == 0)
+        return;
+
+    // Most files list every position before the first face, but some
+    // interleave positions and faces, so the bounds are extended by the
+    // positions parsed since the last call and republished when they grow
+    ModelPreviewBounds* current = bounds.load(std::memory_order_relaxed);
+    if (boundedPositions < data.Positions.size())
+    {
+        Vec4 min = (current != NULL) ? current->Min : data.Positions[boundedPositions];
+        Vec4 max = (current != NULL) ? current->Max : data.Positions[boundedPositions];
+        bool isGrown = (current == NULL);
+        for (size_t i = boundedPositions; i < data.Positions.size(); i++)
+        {
+            const Vec4& position = data.Positions[i];
+            for (int j = 0; j < 3; j++)
+            {
+                if (position[j] < min[j])
+                {
+                    min[j] = position[j];
+                    isGrown = true;
+                }
+                if (position[j] > max[j])
+                {
+                    max[j] = position[j];
+                    isGrown = true;
+                }
+            }
+        }
+        boundedPositions = data.Positions.size();
+
+        if (isGrown)
+        {
+            ModelPreviewBounds* snapshot = new ModelPreviewBounds();
+            snapshot->Min = min;
+            snapshot->Max = max;
+            snapshot->Previous = current;
+            bounds.store(snapshot, std::memory_order_release);
+            version.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    batchSize = std::max(batchSize, 1u);
+    vertexIndices.resize(data.Positions.size(), -1);
+    while ((faceCount - publishedFaces >= batchSize) || (isLast && (publishedFaces < faceCount)))
+    {
+        unsigned int lastFace = std::min(publishedFaces + batchSize, faceCount);
+        std::shared_ptr<const Mesh> mesh(Mesh::BuildPreview(data, publishedFaces, lastFace, vertexIndices));
+        Append(new Model(mesh));
+        publishedFaces = lastFace;
+    }
+}
+
+const ModelPreviewBounds* ModelPreview::GetBounds() const
+{
+    return bounds.load(std::memory_order_acquire);
+}
+
+const ModelPreviewBatch* ModelPreview::GetFirstBatch() const
+{
+    return first.load(std::memory_order_acquire);
+}
+
+unsigned int ModelPreview::GetVersion() const
+{
+    return version.load(std::memory_order_acquire);
+}
+
+void ModelPreview::Append(Model* batch)
+{
+    ModelPreviewBatch* node = new ModelPreviewBatch();
+    node->Batch = batch;
+    node->Next.store(NULL, std::memory_order_relaxed);
+
+    if (last == NULL)
+        first.store(node, std::memory_order_release);
+    else
+        last->Next.store(node, std::memory_order_release);
+    last = node;
+    version.fetch_add(1, std::memory_order_release);
+}
\ No newline at end of file
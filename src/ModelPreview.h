@@ -0,0 +1,66 @@
+#pragma once
+
+#include "pch.h"
+#include <atomic>
+
+class Model;
+struct ObjData;
+
+// Bounds of the positions parsed so far, replaced by a new one when they grow
+struct ModelPreviewBounds
+{
+    Vec4 Min;
+    Vec4 Max;
+    ModelPreviewBounds* Previous;
+};
+
+// A batch of faces of a model still loading, drawn as a model of its own
+struct ModelPreviewBatch
+{
+    Model* Batch;
+    std::atomic<ModelPreviewBatch*> Next;
+};
+
+// Partial geometry of a model while its file is parsed. The loading thread
+// publishes the bounds first and then batches of faces. Readers never lock:
+// bounds and batches are complete before they are linked in, and nothing is
+// freed until the preview is deleted after the load.
+class ModelPreview
+{
+public:
+    ModelPreview();
+    ~ModelPreview();
+
+    ModelPreview(ModelPreview const&) = delete;
+    void operator=(ModelPreview const&) = delete;
+
+    // Loading thread. Publishes the bounds once there are faces and again
+    // whenever new positions grow them, and the faces parsed since the last
+    // batch in batches of batchSize, the rest too if isLast.
+    void Publish(const ObjData& data, unsigned int batchSize, bool isLast);
+
+    // Any thread
+    const ModelPreviewBounds* GetBounds() const;
+    const ModelPreviewBatch* GetFirstBatch() const;
+    // Changes whenever something is published
+    unsigned int GetVersion() const;
+
+public:
+    // Owner thread bookkeeping
+    unsigned int SeenVersion;
+    const ModelPreviewBounds* FramedBounds;
+
+private:
+    void Append(Model* batch);
+
+private:
+    std::atomic<ModelPreviewBounds*> bounds;
+    std::atomic<ModelPreviewBatch*> first;
+    std::atomic<unsigned int> version;
+
+    // Loading thread only
+    ModelPreviewBatch* last;
+    unsigned int publishedFaces;
+    size_t boundedPositions;
+    std::vector<int> vertexIndices;
+};
\ No newline at end of file
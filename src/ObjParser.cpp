@@ -0,0 +1,302 @@
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include "TextParsing.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <chrono>
+
+// Files smaller than this per thread are parsed on a single thread
+#define OBJ_MIN_CHUNK_SIZE (4 * 1024 * 1024)
+// Bytes parsed between progress reports and cancellation checks
+#define OBJ_PROGRESS_BLOCK_SIZE (1024 * 1024)
+// Bytes parsed between block callbacks
+#define OBJ_STREAM_BLOCK_SIZE (16 * OBJ_MIN_CHUNK_SIZE)
+
+// Where a chunk's elements start in the merged ObjData
+struct ObjChunkOffsets
+{
+    size_t Positions;
+    size_t TexCoords;
+    size_t Normals;
+    size_t Indices;
+    size_t Faces;
+
+    ObjChunkOffsets()
+        : Positions(0), TexCoords(0), Normals(0), Indices(0), Faces(0) {}
+};
+
+// Converts an OBJ index (1 based, or negative relative to the end) to 0 based
+static inline int ResolveIndex(int index, size_t count)
+{
+    return (index < 0) ? (int)count + index : index - 1;
+}
+
+static const char* ParseFace(const char* p, const char* end, ObjData& data)
+{
+    while (true)
+    {
+        p = SkipBlanks(p, end);
+        if ((p >= end) || (*p == '\n') || (*p == '#') || 
+            !(IsDigit(*p) || (*p == '-') || (*p == '+')))
+            break;
+
+        int posID = 0;
+        int texID = 0;
+        int normID = 0;
+
+        // v, v/t, v//n or v/t/n
+        p = ParseInt(p, end, posID);
+        if ((p < end) && (*p == '/'))
+        {
+            p++;
+            if ((p < end) && (*p != '/'))
+                p = ParseInt(p, end, texID);
+            if ((p < end) && (*p == '/'))
+                p = ParseInt(p + 1, end, normID);
+        }
+
+        unsigned int corner = data.Indices.size();
+        ObjIndex index;
+        index.PositionID = ResolveIndex(posID, data.Positions.size());
+        if (posID < 0)
+            data.RelativePositions.push_back(corner);
+        if (texID != 0)
+            index.TexCoordID = ResolveIndex(texID, data.TexCoords.size());
+        if (texID < 0)
+            data.RelativeTexCoords.push_back(corner);
+        if (normID != 0)
+            index.NormalID = ResolveIndex(normID, data.Normals.size());
+        if (normID < 0)
+            data.RelativeNormals.push_back(corner);
+        data.Indices.push_back(index);
+    }
+
+    data.FaceOffsets.push_back(data.Indices.size());
+
+    return p;
+}
+
+void ObjParser::ParseRange(const char* begin, const char* end, ObjData& data, 
+    LoadProgress* progress)
+{
+    const char* p = begin;
+    const char* reported = begin;
+    while (p < end)
+    {
+        if ((progress != NULL) && (p - reported >= OBJ_PROGRESS_BLOCK_SIZE))
+        {
+            progress->AddBytes(p - reported);
+            reported = p;
+            if (progress->IsCancelled)
+                return;
+        }
+
+        p = SkipBlanks(p, end);
+        if (p >= end)
+            break;
+
+        char c0 = *p;
+        char c1 = (p + 1 < end) ? p[1] : '\0';
+        char c2 = (p + 2 < end) ? p[2] : '\0';
+
+        if ((c0 == 'v') && IsBlank(c1))
+        {
+            Vec4 position(0.0, 0.0, 0.0, 1.0);
+            p += 2;
+            for (int i = 0; i < 3; i++)
+                p = ParseDouble(SkipBlanks(p, end), end, position[i]);
+            data.Positions.push_back(position);
+        }
+        else if ((c0 == 'v') && (c1 == 'n') && IsBlank(c2))
+        {
+            Vec4 normal;
+            p += 3;
+            for (int i = 0; i < 3; i++)
+                p = ParseDouble(SkipBlanks(p, end), end, normal[i]);
+            data.Normals.push_back(normal);
+        }
+        else if ((c0 == 'v') && (c1 == 't') && IsBlank(c2))
+        {
+            Vec4 texCoords;
+            p += 3;
+            for (int i = 0; i < 2; i++)
+                p = ParseDouble(SkipBlanks(p, end), end, texCoords[i]);
+            // Optional third coordinate
+            p = SkipBlanks(p, end);
+            if ((p < end) && (IsDigit(*p) || (*p == '-') || (*p == '+') || (*p == '.')))
+                p = ParseDouble(p, end, texCoords[2]);
+            data.TexCoords.push_back(texCoords);
+        }
+        else if ((c0 == 'f') && IsBlank(c1))
+        {
+            p = ParseFace(p + 2, end, data);
+        }
+        else if ((c0 == 'g') && (IsBlank(c1) || (c1 == '\n')))
+        {
+            data.GroupFaces.push_back(data.GetFaceCount());
+        }
+
+        p = SkipLine(p, end);
+    }
+
+    if (progress != NULL)
+        progress->AddBytes(end - reported);
+}
+
+bool ObjParser::Parse(const std::string& filename, ObjData& data, unsigned int threadCount, 
+    LoadProgress* progress, const ObjBlockCallback& onBlock)
+{
+    MappedFile file;
+    if (!file.Open(filename))
+        return false;
+    if (progress != NULL)
+        progress->TotalBytes = file.GetSize();
+
+    clock_t before = clock();
+    std::chrono::steady_clock::time_point wallBefore = std::chrono::steady_clock::now();
+
+    if (threadCount == 0)
+    {
+        threadCount = MaxInt(1, std::thread::hardware_concurrency());
+        threadCount = MinInt(threadCount, MaxInt(1, file.GetSize() / OBJ_MIN_CHUNK_SIZE));
+    }
+
+    const char* begin = file.GetData();
+    const char* end = file.GetData() + file.GetSize();
+    if (!onBlock)
+    {
+        ParseBlock(begin, end, data, threadCount, progress);
+    }
+    else
+    {
+        // Blocks end at line boundaries and are appended to data
+        const char* blockBegin = begin;
+        while ((blockBegin < end) && !IsLoadCancelled(progress))
+        {
+            const char* blockEnd = (end - blockBegin > OBJ_STREAM_BLOCK_SIZE) ? 
+                SkipLine(blockBegin + OBJ_STREAM_BLOCK_SIZE, end) : end;
+            unsigned int blockThreads = MinInt(threadCount, MaxInt(1, (blockEnd - blockBegin) / OBJ_MIN_CHUNK_SIZE));
+            ParseBlock(blockBegin, blockEnd, data, blockThreads, progress);
+            if (!IsLoadCancelled(progress))
+                onBlock(data);
+            blockBegin = blockEnd;
+        }
+    }
+
+    if (IsLoadCancelled(progress))
+    {
+        LOG_INFO("ObjParser::Parse: {0} was cancelled.", filename.c_str());
+        return false;
+    }
+
+    // Relative indices are final at this point
+    data.RelativePositions.clear();
+    data.RelativeTexCoords.clear();
+    data.RelativeNormals.clear();
+
+    // Faces before the first group are put in an implicit one
+    if ((data.GetFaceCount() > 0) && ((data.GroupFaces.size() == 0) || (data.GroupFaces[0] != 0)))
+        data.GroupFaces.insert(data.GroupFaces.begin(), 0);
+
+    double seconds = (double)(clock() - before) / CLOCKS_PER_SEC;
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallBefore).count();
+    double megabytes = file.GetSize() / (1024.0 * 1024.0);
+    LOG_INFO("ObjParser::Parse: {0} MB, {1} faces on {2} threads in {3} s ({4} MB/s, {5} s CPU)", 
+        megabytes, data.GetFaceCount(), threadCount, wallSeconds, 
+        (wallSeconds > 0.0) ? megabytes / wallSeconds : 0.0, seconds);
+
+    return true;
+}
+
+void ObjParser::ParseBlock(const char* begin, const char* end, ObjData& data, 
+    unsigned int threadCount, LoadProgress* progress)
+{
+    if (threadCount > 1)
+        ParseChunks(begin, end, data, threadCount, progress);
+    else
+        ParseRange(begin, end, data, progress);
+}
+
+// Copies a chunk into its (already sized) range of data, fixing up indices
+static void MergeChunk(const ObjData& chunk, const ObjChunkOffsets& offsets, ObjData& data)
+{
+    int positionBase = offsets.Positions;
+    int texCoordBase = offsets.TexCoords;
+    int normalBase = offsets.Normals;
+    unsigned int indexBase = offsets.Indices;
+    unsigned int faceBase = offsets.Faces;
+
+    std::copy(chunk.Positions.begin(), chunk.Positions.end(), data.Positions.begin() + positionBase);
+    std::copy(chunk.TexCoords.begin(), chunk.TexCoords.end(), data.TexCoords.begin() + texCoordBase);
+    std::copy(chunk.Normals.begin(), chunk.Normals.end(), data.Normals.begin() + normalBase);
+    std::copy(chunk.Indices.begin(), chunk.Indices.end(), data.Indices.begin() + indexBase);
+
+    for (unsigned int f = 1; f < chunk.FaceOffsets.size(); f++)
+        data.FaceOffsets[faceBase + f] = chunk.FaceOffsets[f] + indexBase;
+
+    for (unsigned int corner : chunk.RelativePositions)
+        data.Indices[indexBase + corner].PositionID += positionBase;
+    for (unsigned int corner : chunk.RelativeTexCoords)
+        data.Indices[indexBase + corner].TexCoordID += texCoordBase;
+    for (unsigned int corner : chunk.RelativeNormals)
+        data.Indices[indexBase + corner].NormalID += normalBase;
+}
+
+void ObjParser::ParseChunks(const char* begin, const char* end, ObjData& data, 
+    unsigned int threadCount, LoadProgress* progress)
+{
+    // Split at line boundaries
+    std::vector<const char*> bounds(threadCount + 1, end);
+    bounds[0] = begin;
+    for (unsigned int i = 1; i < threadCount; i++)
+    {
+        const char* split = begin + (size_t)(end - begin) * i / threadCount;
+        split = (split < bounds[i - 1]) ? bounds[i - 1] : SkipLine(split, end);
+        bounds[i] = split;
+    }
+
+    std::vector<ObjData> chunks(threadCount);
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < threadCount; i++)
+        threads.push_back(std::thread(ParseRange, bounds[i], bounds[i + 1], std::ref(chunks[i]), progress));
+    for (std::thread& thread : threads)
+        thread.join();
+
+    if (IsLoadCancelled(progress))
+        return;
+
+    // Prefix sums of the chunk sizes give every chunk its place in the result,
+    // after what data already has
+    std::vector<ObjChunkOffsets> offsets(threadCount);
+    ObjChunkOffsets total;
+    total.Positions = data.Positions.size();
+    total.TexCoords = data.TexCoords.size();
+    total.Normals = data.Normals.size();
+    total.Indices = data.Indices.size();
+    total.Faces = data.GetFaceCount();
+    for (unsigned int i = 0; i < threadCount; i++)
+    {
+        offsets[i] = total;
+        total.Positions += chunks[i].Positions.size();
+        total.TexCoords += chunks[i].TexCoords.size();
+        total.Normals += chunks[i].Normals.size();
+        total.Indices += chunks[i].Indices.size();
+        total.Faces += chunks[i].GetFaceCount();
+        for (unsigned int group : chunks[i].GroupFaces)
+            data.GroupFaces.push_back(group + offsets[i].Faces);
+    }
+
+    data.Positions.resize(total.Positions);
+    data.TexCoords.resize(total.TexCoords);
+    data.Normals.resize(total.Normals);
+    data.Indices.resize(total.Indices);
+    data.FaceOffsets.resize(total.Faces + 1);
+
+    threads.clear();
+    for (unsigned int i = 0; i < threadCount; i++)
+        threads.push_back(std::thread(MergeChunk, std::cref(chunks[i]), std::cref(offsets[i]), std::ref(data)));
+    for (std::thread& thread : threads)
+        thread.join();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "pch.h"
+#include "LoadProgress.h"
+
+// Indices of one face corner (0 based, -1 if missing)
+struct ObjIndex
+{
+    int PositionID;
+    int TexCoordID;
+    int NormalID;
+
+    ObjIndex(int posID = -1, int texCoordID = -1, int normalID = -1)
+        : PositionID(posID), TexCoordID(texCoordID), NormalID(normalID) {}
+};
+
+// Flat contents of an OBJ file, the STL and PLY parsers fill it too
+struct ObjData
+{
+    std::vector<Vec4> Positions;
+    std::vector<Vec4> TexCoords;
+    std::vector<Vec4> Normals;
+
+    // Face i uses Indices[FaceOffsets[i]] to Indices[FaceOffsets[i + 1] - 1]
+    std::vector<ObjIndex> Indices;
+    std::vector<unsigned int> FaceOffsets;
+
+    // Index of the first face of every group (g)
+    std::vector<unsigned int> GroupFaces;
+
+    // Corners with negative (relative) indices, resolved against the counts
+    // seen by the parser. A chunk adds the counts of the chunks before it.
+    std::vector<unsigned int> RelativePositions;
+    std::vector<unsigned int> RelativeTexCoords;
+    std::vector<unsigned int> RelativeNormals;
+
+    ObjData() { FaceOffsets.push_back(0); }
+
+    unsigned int GetFaceCount() const { return FaceOffsets.size() - 1; }
+};
+
+// Called with everything parsed so far
+typedef std::function<void(const ObjData& data)> ObjBlockCallback;
+
+class ObjParser
+{
+public:
+    // threadCount 0 picks one thread per core for large files. If onBlock is
+    // set the file is parsed in blocks of a few tens of MB and onBlock is
+    // called after each. Returns false if the file can't be opened or
+    // progress was cancelled.
+    static bool Parse(const std::string& filename, ObjData& data, unsigned int threadCount = 0, 
+        LoadProgress* progress = NULL, const ObjBlockCallback& onBlock = ObjBlockCallback());
+    static void ParseRange(const char* begin, const char* end, ObjData& data, 
+        LoadProgress* progress = NULL);
+
+private:
+    static void ParseBlock(const char* begin, const char* end, ObjData& data, 
+        unsigned int threadCount, LoadProgress* progress);
+    static void ParseChunks(const char* begin, const char* end, ObjData& data, 
+        unsigned int threadCount, LoadProgress* progress);
+};
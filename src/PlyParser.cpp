@@ -0,0 +1,478 @@
+#include "PlyParser.h"
+#include "MappedFile.h"
+#include "TextParsing.h"
+
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <sstream>
+
+// Bytes per thread below which fewer threads are used
+#define PLY_MIN_CHUNK_SIZE (4 * 1024 * 1024)
+// Records between cancellation checks
+#define PLY_CANCEL_CHECK_RECORDS (64 * 1024)
+
+enum PlyFormat
+{
+    PLY_ASCII,
+    PLY_BINARY_LITTLE_ENDIAN,
+    PLY_BINARY_BIG_ENDIAN
+};
+
+enum PlyType
+{
+    PLY_INVALID,
+    PLY_INT8,
+    PLY_UINT8,
+    PLY_INT16,
+    PLY_UINT16,
+    PLY_INT32,
+    PLY_UINT32,
+    PLY_FLOAT32,
+    PLY_FLOAT64
+};
+
+// CountType is PLY_INVALID unless the property is a list
+struct PlyProperty
+{
+    std::string Name;
+    PlyType Type;
+    PlyType CountType;
+};
+
+// Stride is the size of a binary record, 0 if the element has a list
+struct PlyElement
+{
+    std::string Name;
+    size_t Count;
+    std::vector<PlyProperty> Properties;
+    size_t Stride;
+};
+
+struct PlyHeader
+{
+    PlyFormat Format;
+    std::vector<PlyElement> Elements;
+};
+
+// Faces of a range of face records
+struct PlyFaceChunk
+{
+    std::vector<unsigned int> Sizes;
+    std::vector<int> Indices;
+};
+
+static PlyType GetType(const std::string& name)
+{
+    static const char* names[][2] = {
+        { "char", "int8" }, { "uchar", "uint8" }, { "short", "int16" }, { "ushort", "uint16" },
+        { "int", "int32" }, { "uint", "uint32" }, { "float", "float32" }, { "double", "float64" }
+    };
+    for (int i = 0; i < 8; i++)
+    {
+        if ((name == names[i][0]) || (name == names[i][1]))
+            return (PlyType)(PLY_INT8 + i);
+    }
+    return PLY_INVALID;
+}
+
+static size_t GetTypeSize(PlyType type)
+{
+    static const size_t sizes[] = { 0, 1, 1, 2, 2, 4, 4, 4, 8 };
+    return sizes[type];
+}
+
+static int FindProperty(const PlyElement& element, const char* name, const char* otherName = NULL)
+{
+    for (unsigned int i = 0; i < element.Properties.size(); i++)
+    {
+        const std::string& propertyName = element.Properties[i].Name;
+        if ((propertyName == name) || ((otherName != NULL) && (propertyName == otherName)))
+            return i;
+    }
+    return -1;
+}
+
+// Returns where the data starts, NULL if the header isn't valid
+static const char* ParseHeader(const char* begin, const char* end, PlyHeader& header)
+{
+    const char* p = begin;
+    bool isFormatFound = false;
+    bool isPly = false;
+    while (p < end)
+    {
+        const char* lineEnd = SkipLine(p, end);
+        std::istringstream line(std::string(p, lineEnd));
+        p = lineEnd;
+
+        std::string keyword;
+        line >> keyword;
+        if (!isPly)
+        {
+            if (keyword != "ply")
+                return NULL;
+            isPly = true;
+        }
+        else if (keyword == "format")
+        {
+            std::string format;
+            line >> format;
+            if (format == "ascii")
+                header.Format = PLY_ASCII;
+            else if (format == "binary_little_endian")
+                header.Format = PLY_BINARY_LITTLE_ENDIAN;
+            else if (format == "binary_big_endian")
+                header.Format = PLY_BINARY_BIG_ENDIAN;
+            else
+                return NULL;
+            isFormatFound = true;
+        }
+        else if (keyword == "element")
+        {
+            PlyElement element;
+            line >> element.Name >> element.Count;
+            if (line.fail())
+                return NULL;
+            element.Stride = 0;
+            header.Elements.push_back(element);
+        }
+        else if (keyword == "property")
+        {
+            if (header.Elements.empty())
+                return NULL;
+
+            PlyProperty property;
+            std::string type;
+            line >> type;
+            property.CountType = PLY_INVALID;
+            if (type == "list")
+            {
+                std::string countType;
+                line >> countType >> type;
+                property.CountType = GetType(countType);
+                if (property.CountType == PLY_INVALID)
+                    return NULL;
+            }
+            property.Type = GetType(type);
+            line >> property.Name;
+            if ((property.Type == PLY_INVALID) || line.fail())
+                return NULL;
+            header.Elements.back().Properties.push_back(property);
+        }
+        else if (keyword == "end_header")
+        {
+            break;
+        }
+    }
+    if (!isFormatFound)
+        return NULL;
+
+    for (PlyElement& element : header.Elements)
+    {
+        for (const PlyProperty& property : element.Properties)
+            element.Stride += (property.CountType == PLY_INVALID) ? GetTypeSize(property.Type) : 0;
+        for (const PlyProperty& property : element.Properties)
+            element.Stride = (property.CountType == PLY_INVALID) ? element.Stride : 0;
+    }
+
+    return p;
+}
+
+static inline double ReadBinary(const char* p, PlyType type, bool isSwapped)
+{
+    char bytes[8];
+    size_t size = GetTypeSize(type);
+    memcpy(bytes, p, size);
+    if (isSwapped)
+        std::reverse(bytes, bytes + size);
+
+    switch (type)
+    {
+        case PLY_INT8: return *(int8_t*)bytes;
+        case PLY_UINT8: return *(uint8_t*)bytes;
+        case PLY_INT16: { int16_t v; memcpy(&v, bytes, 2); return v; }
+        case PLY_UINT16: { uint16_t v; memcpy(&v, bytes, 2); return v; }
+        case PLY_INT32: { int32_t v; memcpy(&v, bytes, 4); return v; }
+        case PLY_UINT32: { uint32_t v; memcpy(&v, bytes, 4); return v; }
+        case PLY_FLOAT32: { float v; memcpy(&v, bytes, 4); return v; }
+        case PLY_FLOAT64: { double v; memcpy(&v, bytes, 8); return v; }
+        default: return 0.0;
+    }
+}
+
+// Reads one record at p. Scalar properties go to values in property order,
+// lists put their size there and the items of the list at listProperty go
+// to list. Returns the end of the record, NULL if the file ends first.
+static const char* ReadRecord(const char* p, const char* end, PlyFormat format, 
+    const PlyElement& element, double* values, int listProperty, std::vector<int>& list)
+{
+    list.clear();
+    if (format == PLY_ASCII)
+    {
+        for (unsigned int i = 0; i < element.Properties.size(); i++)
+        {
+            p = SkipBlanks(p, end);
+            if ((p >= end) || (*p == '\n'))
+                return NULL;
+            p = ParseDouble(p, end, values[i]);
+            if (element.Properties[i].CountType == PLY_INVALID)
+                continue;
+
+            // Every item takes at least a blank and a digit, anything more
+            // (and negative or NaN counts) can't be read and doesn't fit an int
+            if (!(values[i] >= 0.0) || (values[i] > (double)(end - p)))
+                return NULL;
+            for (int j = 0; j < (int)values[i]; j++)
+            {
+                double item;
+                p = SkipBlanks(p, end);
+                if ((p >= end) || (*p == '\n'))
+                    return NULL;
+                p = ParseDouble(p, end, item);
+                if ((int)i == listProperty)
+                    list.push_back((int)item);
+            }
+        }
+        return SkipLine(p, end);
+    }
+
+    bool isSwapped = format == PLY_BINARY_BIG_ENDIAN;
+    for (unsigned int i = 0; i < element.Properties.size(); i++)
+    {
+        const PlyProperty& property = element.Properties[i];
+        bool isList = property.CountType != PLY_INVALID;
+        PlyType type = isList ? property.CountType : property.Type;
+        if ((size_t)(end - p) < GetTypeSize(type))
+            return NULL;
+        values[i] = ReadBinary(p, type, isSwapped);
+        p += GetTypeSize(type);
+        if (!isList)
+            continue;
+
+        // Signed and float counts can be negative or too large for size_t,
+        // and p + count * itemSize could overflow before the comparison
+        size_t itemSize = GetTypeSize(property.Type);
+        if (!(values[i] >= 0.0) || (values[i] > (double)((size_t)(end - p) / itemSize)))
+            return NULL;
+        size_t count = (size_t)values[i];
+        for (size_t j = 0; ((int)i == listProperty) && (j < count); j++)
+            list.push_back((int)ReadBinary(p + j * itemSize, property.Type, isSwapped));
+        p += count * itemSize;
+    }
+    return p;
+}
+
+// Finds where the element's records start for every chunk, starts[chunkCount]
+// is the end of the element. Returns false if the file ends first.
+static bool SplitRecords(const char* p, const char* end, PlyFormat format, const PlyElement& element, 
+    unsigned int chunkCount, std::vector<const char*>& starts)
+{
+    starts.assign(chunkCount + 1, NULL);
+    if ((format != PLY_ASCII) && (element.Stride > 0))
+    {
+        if ((size_t)(end - p) < element.Count * element.Stride)
+            return false;
+        for (unsigned int i = 0; i <= chunkCount; i++)
+            starts[i] = p + element.Count * i / chunkCount * element.Stride;
+        return true;
+    }
+
+    // Records have no fixed size, walk them
+    std::vector<double> values(element.Properties.size());
+    std::vector<int> list;
+    unsigned int chunk = 0;
+    for (size_t r = 0; r < element.Count; r++)
+    {
+        while ((chunk < chunkCount) && (r == element.Count * chunk / chunkCount))
+            starts[chunk++] = p;
+
+        if (format == PLY_ASCII)
+            p = (p < end) ? SkipLine(p, end) : NULL;
+        else
+            p = ReadRecord(p, end, format, element, values.data(), -1, list);
+        if (p == NULL)
+            return false;
+    }
+    while (chunk <= chunkCount)
+        starts[chunk++] = p;
+    return true;
+}
+
+static void ReadVertices(const char* p, const char* end, PlyFormat format, const PlyElement& element, 
+    size_t first, size_t last, ObjData& data, LoadProgress* progress, std::atomic<bool>& isValid)
+{
+    int position[3] = { FindProperty(element, "x"), FindProperty(element, "y"), FindProperty(element, "z") };
+    int normal[3] = { FindProperty(element, "nx"), FindProperty(element, "ny"), FindProperty(element, "nz") };
+    int texCoord[2] = { FindProperty(element, "u", "s"), FindProperty(element, "v", "t") };
+    if (texCoord[0] < 0)
+        texCoord[0] = FindProperty(element, "texture_u", "texture_s");
+    if (texCoord[1] < 0)
+        texCoord[1] = FindProperty(element, "texture_v", "texture_t");
+
+    std::vector<double> values(element.Properties.size());
+    std::vector<int> list;
+    for (size_t v = first; (v < last) && (p != NULL); v++)
+    {
+        if (((v - first) % PLY_CANCEL_CHECK_RECORDS == 0) && IsLoadCancelled(progress))
+            return;
+
+        p = ReadRecord(p, end, format, element, values.data(), -1, list);
+        for (int i = 0; i < 3; i++)
+            data.Positions[v][i] = (position[i] >= 0) ? values[position[i]] : 0.0;
+        for (int i = 0; (i < 3) && !data.Normals.empty(); i++)
+            data.Normals[v][i] = values[normal[i]];
+        for (int i = 0; (i < 2) && !data.TexCoords.empty(); i++)
+            data.TexCoords[v][i] = values[texCoord[i]];
+    }
+
+    if (p == NULL)
+        isValid = false;
+}
+
+static void ReadFaces(const char* p, const char* end, PlyFormat format, const PlyElement& element, 
+    size_t count, PlyFaceChunk& chunk, LoadProgress* progress, std::atomic<bool>& isValid)
+{
+    int indices = FindProperty(element, "vertex_indices", "vertex_index");
+    std::vector<double> values(element.Properties.size());
+    std::vector<int> list;
+    chunk.Sizes.reserve(count);
+    chunk.Indices.reserve(count * 3);
+    for (size_t f = 0; (f < count) && (p != NULL); f++)
+    {
+        if ((f % PLY_CANCEL_CHECK_RECORDS == 0) && IsLoadCancelled(progress))
+            return;
+
+        p = ReadRecord(p, end, format, element, values.data(), indices, list);
+        chunk.Sizes.push_back(list.size());
+        chunk.Indices.insert(chunk.Indices.end(), list.begin(), list.end());
+    }
+
+    if (p == NULL)
+        isValid = false;
+}
+
+bool PlyParser::Parse(const std::string& filename, ObjData& data, unsigned int threadCount, 
+    LoadProgress* progress)
+{
+    MappedFile file;
+    if (!file.Open(filename))
+        return false;
+    if (progress != NULL)
+        progress->TotalBytes = file.GetSize();
+
+    std::chrono::steady_clock::time_point before = std::chrono::steady_clock::now();
+
+    const char* end = file.GetData() + file.GetSize();
+    PlyHeader header;
+    const char* p = ParseHeader(file.GetData(), end, header);
+    if (p == NULL)
+    {
+        LOG_ERROR("PlyParser::Parse: {0} doesn't have a valid PLY header.", filename.c_str());
+        return false;
+    }
+
+    if (threadCount == 0)
+    {
+        threadCount = MaxInt(1, std::thread::hardware_concurrency());
+        threadCount = MinInt(threadCount, MaxInt(1, file.GetSize() / PLY_MIN_CHUNK_SIZE));
+    }
+
+    // Elements are read in file order, each split in chunks read in parallel.
+    // Every chunk's thread clears isValid if its records run past the end.
+    std::atomic<bool> isValid(true);
+    size_t vertexCount = 0;
+    for (const PlyElement& element : header.Elements)
+    {
+        bool isVertex = (element.Name == "vertex") && (vertexCount == 0);
+        bool isFace = element.Name == "face";
+        unsigned int chunkCount = (isVertex || isFace) ? MaxInt(1, MinInt(threadCount, element.Count)) : 1;
+
+        std::vector<const char*> starts;
+        if (!SplitRecords(p, end, header.Format, element, chunkCount, starts))
+        {
+            isValid = false;
+            break;
+        }
+
+        std::vector<std::thread> threads;
+        if (isVertex)
+        {
+            vertexCount = element.Count;
+            data.Positions.resize(vertexCount, Vec4(0.0, 0.0, 0.0, 1.0));
+            if ((FindProperty(element, "nx") >= 0) && (FindProperty(element, "ny") >= 0) && 
+                (FindProperty(element, "nz") >= 0))
+                data.Normals.resize(vertexCount);
+            if (((FindProperty(element, "u", "s") >= 0) || (FindProperty(element, "texture_u", "texture_s") >= 0)) && 
+                ((FindProperty(element, "v", "t") >= 0) || (FindProperty(element, "texture_v", "texture_t") >= 0)))
+                data.TexCoords.resize(vertexCount);
+
+            for (unsigned int i = 0; i < chunkCount; i++)
+            {
+                threads.push_back(std::thread(ReadVertices, starts[i], end, header.Format, std::cref(element),
+                    element.Count * i / chunkCount, element.Count * (i + 1) / chunkCount, std::ref(data), 
+                    progress, std::ref(isValid)));
+            }
+            for (std::thread& thread : threads)
+                thread.join();
+        }
+        else if (isFace && (FindProperty(element, "vertex_indices", "vertex_index") >= 0))
+        {
+            std::vector<PlyFaceChunk> chunks(chunkCount);
+            for (unsigned int i = 0; i < chunkCount; i++)
+            {
+                threads.push_back(std::thread(ReadFaces, starts[i], end, header.Format, std::cref(element),
+                    element.Count * (i + 1) / chunkCount - element.Count * i / chunkCount, std::ref(chunks[i]), 
+                    progress, std::ref(isValid)));
+            }
+            for (std::thread& thread : threads)
+                thread.join();
+
+            // Corners share the index of their vertex's position, normal and texture coordinates
+            for (const PlyFaceChunk& chunk : chunks)
+            {
+                size_t corner = 0;
+                for (unsigned int size : chunk.Sizes)
+                {
+                    for (unsigned int i = 0; i < size; i++, corner++)
+                    {
+                        int index = chunk.Indices[corner];
+                        if ((index < 0) || ((size_t)index >= vertexCount))
+                        {
+                            data.Indices.push_back(ObjIndex());
+                            continue;
+                        }
+                        data.Indices.push_back(ObjIndex(index, data.TexCoords.empty() ? -1 : index, 
+                            data.Normals.empty() ? -1 : index));
+                    }
+                    data.FaceOffsets.push_back(data.Indices.size());
+                }
+            }
+        }
+
+        if (progress != NULL)
+            progress->AddBytes(starts[chunkCount] - p);
+        p = starts[chunkCount];
+        if (!isValid || IsLoadCancelled(progress))
+            break;
+    }
+
+    if (IsLoadCancelled(progress))
+    {
+        LOG_INFO("PlyParser::Parse: {0} was cancelled.", filename.c_str());
+        return false;
+    }
+    if (!isValid)
+    {
+        LOG_ERROR("PlyParser::Parse: {0} ends before its last element.", filename.c_str());
+        return false;
+    }
+    if (data.GetFaceCount() > 0)
+        data.GroupFaces.push_back(0);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - before).count();
+    LOG_INFO("PlyParser::Parse: {0} vertices, {1} faces on {2} threads in {3} s.", 
+        vertexCount, data.GetFaceCount(), threadCount, seconds);
+
+    return true;
+}
\ No newline at end of file
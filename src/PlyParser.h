@@ -0,0 +1,18 @@
+#pragma once
+
+#include "pch.h"
+#include "ObjParser.h"
+#include "LoadProgress.h"
+
+// ASCII and binary (either byte order) PLY reader. Vertices may have
+// positions, normals (nx, ny, nz) and texture coordinates (u, v or s, t),
+// faces a vertex_indices list. Other elements and properties are skipped.
+class PlyParser
+{
+public:
+    // threadCount 0 picks one thread per core for large files. Returns false
+    // if the file can't be opened, its header isn't valid or progress was
+    // cancelled.
+    static bool Parse(const std::string& filename, ObjData& data, unsigned int threadCount = 0, 
+        LoadProgress* progress = NULL);
+};
\ No newline at end of file
@@ -0,0 +1,173 @@
+#include "Quat.h"
+#include "ALMath.h"
+
+Mat4 Quat::ToMatrix() const
+{
+	double xx = X * X, yy = Y * Y, zz = Z * Z;
+	double xy = X * Y, xz = X * Z, yz = Y * Z;
+	double wx = W * X, wy = W * Y, wz = W * Z;
+
+	// Transpose of the usual column vector rotation matrix
+	return Mat4(1.0 - 2.0 * (yy + zz), 2.0 * (xy + wz), 2.0 * (xz - wy), 0.0,
+		2.0 * (xy - wz), 1.0 - 2.0 * (xx + zz), 2.0 * (yz + wx), 0.0,
+		2.0 * (xz + wy), 2.0 * (yz - wx), 1.0 - 2.0 * (xx + yy), 0.0,
+		0.0, 0.0, 0.0, 1.0);
+}
+
+Quat Quat::FromMatrix(const Mat4& m)
+{
+	// m[i][j] is the transpose of the column vector matrix element (j, i)
+	double trace = m[0][0] + m[1][1] + m[2][2];
+	Quat q;
+	if (trace > 0.0)
+	{
+		double s = sqrt(trace + 1.0) * 2.0;
+		q.W = 0.25 * s;
+		q.X = (m[1][2] - m[2][1]) / s;
+		q.Y = (m[2][0] - m[0][2]) / s;
+		q.Z = (m[0][1] - m[1][0]) / s;
+	}
+	else if ((m[0][0] > m[1][1]) && (m[0][0] > m[2][2]))
+	{
+		double s = sqrt(1.0 + m[0][0] - m[1][1] - m[2][2]) * 2.0;
+		q.W = (m[1][2] - m[2][1]) / s;
+		q.X = 0.25 * s;
+		q.Y = (m[1][0] + m[0][1]) / s;
+		q.Z = (m[2][0] + m[0][2]) / s;
+	}
+	else if (m[1][1] > m[2][2])
+	{
+		double s = sqrt(1.0 + m[1][1] - m[0][0] - m[2][2]) * 2.0;
+		q.W = (m[2][0] - m[0][2]) / s;
+		q.X = (m[1][0] + m[0][1]) / s;
+		q.Y = 0.25 * s;
+		q.Z = (m[2][1] + m[1][2]) / s;
+	}
+	else
+	{
+		double s = sqrt(1.0 + m[2][2] - m[0][0] - m[1][1]) * 2.0;
+		q.W = (m[0][1] - m[1][0]) / s;
+		q.X = (m[2][0] + m[0][2]) / s;
+		q.Y = (m[2][1] + m[1][2]) / s;
+		q.Z = 0.25 * s;
+	}
+	return Normalize(q);
+}
+
+Quat Quat::FromAxisAngle(const Vec4& axis, double angleInDegrees)
+{
+	Vec4 n = Vec4::Normalize3(axis);
+	double halfAngle = ToRadians(angleInDegrees) / 2.0;
+	double s = sin(halfAngle);
+	return Quat(n[0] * s, n[1] * s, n[2] * s, cos(halfAngle));
+}
+
+double Quat::Dot(const Quat& a, const Quat& b)
+{
+	return a.X * b.X + a.Y * b.Y + a.Z * b.Z + a.W * b.W;
+}
+
+Quat Quat::Normalize(const Quat& q)
+{
+	double length = sqrt(Dot(q, q));
+	if (length < AL_DBL_EPSILON)
+		return Quat();
+	return Quat(q.X / length, q.Y / length, q.Z / length, q.W / length);
+}
+
+Quat Quat::Nlerp(const Quat& a, const Quat& b, double t)
+{
+	// Take the shortest path
+	double sign = (Dot(a, b) < 0.0) ? -1.0 : 1.0;
+	return Normalize(Quat(a.X * (1.0 - t) + b.X * sign * t, a.Y * (1.0 - t) + b.Y * sign * t,
+		a.Z * (1.0 - t) + b.Z * sign * t, a.W * (1.0 - t) + b.W * sign * t));
+}
+
+Quat Quat::Slerp(const Quat& a, const Quat& b, double t)
+{
+	double cosTheta = Dot(a, b);
+	Quat end = b;
+	if (cosTheta < 0.0)
+	{
+		cosTheta = -cosTheta;
+		end = Quat(-b.X, -b.Y, -b.Z, -b.W);
+	}
+
+	// Nearly parallel, nlerp is accurate and avoids dividing by sin(theta) ~ 0
+	if (cosTheta > 0.9995)
+		return Nlerp(a, end, t);
+
+	double theta = acos(cosTheta);
+	double sinTheta = sin(theta);
+	double wa = sin((1.0 - t) * theta) / sinTheta;
+	double wb = sin(t * theta) / sinTheta;
+	return Quat(a.X * wa + end.X * wb, a.Y * wa + end.Y * wb, 
+		a.Z * wa + end.Z * wb, a.W * wa + end.W * wb);
+}
+
+Mat4 TRS::ToMatrix() const
+{
+	// S * R * T composed directly: rows of R scaled, translation in the last row
+	Mat4 result = Rotation.ToMatrix();
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 3; j++)
+			result[i][j] *= Scale[i];
+		result[3][i] = Translation[i];
+	}
+	return result;
+}
+
+TRS TRS::FromMatrix(const Mat4& m)
+{
+	TRS result;
+	result.Translation = Vec4(m[3][0], m[3][1], m[3][2]);
+
+	Mat4 rotation;
+	for (int i = 0; i < 3; i++)
+	{
+		Vec4 row(m[i][0], m[i][1], m[i][2], 0.0);
+		result.Scale[i] = Vec4::Length3(row);
+		if (result.Scale[i] < AL_DBL_EPSILON)
+		{
+			result.IsExact = false;
+			return result;
+		}
+		rotation[i] = row / result.Scale[i];
+	}
+
+	// A mirroring matrix: move the reflection into the scale
+	if (Vec4::Dot3(Vec4::Cross(rotation[0], rotation[1]), rotation[2]) < 0.0)
+	{
+		result.Scale[0] = -result.Scale[0];
+		rotation[0] = -rotation[0];
+	}
+	rotation[3] = Vec4(0.0, 0.0, 0.0, 1.0);
+	result.Rotation = Quat::FromMatrix(rotation);
+
+	// Shear (non-uniform scale after rotation) or projection can't be represented
+	Mat4 rebuilt = result.ToMatrix();
+	for (int i = 0; i < 4 && result.IsExact; i++)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			if (abs(rebuilt[i][j] - m[i][j]) > 1e-6)
+			{
+				result.IsExact = false;
+				break;
+			}
+		}
+	}
+
+	return result;
+}
+
+TRS TRS::Interpolate(const TRS& a, const TRS& b, double t)
+{
+	TRS result;
+	result.Translation = a.Translation * (1.0 - t) + b.Translation * t;
+	result.Scale = a.Scale * (1.0 - t) + b.Scale * t;
+	result.Rotation = Quat::Slerp(a.Rotation, b.Rotation, t);
+	result.IsExact = a.IsExact && b.IsExact;
+	return result;
+}
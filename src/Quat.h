@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Mat4.h"
+
+class Quat
+{
+public:
+	double X;
+	double Y;
+	double Z;
+	double W;
+
+public:
+	// Constructors
+	Quat(double x = 0.0, double y = 0.0, double z = 0.0, double w = 1.0)
+		: X(x), Y(y), Z(z), W(w) {}
+
+	// Rotation matrix (row vector convention, v' = v * R)
+	Mat4 ToMatrix() const;
+
+	// Static methods
+	static Quat FromMatrix(const Mat4& m);
+	static Quat FromAxisAngle(const Vec4& axis, double angleInDegrees);
+	static double Dot(const Quat& a, const Quat& b);
+	static Quat Normalize(const Quat& q);
+	static Quat Nlerp(const Quat& a, const Quat& b, double t);
+	static Quat Slerp(const Quat& a, const Quat& b, double t);
+};
+
+// Translation, rotation and scale of an affine matrix M = S * R * T
+struct TRS
+{
+	Vec4 Translation;
+	Quat Rotation;
+	Vec4 Scale;
+	// False if the matrix had shear or projection and can't be rebuilt from TRS
+	bool IsExact;
+
+	TRS()
+		: Translation(0.0, 0.0, 0.0), Scale(1.0, 1.0, 1.0), IsExact(true) {}
+
+	Mat4 ToMatrix() const;
+
+	static TRS FromMatrix(const Mat4& m);
+	static TRS Interpolate(const TRS& a, const TRS& b, double t);
+};
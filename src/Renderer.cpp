@@ -296,16 +296,12 @@ Vec4 Renderer::getStbColor(unsigned char* data, unsigned numChannels, int x, int
     return color;
 }
 
-void Renderer::DrawEdge(const Vec4& p0, const Vec4& p1, const Mat4& objectToWorld, const Mat4& camTransform,
-    const Mat4& viewTransform, const Mat4& projection, const wxColour& color, int thickness)
+void Renderer::DrawEdge(const Vec4& p0, const Vec4& p1, const Mat4& objectToClip, 
+    const wxColour& color, int thickness)
 {
-    // Get vertices positions in object space
-    Vec4 pos1 = p0;
-    Vec4 pos2 = p1;
-
-    // Transform vertices from object space to NDC
-    pos1 = pos1 * objectToWorld * camTransform * viewTransform * projection;
-    pos2 = pos2 * objectToWorld * camTransform * viewTransform * projection;
+    // Transform vertices from object space to NDC (the caller composes the matrix once)
+    Vec4 pos1 = p0 * objectToClip;
+    Vec4 pos2 = p1 * objectToClip;
 
     // Divide by w
     pos1 /= pos1[3];
@@ -319,16 +315,64 @@ void Renderer::DrawEdge(const Vec4& p0, const Vec4& p1, const Mat4& objectToWorl
     DrawLine(pos1Pix, pos2Pix, color, thickness);
 }
 
-void Renderer::DrawPolygon(Polygon* poly, Model* model, const Mat4& objectToWorld, 
-    const Mat4& camTransform, const Mat4& viewTransform, const Mat4& projection, const wxColour& color)
+void Renderer::TransformVertices(const Mesh* mesh, const Mat4& objectToClip)
 {
-    for (unsigned int i = 0; i < poly->Vertices.size(); i++)
+    clock_t before = clock();
+
+    // Transform vertices from object space to clip space
+    mesh->TransformPositions(objectToClip, m_ScreenPoints);
+    size_t n = m_ScreenPoints.Size();
+
+    // Divide by w and transform to screen space
+    m_ToScreen.PerspectiveDivide(m_ScreenPoints.X.data(), m_ScreenPoints.Y.data(), 
+        m_ScreenPoints.Z.data(), m_ScreenPoints.W.data(), n);
+
+    double seconds = (double)(clock() - before) / CLOCKS_PER_SEC;
+    if (seconds > 0.0)
     {
-        // Get vertices positions in object space
-        Vec4 pos1 = model->VertexPositions[poly->Vertices[i]->PositionID];
-        Vec4 pos2 = model->VertexPositions[poly->Vertices[(i + 1) % poly->Vertices.size()]->PositionID];
+        LOG_TRACE("Renderer::TransformVertices: {0} vertices, {1} Mvertices/s per core", 
+            n, (n / seconds) / 1000000.0);
+    }
+}
 
-        DrawEdge(pos1, pos2, objectToWorld, camTransform, viewTransform, projection, color);
+const PointStream& Renderer::GetScreenPoints() const
+{
+    return m_ScreenPoints;
+}
+
+void Renderer::DrawPolygon(const Geometry* geo, unsigned int p, const wxColour& color)
+{
+    const unsigned int* vertices = geo->GetPolygonVertices(p);
+    unsigned int size = geo->GetPolygonSize(p);
+    for (unsigned int i = 0; i < size; i++)
+    {
+        // Get vertices positions in screen space
+        int id1 = geo->VertexPositionIDs[vertices[i]];
+        int id2 = geo->VertexPositionIDs[vertices[(i + 1) % size]];
+        Vec4 pos1Pix(m_ScreenPoints.X[id1], m_ScreenPoints.Y[id1], m_ScreenPoints.Z[id1]);
+        Vec4 pos2Pix(m_ScreenPoints.X[id2], m_ScreenPoints.Y[id2], m_ScreenPoints.Z[id2]);
+
+        DrawLine(pos1Pix, pos2Pix, color);
+    }
+}
+
+void Renderer::DrawTriangle(const Geometry* geo, unsigned int t, const wxColour& color)
+{
+    // Triangles are stored back to back, only edges of the source face are drawn
+    const unsigned int* vertices = &geo->PolygonVertices[3 * t];
+    unsigned char edges = geo->PolygonEdges[t];
+
+    Vec4 posPix[3];
+    for (int i = 0; i < 3; i++)
+    {
+        int id = geo->VertexPositionIDs[vertices[i]];
+        posPix[i] = Vec4(m_ScreenPoints.X[id], m_ScreenPoints.Y[id], m_ScreenPoints.Z[id]);
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        if (edges & (1 << i))
+            DrawLine(posPix[i], posPix[(i + 1) % 3], color);
     }
 }
 
@@ -341,29 +385,32 @@ void Renderer::InitZBuffer()
         m_ZBuffer[i] = -std::numeric_limits<double>::max();
 }
 
-void Renderer::FillPolygon(Model* model, Polygon* p, const Mat4& camTransform,
+void Renderer::FillPolygon(Model* model, const Geometry* geo, unsigned int p, const Mat4& camTransform,
     const Mat4& projection, const Vec4& color)
 {
-    Mat4 objectToWorld = model->GetObjectToWorldTransform();
-    Mat4 viewTransform = model->GetViewTransform();
+    Mat4 objectToView = model->GetObjectToWorldTransform() * camTransform * model->GetViewTransform();
+    Mat4 normalToView = Mat4::NormalMatrix(objectToView);
+    const Mesh* mesh = model->GetMesh();
 
     // Build Edges and send to scanConvert
     std::vector<Edge> poly;
-    for (unsigned int i = 0; i < p->Vertices.size(); i++)
+    const unsigned int* vertices = geo->GetPolygonVertices(p);
+    unsigned int size = geo->GetPolygonSize(p);
+    for (unsigned int i = 0; i < size; i++)
     {
-        Vertex* v1 = p->Vertices[i];
-        Vertex* v2 = p->Vertices[(i + 1) % p->Vertices.size()];
+        unsigned int v1 = vertices[i];
+        unsigned int v2 = vertices[(i + 1) % size];
         // Get vertices positions and normals in object space
-        Vec4 pos1 = model->VertexPositions[v1->PositionID];
-        Vec4 pos2 = model->VertexPositions[v2->PositionID];
-        Vec4 norm1 = model->VertexNormals[v1->NormalID];
-        Vec4 norm2 = model->VertexNormals[v2->NormalID];
+        Vec4 pos1 = mesh->GetPosition(geo->VertexPositionIDs[v1]);
+        Vec4 pos2 = mesh->GetPosition(geo->VertexPositionIDs[v2]);
+        Vec4 norm1 = mesh->GetNormal(geo->VertexNormalIDs[v1]);
+        Vec4 norm2 = mesh->GetNormal(geo->VertexNormalIDs[v2]);
 
         // Transform vertices and normals from object space to Camera space
-        Vec4 pos1VS = pos1 * objectToWorld * camTransform * viewTransform;
-        Vec4 pos2VS = pos2 * objectToWorld * camTransform * viewTransform;
-        Vec4 normal1VS = norm1 * objectToWorld * camTransform * viewTransform;
-        Vec4 normal2VS = norm2 * objectToWorld * camTransform * viewTransform;
+        Vec4 pos1VS = pos1 * objectToView;
+        Vec4 pos2VS = pos2 * objectToView;
+        Vec4 normal1VS = normalToView.TransformNormal(norm1);
+        Vec4 normal2VS = normalToView.TransformNormal(norm2);
 
         // Transform vertices from Camera space to NDC
         Vec4 pos1Prj = pos1VS * projection;
@@ -396,8 +443,8 @@ void Renderer::FillPolygon(Model* model, Polygon* p, const Mat4& camTransform,
         poly.push_back({ dv1, dv2 });
     }
 
-    Vec4 polyCenter = p->Center * objectToWorld * camTransform * viewTransform;
-    Vec4 polyNormal = p->Normal * objectToWorld * camTransform * viewTransform;
+    Vec4 polyCenter = geo->PolygonCenters[p] * objectToView;
+    Vec4 polyNormal = normalToView.TransformNormal(geo->PolygonNormals[p]);
     wxColour colorToSC((unsigned int)color[0], (unsigned int)color[1], (unsigned int)color[2]);
     scanConvert(poly, colorToSC, polyCenter, polyNormal);
 }
@@ -31,13 +31,15 @@ public:
     void DrawBackground(const Vec4& color);
     void DrawBackgroundImage(const std::string& filename, bool stretch = true,
         ImageInterpolationType interpolation = IMG_NEAREST_NEIGHBOUR);
-    void DrawEdge(const Vec4& p0, const Vec4& p1, const Mat4& objectToWorld, const Mat4& camTransform,
-        const Mat4& viewTransform, const Mat4& projection, const wxColour& color, int thickness = 0);
-    void DrawPolygon(Polygon* poly, Model* model, const Mat4& objectToWorld, 
-        const Mat4& camTransform, const Mat4& viewTransform, const Mat4& projection, const wxColour& color);
+    void DrawEdge(const Vec4& p0, const Vec4& p1, const Mat4& objectToClip, 
+        const wxColour& color, int thickness = 0);
+    void TransformVertices(const Mesh* mesh, const Mat4& objectToClip);
+    const PointStream& GetScreenPoints() const;
+    void DrawPolygon(const Geometry* geo, unsigned int p, const wxColour& color);
+    void DrawTriangle(const Geometry* geo, unsigned int t, const wxColour& color);
 
     void InitZBuffer();
-    void FillPolygon(Model* model, Polygon* p, const Mat4& camTransform,
+    void FillPolygon(Model* model, const Geometry* geo, unsigned int p, const Mat4& camTransform,
         const Mat4& projection, const Vec4& color);
 
 private:
@@ -53,6 +55,9 @@ private:
     Mat4 m_ToScreen;
     Mat4 m_ToScreenInverse;
 
+    // Screen space positions of the model last passed to TransformVertices
+    PointStream m_ScreenPoints;
+
     wxDC* m_DC;
     double* m_ZBuffer;
 };
\ No newline at end of file
@@ -1,5 +1,68 @@
 #include "Scene.h"
 
+#include <set>
+
+// Object space planes (x, y, z, d) of the left, right, bottom and top clip
+// planes, inside is positive. Visible points have the sign of w of the view
+// space point (0, 0, 1). There are no depth planes, the renderer does not
+// clip depth.
+static void GetFrustumPlanes(const Mat4& objectToClip, const Mat4& projection, Vec4 planes[4])
+{
+    double frontSign = (projection[2][3] + projection[3][3] < 0.0) ? -1.0 : 1.0;
+    for (int i = 0; i < 4; i++)
+    {
+        double sign = (i % 2 == 0) ? 1.0 : -1.0;
+        int axis = i / 2;
+        for (int j = 0; j < 4; j++)
+            planes[i][j] = frontSign * objectToClip[j][3] + sign * objectToClip[j][axis];
+
+        double length = Vec4::Length3(planes[i]);
+        if (length > AL_DBL_EPSILON)
+            planes[i] /= length;
+    }
+}
+
+static bool IsSphereOutside(const Vec4& sphere, const Vec4 planes[4])
+{
+    for (int i = 0; i < 4; i++)
+    {
+        if (Vec4::Dot3(planes[i], sphere) + planes[i][3] < -sphere[3])
+            return true;
+    }
+
+    return false;
+}
+
+// True if the box's corner farthest along one of the planes' normals is
+// outside it
+static bool IsBoxOutside(const Vec4& min, const Vec4& max, const Vec4 planes[4])
+{
+    for (int i = 0; i < 4; i++)
+    {
+        const Vec4& plane = planes[i];
+        double distance = plane[3];
+        for (int j = 0; j < 3; j++)
+            distance += plane[j] * ((plane[j] >= 0.0) ? max[j] : min[j]);
+        if (distance < 0.0)
+            return true;
+    }
+
+    return false;
+}
+
+// True if every polygon whose normal is in the cone and center is in the
+// sphere is back facing. eye is the camera position (w = 1) or, for an
+// orthographic camera, the direction back faces point to (w = 0).
+static bool IsConeBackFacing(const Vec4& sphere, const Vec4& cone, const Vec4& eye)
+{
+    if (eye[3] == 0.0)
+        return Vec4::Dot3(cone, eye) > cone[3];
+
+    Vec4 toSphere = sphere - eye;
+    return Vec4::Dot3(cone, toSphere) > 
+        cone[3] * Vec4::Length3(toSphere) + sphere[3] * (1.0 + cone[3]);
+}
+
 Scene::Scene()
     : selectedModelIndex(-1)
 {
@@ -14,6 +77,13 @@ Scene::~Scene()
 
 void Scene::ClearScene()
 {
+    // Models still loading would be added to the cleared scene when they
+    // finish, and their previews would frame the new camera
+    CancelLoadingModels(true);
+    for (Model* model : loader.TakeFinished())
+        delete model;
+    loadingPreviews.clear();
+
     DeleteModels();
     delete camera;
 
@@ -24,14 +94,88 @@ bool Scene::LoadModelFromFile(const std::string& filename)
 {
     // Load model
     Model* model = new Model();
-    model->LoadFromFile(filename);
+    if (!model->LoadFromFile(filename))
+    {
+        delete model;
+        return false;
+    }
+    addModel(model);
+
+    return true;
+}
+
+unsigned int Scene::StartLoadingModel(const std::string& filename, 
+    const ModelLoadProgressCallback& onProgress, const ModelLoadDoneCallback& onDone)
+{
+    return loader.Start(filename, onProgress, onDone);
+}
+
+void Scene::CancelLoadingModel(unsigned int id)
+{
+    loader.Cancel(id);
+}
+
+void Scene::CancelLoadingModels(bool wait)
+{
+    loader.CancelAll();
+    if (wait)
+        loader.Wait();
+}
+
+unsigned int Scene::AddLoadedModels()
+{
+    std::vector<Model*> loaded = loader.TakeFinished();
+    for (Model* model : loaded)
+        addModel(model);
+
+    return loaded.size();
+}
+
+unsigned int Scene::GetLoadingModelCount() const
+{
+    return loader.GetActiveCount();
+}
+
+void Scene::GetLoadingProgress(size_t& bytesRead, size_t& totalBytes) const
+{
+    loader.GetProgress(bytesRead, totalBytes);
+}
+
+bool Scene::UpdateLoadingPreviews()
+{
+    bool isChanged = false;
+    loader.GetPreviews(loadingPreviews);
+    for (ModelPreview* preview : loadingPreviews)
+    {
+        unsigned int version = preview->GetVersion();
+        if (version == preview->SeenVersion)
+            continue;
+        preview->SeenVersion = version;
+        isChanged = true;
+
+        // Loaded models start at the origin, object space bounds are world space.
+        // The bounds grow while files that interleave positions and faces
+        // load, the finished model is framed again when it's added.
+        const ModelPreviewBounds* bounds = preview->GetBounds();
+        if ((bounds != NULL) && (bounds != preview->FramedBounds))
+        {
+            FrameCameraOnBounds(bounds->Min, bounds->Max);
+            preview->FramedBounds = bounds;
+        }
+    }
+
+    return isChanged;
+}
+
+void Scene::addModel(Model* model)
+{
     models.push_back(model);
     selectedModelIndex = models.size() - 1;
+    model->SetSceneNode(&sceneGraph, sceneGraph.AddNode(-1, model));
+    spatialIndex.Insert(model, selectedModelIndex);
 
     // Frame camera on model
     FrameCameraOnModel(model);
-
-    return true;
 }
 
 std::vector<Model*>& Scene::GetModels()
@@ -39,6 +183,30 @@ std::vector<Model*>& Scene::GetModels()
     return models;
 }
 
+bool Scene::SetModelParent(Model* model, Model* parent)
+{
+    // The model keeps its place in the world, its transform becomes relative
+    // to the new parent
+    Mat4 objectToWorld = model->GetObjectToWorldTransform();
+    if (!sceneGraph.SetParent(model->GetSceneNode(), (parent != NULL) ? (int)parent->GetSceneNode() : -1))
+        return false;
+
+    Mat4 parentToWorld = sceneGraph.GetParentWorldTransform(model->GetSceneNode());
+    model->SetObjectToParentTransform(objectToWorld * Mat4::Inverse(parentToWorld));
+    return true;
+}
+
+Model* Scene::GetModelParent(Model* model)
+{
+    int parent = sceneGraph.GetParent(model->GetSceneNode());
+    return (parent >= 0) ? sceneGraph.GetModel(parent) : NULL;
+}
+
+SceneGraph& Scene::GetSceneGraph()
+{
+    return sceneGraph;
+}
+
 Model* Scene::GetSelectedModel()
 {
     if (selectedModelIndex < 0)
@@ -107,94 +275,49 @@ void Scene::selectModelPoly(const Vec4& mousePos)
     LOG_TRACE("Scene::SelectModel: lineDirection (x, y, z): ({0}, {1}, {2}).",
                 lineDirection[0], lineDirection[1], lineDirection[2]);
 
-    const Mat4& worldToView = camera->GetWorldToViewTransform();
+    // The ray parameter is the same in every model's object space, so the
+    // nearest hit over all models is the one with the smallest t
+    Vec4 lineOrigin(0.0, 0.0, 0.0);
+    if (!isPerspective) lineOrigin = Vec4(mousePosView[0], mousePosView[1], mousePosView[2]);
+    Vec4 lineVector(lineDirection[0], lineDirection[1], lineDirection[2], 0.0);
 
-    std::vector<unsigned int> indexes;
-    for (unsigned int m = 0; m < models.size(); m++)
+    const Mat4& worldToView = camera->GetWorldToViewTransform();
+    Mat4 viewToWorld = Mat4::InverseAffine(worldToView);
+
+    // Broad phase: models whose world bounds the ray enters, nearest first
+    std::vector<std::pair<double, unsigned int> > candidates;
+    sceneGraph.Update();
+    spatialIndex.Update();
+    spatialIndex.CollectHits(lineOrigin * viewToWorld, lineVector * viewToWorld, 
+        std::numeric_limits<double>::max(), candidates);
+    std::sort(candidates.begin(), candidates.end());
+
+    MeshBVHHit hit;
+    int hitIndex = -1;
+    for (const std::pair<double, unsigned int>& candidate : candidates)
     {
-        bool addedModel = false;
-        Model* model = models[m];
+        // The remaining models all start behind the nearest hit
+        if (candidate.first >= hit.T)
+            break;
+
+        Model* model = models[candidate.second];
         const Mat4& objToWorld = model->GetObjectToWorldTransform();
         const Mat4& viewTransform = model->GetViewTransform();
 
-        for (Geometry* geo : model->GetGeometries())
-        {
-            for (Polygon* poly : geo->Polygons)
-            {
-                Vec4 normal = poly->Normal * objToWorld * worldToView * viewTransform;
-                normal = Vec4::Normalize3(normal);
-                Vec4 center = poly->Center * objToWorld * worldToView * viewTransform;
-
-                if (abs(Vec4::Dot3(normal, lineDirection)) <= AL_DBL_EPSILON)
-                    continue;
-
-                Vec4 linePos = Vec4(0.0, 0.0, 0.0);
-                if (!isPerspective) linePos = mousePosView;
-                double up = Vec4::Dot3(normal, center) - Vec4::Dot3(normal, linePos);
-                double down = Vec4::Dot3(normal, lineDirection);
-                double t = up / down;
-                if (t <= 0)
-                    continue;
-                
-                Vec4 intersectionPoint = lineDirection * t + linePos;
-
-                std::vector<double> point;
-                point.push_back(intersectionPoint[0]);
-                point.push_back(intersectionPoint[1]);
-
-                std::vector<Vec4Line> polyTemp;
-                for (unsigned int i = 0; i < poly->Vertices.size(); i++)
-                {
-                    // Get vertices positions in object space
-                    Vec4 pos1 = model->VertexPositions[poly->Vertices[i]->PositionID];
-                    Vec4 pos2 = model->VertexPositions[poly->Vertices[(i + 1) % poly->Vertices.size()]->PositionID];
-
-                    // Transform to View space
-                    pos1 = pos1 * objToWorld * worldToView * viewTransform;
-                    pos2 = pos2 * objToWorld * worldToView * viewTransform;
-
-                    Vec4Line edge(pos1, pos2);
-                    polyTemp.push_back(edge);
-                }
-
-                if (PointPolyIntersection(point, polyTemp))
-                {
-                    indexes.push_back(m);
-                    addedModel = true;
-                    break;
-                }
-            }
-
-            if (addedModel)
-            break;
-        }
+        Mat4 viewToObject = Mat4::InverseAffine(objToWorld * worldToView * viewTransform);
+        if (model->Intersect(lineOrigin * viewToObject, lineVector * viewToObject, hit))
+            hitIndex = candidate.second;
     }
-    LOG_TRACE("Scene::SelectModel: indexes.size(): {0}.", indexes.size());
 
-    if (indexes.size() == 0)
+    if (hitIndex < 0)
     {
         ClearModelSelection();
         return;
     }
 
-    int minIndex = indexes[0];
-    for (unsigned int i = 1; i < indexes.size(); i++)
-    {
-        Vec4 center = models[indexes[i]]->GetModelBBoxCenter() * 
-            models[indexes[i]]->GetObjectToWorldTransform() * worldToView * 
-                models[indexes[i]]->GetViewTransform();
-
-        Vec4 minCenter = models[indexes[minIndex]]->GetModelBBoxCenter() * 
-            models[indexes[minIndex]]->GetObjectToWorldTransform() * worldToView * 
-                models[indexes[minIndex]]->GetViewTransform();
-
-        LOG_TRACE("Scene::SelectModel: center length: {0}", Vec4::Length3(center));
-        LOG_TRACE("Scene::SelectModel: minCenter length: {0}", Vec4::Length3(minCenter));
-        if (Vec4::Length3(center) < Vec4::Length3(minCenter))
-            minIndex = indexes[i];
-    }
-
-    selectedModelIndex = minIndex;
+    LOG_TRACE("Scene::SelectModel: Hit model {0}, geometry {1}, polygon {2} at t {3}.",
+        hitIndex, hit.GeometryIndex, hit.Polygon, hit.T);
+    selectedModelIndex = hitIndex;
 }
 
 void Scene::selectModelBBox(const Vec4& mousePos)
@@ -228,11 +351,19 @@ void Scene::selectModelBBox(const Vec4& mousePos)
         const Mat4& objToWorld = model->GetObjectToWorldTransform();
         const Mat4& viewTransform = model->GetViewTransform();
 
-        for (Polygon* poly : model->BoundingBoxPolygons)
+        Mat4 objectToView = objToWorld * worldToView * viewTransform;
+        Mat4 normalToView = Mat4::NormalMatrix(objectToView);
+
+        // Transform all of the model's vertices to View space once
+        PointStream viewPositions;
+        TransformToView(model, objectToView, viewPositions);
+
+        const Geometry* box = model->GetMesh()->BoundingBox;
+        for (unsigned int p = 0; (box != NULL) && (p < box->GetPolygonCount()); p++)
         {
-            Vec4 normal = poly->Normal * objToWorld * worldToView * viewTransform;
-            normal = Vec4::Normalize3(normal);
-            Vec4 center = poly->Center * objToWorld * worldToView * viewTransform;
+            // The plane intersection below does not need a unit normal
+            Vec4 normal = normalToView.TransformNormal(box->PolygonNormals[p]);
+            Vec4 center = box->PolygonCenters[p] * objectToView;
 
             if (abs(Vec4::Dot3(normal, lineDirection)) <= AL_DBL_EPSILON)
                 continue;
@@ -254,15 +385,13 @@ void Scene::selectModelBBox(const Vec4& mousePos)
             point.push_back(intersectionPoint[1]);
 
             std::vector<Vec4Line> polyTemp;
-            for (unsigned int i = 0; i < poly->Vertices.size(); i++)
+            const unsigned int* vertices = box->GetPolygonVertices(p);
+            unsigned int size = box->GetPolygonSize(p);
+            for (unsigned int i = 0; i < size; i++)
             {
-                // Get vertices positions in object space
-                Vec4 pos1 = model->VertexPositions[poly->Vertices[i]->PositionID];
-                Vec4 pos2 = model->VertexPositions[poly->Vertices[(i + 1) % poly->Vertices.size()]->PositionID];
-
-                // Transform to View space
-                pos1 = pos1 * objToWorld * worldToView * viewTransform;
-                pos2 = pos2 * objToWorld * worldToView * viewTransform;
+                // Get vertices positions in View space
+                Vec4 pos1 = viewPositions.Get(box->VertexPositionIDs[vertices[i]]);
+                Vec4 pos2 = viewPositions.Get(box->VertexPositionIDs[vertices[(i + 1) % size]]);
 
                 Vec4Line edge(pos1, pos2);
                 polyTemp.push_back(edge);
@@ -303,6 +432,11 @@ void Scene::selectModelBBox(const Vec4& mousePos)
     selectedModelIndex = minIndex;
 }
 
+void Scene::TransformToView(Model* model, const Mat4& objectToView, PointStream& viewPositions)
+{
+    model->GetMesh()->TransformPositions(objectToView, viewPositions);
+}
+
 Camera* Scene::GetCamera()
 {
     return camera;
@@ -315,8 +449,34 @@ Renderer& Scene::GetRenderer()
 
 void Scene::FrameCameraOnModel(Model* model, bool newModel)
 {
-    Vec4 dimensions = model->GetModelDimensions() * model->GetObjectToWorldTransform();
-    Vec4 center = model->GetModelBBoxCenter() * model->GetObjectToWorldTransform();
+    // Transform the bounding box corners to world space and take their bounds
+    Vec4 minDims = model->GetModelBBoxCenter() - model->GetModelDimensions() / 2.0;
+    Vec4 maxDims = model->GetModelBBoxCenter() + model->GetModelDimensions() / 2.0;
+    double xs[8], ys[8], zs[8];
+    for (int i = 0; i < 8; i++)
+    {
+        xs[i] = (i & 1) ? maxDims[0] : minDims[0];
+        ys[i] = (i & 2) ? maxDims[1] : minDims[1];
+        zs[i] = (i & 4) ? maxDims[2] : minDims[2];
+    }
+    double wxs[8], wys[8], wzs[8], wws[8];
+    model->GetObjectToWorldTransform().TransformPoints(xs, ys, zs, 8, wxs, wys, wzs, wws);
+
+    Vec4 worldMin(wxs[0], wys[0], wzs[0]);
+    Vec4 worldMax(wxs[0], wys[0], wzs[0]);
+    for (int i = 1; i < 8; i++)
+    {
+        worldMin = Vec4(std::min(worldMin[0], wxs[i]), std::min(worldMin[1], wys[i]), std::min(worldMin[2], wzs[i]));
+        worldMax = Vec4(std::max(worldMax[0], wxs[i]), std::max(worldMax[1], wys[i]), std::max(worldMax[2], wzs[i]));
+    }
+
+    FrameCameraOnBounds(worldMin, worldMax, newModel);
+}
+
+void Scene::FrameCameraOnBounds(const Vec4& worldMin, const Vec4& worldMax, bool newModel)
+{
+    Vec4 dimensions = worldMax - worldMin;
+    Vec4 center = (worldMin + worldMax) / 2.0;
     double maxDim = MaxDbl(MaxDbl(dimensions[0], dimensions[1]), dimensions[2]);
     LOG_INFO("Model BBox Center: ({0}, {1}, {2})", center[0], center[1], center[2]);
 
@@ -393,8 +553,44 @@ void Scene::Draw()
     Mat4 projection = camera->GetProjection();
 
     renderer.InitZBuffer();
-    for (Model* model : models)
+    cullingStats = CullingStats();
+    drawQueue.Clear();
+
+    // Models in the view frustum, in load order. Animation playback moves
+    // models without changing their transforms, DrawModel culls them by their
+    // own bounds then.
+    visibleModels.clear();
+    if (Settings::IsPlayingAnimation)
+    {
+        for (unsigned int m = 0; m < models.size(); m++)
+            visibleModels.push_back(m);
+    }
+    else
+    {
+        Vec4 planes[4];
+        GetFrustumPlanes(camTransform * projection, projection, planes);
+        sceneGraph.Update();
+        spatialIndex.Update();
+        spatialIndex.CollectVisible(planes, 4, visibleModels);
+        std::sort(visibleModels.begin(), visibleModels.end());
+    }
+    cullingStats.ModelCount = models.size();
+    cullingStats.CulledModels = models.size() - visibleModels.size();
+    for (unsigned int m = 0, v = 0; m < models.size(); m++)
+    {
+        if ((v < visibleModels.size()) && (visibleModels[v] == m))
+        {
+            v++;
+            continue;
+        }
+
+        cullingStats.GeometryCount += models[m]->GetGeometryCount();
+        cullingStats.CulledGeometries += models[m]->GetGeometryCount();
+    }
+
+    for (unsigned int m : visibleModels)
     {
+        Model* model = models[m];
         Vec4 colorVec = model->GetMaterial()->Color;
         if (model == GetSelectedModel())
             colorVec = Vec4(255, 255, 0);
@@ -407,60 +603,273 @@ void Scene::Draw()
 
         if (Settings::IsPlayingAnimation)
         {
+            objectToWorld = GetAnimatedWorldTransform(model);
             const Frame* currentFrame = model->GetAnimation()->GetCurrentFrame();
-
             if (currentFrame != nullptr)
-            {
-                objectToWorld = currentFrame->ObjectToWorldTransform;
                 viewTransform = currentFrame->ViewTransform;
-            }
         }
 
-        DrawModel(model, objectToWorld, camTransform, viewTransform, projection, color);
+        QueueModel(model, objectToWorld, camTransform, viewTransform, projection, color);
+    }
+
+    // Whatever has arrived of the models still loading, the batches are read
+    // while the loaders keep appending
+    wxColour previewColor(128, 128, 128);
+    loader.GetPreviews(loadingPreviews);
+    for (ModelPreview* preview : loadingPreviews)
+    {
+        for (const ModelPreviewBatch* batch = preview->GetFirstBatch(); batch != NULL; 
+            batch = batch->Next.load(std::memory_order_acquire))
+        {
+            cullingStats.ModelCount++;
+            QueueModel(batch->Batch, Mat4(), camTransform, Mat4(), projection, previewColor);
+        }
+    }
+
+    drawQueue.Sort((DrawSortMode)Settings::DrawSortMode);
+    DrawQueuedPackets();
+
+    if (cullingStats.ModelCount > 0)
+    {
+        LOG_TRACE("Scene::Draw: {0} of {1} models and {2} of {3} geometries visible, culled {4} models and {5} geometries.", 
+            cullingStats.ModelCount - cullingStats.CulledModels, cullingStats.ModelCount, 
+            cullingStats.GeometryCount - cullingStats.CulledGeometries, cullingStats.GeometryCount,
+            cullingStats.CulledModels, cullingStats.CulledGeometries);
+    }
+
+    if (cullingStats.ClusterCount > 0)
+    {
+        LOG_TRACE("Scene::Draw: rejected {0}% of {1} clusters ({2} outside, {3} back facing), "
+            "{4}% of {5} polygons by cluster and {6}% by back face.",
+            100.0 * (cullingStats.OutsideClusters + cullingStats.BackFacingClusters) / cullingStats.ClusterCount,
+            cullingStats.ClusterCount, cullingStats.OutsideClusters, cullingStats.BackFacingClusters,
+            100.0 * cullingStats.ClusterRejectedPolygons / cullingStats.PolygonCount, cullingStats.PolygonCount,
+            100.0 * cullingStats.BackFacePolygons / cullingStats.PolygonCount);
     }
 }
+
+const CullingStats& Scene::GetCullingStats() const
+{
+    return cullingStats;
+}
     
 
-void Scene::DrawModel(Model* model, const Mat4& objectToWorld, const Mat4& camTransform, 
+void Scene::QueueModel(Model* model, const Mat4& objectToWorld, const Mat4& camTransform, 
     const Mat4& viewTransform, const Mat4& projection, const wxColour& color)
 {
-    auto geos = model->GetGeometries();
+    unsigned int geoCount = model->GetGeometryCount();
+    DrawItem item;
+    item.Source = model;
+    item.ObjectToView = objectToWorld * camTransform * viewTransform;
+    item.ObjectToClip = item.ObjectToView * projection;
+
+    // Bounds, geometries and clusters are tested in object space. The scene's
+    // index already culled models by their world bounds, this also culls
+    // animated models, models with a view transform and loading previews.
+    GetFrustumPlanes(item.ObjectToClip, projection, item.Planes);
+    const Mesh* mesh = model->GetMesh();
+    cullingStats.GeometryCount += geoCount;
+    if (IsBoxOutside(mesh->GetMinDimensions(), mesh->GetMaxDimensions(), item.Planes))
+    {
+        cullingStats.CulledModels++;
+        cullingStats.CulledGeometries += geoCount;
+        return;
+    }
+
+    item.NormalToView = Mat4::NormalMatrix(item.ObjectToView);
+    item.Eye = GetObjectSpaceEye(item.ObjectToView, item.NormalToView, projection);
+    item.Color = color;
+    item.AreLodsReady = Settings::IsLodEnabled && model->AreLodsReady();
+    item.Depth = GetViewDepth(mesh->GetBBoxCenter(), item.ObjectToClip);
+    unsigned int id = drawQueue.AddItem(item);
+
+    for (unsigned int g = 0; g < geoCount; g++)
+    {
+        const Geometry* geo = model->GetGeometry(g);
+        if ((geoCount > 1) && IsBoxOutside(geo->MinDimensions, geo->MaxDimensions, item.Planes))
+        {
+            cullingStats.CulledGeometries++;
+            continue;
+        }
+
+        Vec4 center = (geo->MinDimensions + geo->MaxDimensions) * 0.5;
+        center[3] = 1.0;
+        drawQueue.AddPacket(id, geo, g, GetViewDepth(center, item.ObjectToClip));
+    }
+    drawQueue.AddPacket(id, NULL);
+}
+
+void Scene::DrawQueuedPackets()
+{
+    wxColour bbColor(255, 0, 0);
+    int transformedItem = -1;
+    for (const DrawPacket& packet : drawQueue.GetPackets())
+    {
+        const DrawItem& item = drawQueue.GetItem(packet.Item);
+        const Mesh* mesh = item.Source->GetMesh();
+
+        // Transform all of the model's vertices to screen space once, its
+        // packets are next to each other
+        if (((packet.Geo != NULL) || Settings::IsBoundingBoxOn) && (transformedItem != (int)packet.Item))
+        {
+            renderer.TransformVertices(mesh, item.ObjectToClip);
+            transformedItem = packet.Item;
+        }
+
+        if (packet.Geo != NULL)
+        {
+            DrawGeometry(item, packet.Geo, packet.GeometryIndex);
+            continue;
+        }
+
+        const Geometry* box = mesh->BoundingBox;
+        if (Settings::IsBoundingBoxOn && !Settings::IsBoundingBoxGeo && (box != NULL))
+        {
+            for (unsigned int p = 0; p < box->GetPolygonCount(); p++)
+            {
+                renderer.DrawPolygon(box, p, bbColor);
+            } 
+        }
+
+        DrawOrigin(Vec4(0.0, 0.0, 0.0), item.ObjectToClip);
+    }
+}
+
+void Scene::DrawGeometry(const DrawItem& item, const Geometry* geo, unsigned int geometryIndex)
+{
     wxColour bbColor(255, 0, 0);
+    const Mat4& projection = camera->GetProjection();
 
-    for (Geometry* geo : geos)
+    // Models sharing the mesh are drawn at different sizes, each keeps its own level
+    const Geometry* lod = geo;
+    if (item.AreLodsReady)
     {
-        for (Polygon* poly : geo->Polygons)
+        int currentLod = item.Source->GetLodLevel(geometryIndex);
+        lod = SelectLod(geo, currentLod);
+        item.Source->SetLodLevel(geometryIndex, currentLod);
+    }
+    bool isTriangulated = lod->IsTriangulated();
+    bool useClusters = Settings::IsClusterCullingEnabled && (lod->GetClusterCount() > 0);
+    unsigned int clusterCount = useClusters ? lod->GetClusterCount() : 1;
+    cullingStats.PolygonCount += lod->GetPolygonCount();
+
+    for (unsigned int c = 0; c < clusterCount; c++)
+    {
+        unsigned int first = useClusters ? lod->ClusterOffsets[c] : 0;
+        unsigned int last = useClusters ? lod->ClusterOffsets[c + 1] : lod->GetPolygonCount();
+        if (useClusters)
         {
+            cullingStats.ClusterCount++;
+            if (IsSphereOutside(lod->ClusterSpheres[c], item.Planes))
+            {
+                cullingStats.OutsideClusters++;
+                cullingStats.ClusterRejectedPolygons += last - first;
+                continue;
+            }
             if (Settings::IsBackFaceCullingEnabled && 
-                IsBackFace(poly, objectToWorld, camTransform, viewTransform, projection))
+                IsConeBackFacing(lod->ClusterSpheres[c], lod->ClusterCones[c], item.Eye))
+            {
+                cullingStats.BackFacingClusters++;
+                cullingStats.ClusterRejectedPolygons += last - first;
                 continue;
-            
-            renderer.DrawPolygon(poly, model, objectToWorld, camTransform, viewTransform, projection, color);
-            //renderer.FillPolygon(model, poly, camTransform, projection, model->GetMaterial()->Color);
+            }
         }
 
-        if (Settings::IsBoundingBoxOn && Settings::IsBoundingBoxGeo)
+        for (unsigned int p = first; p < last; p++)
         {
-            for (Polygon* poly : geo->BoundingBoxPolygons)
+            if (Settings::IsBackFaceCullingEnabled && 
+                IsBackFace(lod, p, item.ObjectToView, item.NormalToView, projection))
             {
-                renderer.DrawPolygon(poly, model, objectToWorld, camTransform, viewTransform, projection, bbColor);
+                cullingStats.BackFacePolygons++;
+                continue;
             }
+            
+            if (isTriangulated)
+                renderer.DrawTriangle(lod, p, item.Color);
+            else
+                renderer.DrawPolygon(lod, p, item.Color);
+            //renderer.FillPolygon(model, geo, p, camTransform, projection, model->GetMaterial()->Color);
         }
     }
 
-    if (Settings::IsBoundingBoxOn && !Settings::IsBoundingBoxGeo)
+    if (Settings::IsBoundingBoxOn && Settings::IsBoundingBoxGeo && (geo->BoundingBox != NULL))
     {
-        for (Polygon* poly : model->BoundingBoxPolygons)
+        for (unsigned int p = 0; p < geo->BoundingBox->GetPolygonCount(); p++)
         {
-            renderer.DrawPolygon(poly, model, objectToWorld, camTransform, viewTransform, projection, bbColor);
-        } 
+            renderer.DrawPolygon(geo->BoundingBox, p, bbColor);
+        }
     }
+}
 
-    DrawOrigin(Vec4(0.0, 0.0, 0.0), objectToWorld, camTransform, viewTransform, projection);
+double Scene::GetViewDepth(const Vec4& point, const Mat4& objectToClip)
+{
+    double w = Vec4::Dot3(point, Vec4(objectToClip[0][3], objectToClip[1][3], objectToClip[2][3])) + 
+        objectToClip[3][3];
+
+    // Perspective w is the view depth with the sign of points in front of the
+    // camera. Orthographic front faces have a positive projected z normal, z
+    // falls with depth.
+    const Mat4& projection = camera->GetProjection();
+    if (camera->IsPerspective())
+        return ((projection[2][3] + projection[3][3] < 0.0) ? -w : w);
+
+    double z = Vec4::Dot3(point, Vec4(objectToClip[0][2], objectToClip[1][2], objectToClip[2][2])) + 
+        objectToClip[3][2];
+    return -z / w;
 }
 
-void Scene::DrawOrigin(const Vec4& origin, const Mat4& objectToWorld, 
-    const Mat4& camTransform, const Mat4& viewTransform, const Mat4& projection)
+const Geometry* Scene::SelectLod(const Geometry* geo, int& currentLod)
+{
+    if (geo->Lods.empty() || (geo->BoundingBox == NULL))
+        return geo;
+
+    // Screen size of the bounding box, its corners were transformed with the model
+    const PointStream& screenPoints = renderer.GetScreenPoints();
+    double minX = std::numeric_limits<double>::max(), maxX = -minX;
+    double minY = minX, maxY = -minX;
+
+    // Points in front of the camera have the sign of w of the view space point (0, 0, 1)
+    const Mat4& projection = camera->GetProjection();
+    double frontSign = (projection[2][3] + projection[3][3] < 0.0) ? -1.0 : 1.0;
+    for (int posID : geo->BoundingBox->VertexPositionIDs)
+    {
+        // Partly behind the camera, keep full detail
+        if (frontSign * screenPoints.W[posID] <= 0.0)
+        {
+            currentLod = 0;
+            return geo;
+        }
+
+        minX = std::min(minX, screenPoints.X[posID]);
+        maxX = std::max(maxX, screenPoints.X[posID]);
+        minY = std::min(minY, screenPoints.Y[posID]);
+        maxY = std::max(maxY, screenPoints.Y[posID]);
+    }
+
+    // Every level has about a quarter of the polygons of the previous one,
+    // so halving the size on screen moves one level down
+    double coverage = std::max(maxX - minX, maxY - minY) / std::max(renderer.GetHeight(), 1);
+    int lodCount = (int)geo->Lods.size();
+    double level = (coverage > 0.0) ? 
+        log2(Settings::LodFullDetailCoverage / coverage) : (double)lodCount;
+
+    // Only switch once the ideal level is past the current one by the hysteresis
+    if ((level >= currentLod + 1 + Settings::LodHysteresis) || 
+        (level < currentLod - Settings::LodHysteresis))
+    {
+        int newLod = std::min(std::max((int)floor(level), 0), lodCount);
+        if (newLod != currentLod)
+        {
+            LOG_TRACE("Scene::SelectLod: coverage {0}, level {1} -> {2}.", coverage, currentLod, newLod);
+            currentLod = newLod;
+        }
+    }
+    currentLod = std::min(currentLod, lodCount);
+
+    return (currentLod == 0) ? geo : geo->Lods[currentLod - 1];
+}
+
+void Scene::DrawOrigin(const Vec4& origin, const Mat4& objectToClip)
 {
     double sizeFactor = 1.0;
     // Draw X axis
@@ -469,32 +878,29 @@ void Scene::DrawOrigin(const Vec4& origin, const Mat4& objectToWorld,
         (unsigned int)colorVec[2]);
     Vec4 pos1 = origin;
     Vec4 pos2 = origin + Vec4(1.0, 0.0, 0.0) * sizeFactor;
-    renderer.DrawEdge(pos1, pos2, objectToWorld, camTransform, viewTransform, projection, color, 1);
+    renderer.DrawEdge(pos1, pos2, objectToClip, color, 1);
 
     // Draw Y axis
     colorVec = Vec4(0, 255, 0);
     color = wxColour((unsigned int)colorVec[0], (unsigned int)colorVec[1], 
         (unsigned int)colorVec[2]);
     pos2 = origin + Vec4(0.0, 1.0, 0.0) * sizeFactor;
-    renderer.DrawEdge(pos1, pos2, objectToWorld, camTransform, viewTransform, projection, color, 1);
+    renderer.DrawEdge(pos1, pos2, objectToClip, color, 1);
 
     // Draw Z axis
     colorVec = Vec4(0, 0, 255);
     color = wxColour((unsigned int)colorVec[0], (unsigned int)colorVec[1], 
         (unsigned int)colorVec[2]);
     pos2 = origin + Vec4(0.0, 0.0, 1.0) * sizeFactor;
-    renderer.DrawEdge(pos1, pos2, objectToWorld, camTransform, viewTransform, projection, color, 1);
+    renderer.DrawEdge(pos1, pos2, objectToClip, color, 1);
 }
 
-bool Scene::IsBackFace(Polygon* p, const Mat4& objectToWorld, const Mat4& camTransform,
-    const Mat4& viewTransform, const Mat4& projection)
+bool Scene::IsBackFace(const Geometry* geo, unsigned int p, const Mat4& objectToView, 
+    const Mat4& normalToView, const Mat4& projection)
 {
-    Vec4 normal = p->Normal;
-    normal[3] = 0.0;
-
     // Transform normal and poly center to view space
-    normal = normal * objectToWorld * camTransform * viewTransform;
-    Vec4 center = p->Center * objectToWorld * camTransform * viewTransform;
+    Vec4 normal = normalToView.TransformNormal(geo->PolygonNormals[p]);
+    Vec4 center = geo->PolygonCenters[p] * objectToView;
 
     if (camera->IsPerspective())
     {
@@ -507,54 +913,67 @@ bool Scene::IsBackFace(Polygon* p, const Mat4& objectToWorld, const Mat4& camTra
 	return normal[2] < 0;
 }
 
+Vec4 Scene::GetObjectSpaceEye(const Mat4& objectToView, const Mat4& normalToView, 
+    const Mat4& projection)
+{
+    // Perspective: the view space origin
+    if (camera->IsPerspective())
+        return Vec4(0.0, 0.0, 0.0) * Mat4::InverseAffine(objectToView);
+
+    // Orthographic: IsBackFace tests the sign of the normal's projected z,
+    // bring that direction back through the normal matrix
+    Vec4 direction(-projection[0][2], -projection[1][2], -projection[2][2], 0.0);
+    Vec4 eye(Vec4::Dot3(normalToView[0], direction), Vec4::Dot3(normalToView[1], direction), 
+        Vec4::Dot3(normalToView[2], direction), 0.0);
+    double length = Vec4::Length3(eye);
+    return (length > AL_DBL_EPSILON) ? eye / length : eye;
+}
+
 void Scene::StartRecordingAnimation()
 {
     for (Model* model : models)
         model->GetAnimation()->ClearAnimation();
 }
 
-void Scene::AddKeyFrame(double timeDiff, const Vec4& offsets)
+void Scene::AddKeyFrame(double timeDiff)
 {
     if (models.size() == 0)
         return;
 
     Frame* frame = new Frame();
-    frame->ObjectToWorldTransform = GetSelectedModel()->GetObjectToWorldTransform();
+    frame->ObjectToParentTransform = GetSelectedModel()->GetObjectToParentTransform();
     frame->ViewTransform = GetSelectedModel()->GetViewTransform();
-    frame->Action[0] = (Settings::SelectedAction == ID_ACTION_TRANSLATE);
-    frame->Action[1] = (Settings::SelectedAction == ID_ACTION_SCALE);
-    frame->Action[2] = (Settings::SelectedAction == ID_ACTION_ROTATE);
-    frame->Space = Settings::SelectedSpace;
-    if (Settings::SelectedAction == ID_ACTION_TRANSLATE)
-    {
-        for (int i = 0; i < 3; i++)
-            frame->Translation[i] = (Settings::SelectedAxis[i]) ? offsets[0] : 0.0;
-    }
-    else if (Settings::SelectedAction == ID_ACTION_SCALE)
-    {
-        double scaleFactor = (offsets[1] < Settings::MinScaleFactor) ? 
-            Settings::MinScaleFactor : offsets[1];
-        for (int i = 0; i < 3; i++)
-            frame->Scale[i] = (Settings::SelectedAxis[i]) ? scaleFactor : 1.0;
-    }
-    else
-    {
-        for (int i = 0; i < 3; i++)
-            frame->Rotation[i] = (Settings::SelectedAxis[i]) ? offsets[2] : 0.0;
-    }
 
     Animation* anim = GetSelectedModel()->GetAnimation();
     if (anim->GetFrame(0) == NULL)
         frame->FrameNum = 0;
     else
         frame->FrameNum = anim->GetLastFrameNumber() + 
-            (int)(timeDiff * (double)Settings::FramesPerSeconds);
+            MaxInt(1, (int)(timeDiff * (double)Settings::FramesPerSeconds));
     frame->OriginalFrame = frame->FrameNum;
     
     LOG_TRACE("Scene::AddKeyFrame: Added KeyFrame at frame: {0}", frame->FrameNum);
     anim->AddKeyFrame(frame);
 }
 
+Mat4 Scene::GetAnimatedWorldTransform(Model* model)
+{
+    // Keyframes hold the transform relative to the parent, which may be
+    // playing its own animation
+    const Frame* frame = model->GetAnimation()->GetCurrentFrame();
+    Mat4 objectToParent = (frame != nullptr) ? frame->ObjectToParentTransform : 
+        model->GetObjectToParentTransform();
+
+    int parent = sceneGraph.GetParent(model->GetSceneNode());
+    if (parent < 0)
+        return objectToParent;
+
+    Model* parentModel = sceneGraph.GetModel(parent);
+    if (parentModel == NULL)
+        return objectToParent * sceneGraph.GetWorldTransform(parent);
+    return objectToParent * GetAnimatedWorldTransform(parentModel);
+}
+
 bool Scene::PlayAnimation()
 {
     if (models.size() == 0)
@@ -606,10 +1025,25 @@ void Scene::NormalPlaybackSpeed()
 
 void Scene::DeleteModels()
 {
+    if (models.empty())
+        return;
+
+    spatialIndex.Clear();
+    sceneGraph.Clear();
+    size_t bytes = 0;
+    std::set<const Mesh*> meshes;
+    clock_t before = clock();
     while (models.size() > 0)
     {
         Model* model = models.back();
         models.pop_back();
+        bytes += model->GetMemoryUsage();
+        // Shared meshes are counted once, they are freed with their last model
+        if (meshes.insert(model->GetMesh()).second)
+            bytes += model->GetMesh()->GetMemoryUsage();
         delete model;
     }
+
+    double seconds = (double)(clock() - before) / CLOCKS_PER_SEC;
+    LOG_INFO("Scene::DeleteModels: Released {0} MB in {1} s.", bytes / (1024.0 * 1024.0), seconds);
 }
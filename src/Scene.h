@@ -5,9 +5,33 @@
 #include "Model.h"
 #include "Camera.h"
 #include "Animation.h"
+#include "SceneBVH.h"
+#include "SceneGraph.h"
+#include "DrawQueue.h"
+#include "ModelLoader.h"
 
 #define SCENE Scene::GetInstance()
 
+// Culling counters of the last frame
+struct CullingStats
+{
+    unsigned int ModelCount;
+    unsigned int CulledModels;
+    unsigned int GeometryCount;
+    unsigned int CulledGeometries;
+    unsigned int ClusterCount;
+    unsigned int OutsideClusters;
+    unsigned int BackFacingClusters;
+    unsigned int PolygonCount;
+    unsigned int ClusterRejectedPolygons;
+    unsigned int BackFacePolygons;
+
+    CullingStats() 
+        : ModelCount(0), CulledModels(0), GeometryCount(0), CulledGeometries(0), ClusterCount(0), 
+        OutsideClusters(0), BackFacingClusters(0), PolygonCount(0), ClusterRejectedPolygons(0), 
+        BackFacePolygons(0) {}
+};
+
 class Scene
 {
     public:
@@ -25,7 +49,28 @@ class Scene
 
         // Models Methods
         bool LoadModelFromFile(const std::string& filename);
+        // Loads on a background thread, the model is added by AddLoadedModels
+        // once it's done. Returns the load's id.
+        unsigned int StartLoadingModel(const std::string& filename, 
+            const ModelLoadProgressCallback& onProgress = ModelLoadProgressCallback(), 
+            const ModelLoadDoneCallback& onDone = ModelLoadDoneCallback());
+        void CancelLoadingModel(unsigned int id);
+        void CancelLoadingModels(bool wait = false);
+        // Adds the models of the finished loads, returns how many were added
+        unsigned int AddLoadedModels();
+        unsigned int GetLoadingModelCount() const;
+        void GetLoadingProgress(size_t& bytesRead, size_t& totalBytes) const;
+        // Frames the camera on loads whose bounds just arrived. Returns true if
+        // any load published something since the last call.
+        bool UpdateLoadingPreviews();
         std::vector<Model*>& GetModels();
+        // The model stays where it is in the world, its transform becomes
+        // relative to the parent's. Parent NULL makes it a root. False if
+        // parent is under the model.
+        bool SetModelParent(Model* model, Model* parent);
+        // NULL for a root
+        Model* GetModelParent(Model* model);
+        SceneGraph& GetSceneGraph();
         Model* GetSelectedModel();
         void SelectNextModel();
         void SelectPreviousModel();
@@ -38,10 +83,14 @@ class Scene
 
         // Camera Methods
         void FrameCameraOnModel(Model* model, bool newModel = true);
+        void FrameCameraOnBounds(const Vec4& worldMin, const Vec4& worldMax, bool newModel = true);
 
         // Animation methods
         void StartRecordingAnimation();
-        void AddKeyFrame(double timeDiff = 0.0, const Vec4& offsets = Vec4(0.0, 1.0, 0.0));
+        // Records the selected model's transform relative to its parent.
+        // timeDiff is the time since the previous keyframe, a keyframe is at
+        // least one frame after it.
+        void AddKeyFrame(double timeDiff = 0.0);
         bool PlayAnimation();
         void IncreasePlaybackSpeed(double percentage);
         void DecreasePlaybackSpeed(double percentage);
@@ -49,26 +98,45 @@ class Scene
 
         void Resized(int width, int height);
         void Draw();
+        const CullingStats& GetCullingStats() const;
 
     private:
         Scene();
 
         void DrawBackground();
-        void DrawModel(Model* model, const Mat4& objectToWorld, const Mat4& camTransform, 
+        // Culls the model and its geometries and queues the rest
+        void QueueModel(Model* model, const Mat4& objectToWorld, const Mat4& camTransform, 
             const Mat4& viewTransform, const Mat4& projection, const wxColour& color);
-        void DrawOrigin(const Vec4& origin, const Mat4& objectToWorld, const Mat4& camTransform, 
-            const Mat4& viewTransform, const Mat4& projection);
-        bool IsBackFace(Polygon* p, const Mat4& objectToWorld, const Mat4& camTransform,
-            const Mat4& viewTransform, const Mat4& projection);
+        void DrawQueuedPackets();
+        void DrawGeometry(const DrawItem& item, const Geometry* geo, unsigned int geometryIndex);
+        // Larger is farther from the camera
+        double GetViewDepth(const Vec4& point, const Mat4& objectToClip);
+        void DrawOrigin(const Vec4& origin, const Mat4& objectToClip);
+        // currentLod is the level the model last drew of the geometry, it's updated
+        const Geometry* SelectLod(const Geometry* geo, int& currentLod);
+        bool IsBackFace(const Geometry* geo, unsigned int p, const Mat4& objectToView, const Mat4& normalToView,
+            const Mat4& projection);
+        Vec4 GetObjectSpaceEye(const Mat4& objectToView, const Mat4& normalToView, const Mat4& projection);
+        // The model's keyframe composed with its parents' while playing
+        Mat4 GetAnimatedWorldTransform(Model* model);
+        void addModel(Model* model);
         void DeleteModels();
+        void TransformToView(Model* model, const Mat4& objectToView, PointStream& viewPositions);
         void selectModelPoly(const Vec4& mousePos);
         void selectModelBBox(const Vec4& mousePos);
 
     private:
         std::vector<Model*> models;
+        ModelLoader loader;
+        SceneGraph sceneGraph;
+        SceneBVH spatialIndex;
+        std::vector<unsigned int> visibleModels;
+        DrawQueue drawQueue;
+        std::vector<ModelPreview*> loadingPreviews;
         Camera* camera;
         Renderer renderer;
         int selectedModelIndex;
+        CullingStats cullingStats;
 
         CameraParameters originalCamParams;
 };
\ No newline at end of file
@@ -0,0 +1,328 @@
+#include "SceneBVH.h"
+#include "Model.h"
+
+static double GetHalfArea(const Vec4& min, const Vec4& max)
+{
+    Vec4 d = max - min;
+    return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+}
+
+static void GetUnion(const SceneBVHNode& a, const SceneBVHNode& b, Vec4& min, Vec4& max)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        min[i] = std::min(a.Min[i], b.Min[i]);
+        max[i] = std::max(a.Max[i], b.Max[i]);
+    }
+}
+
+// Cost of putting the leaf under node: the node's area growth, or the area of
+// the new parent if node is a leaf
+static double GetInsertCost(const SceneBVHNode& node, const SceneBVHNode& leaf)
+{
+    Vec4 min, max;
+    GetUnion(node, leaf, min, max);
+    double area = GetHalfArea(min, max);
+    return (node.ModelIndex >= 0) ? area : area - GetHalfArea(node.Min, node.Max);
+}
+
+SceneBVH::SceneBVH()
+    : root(-1)
+{
+
+}
+
+void SceneBVH::Insert(Model* model, unsigned int index)
+{
+    if (index >= models.size())
+    {
+        models.resize(index + 1, NULL);
+        leaves.resize(index + 1, -1);
+        isDirty.resize(index + 1, false);
+    }
+
+    int leaf = AllocateNode();
+    nodes[leaf].ModelIndex = index;
+    models[index] = model;
+    leaves[index] = leaf;
+    model->SetSpatialIndex(this, index);
+
+    SetLeafBounds(leaf);
+    InsertLeaf(leaf);
+}
+
+void SceneBVH::Clear()
+{
+    nodes.clear();
+    freeNodes.clear();
+    models.clear();
+    leaves.clear();
+    dirty.clear();
+    isDirty.clear();
+    root = -1;
+}
+
+void SceneBVH::MarkDirty(unsigned int index)
+{
+    if ((index >= isDirty.size()) || isDirty[index])
+        return;
+
+    isDirty[index] = true;
+    dirty.push_back(index);
+}
+
+void SceneBVH::Update()
+{
+    for (unsigned int index : dirty)
+    {
+        int leaf = leaves[index];
+        RemoveLeaf(leaf);
+        SetLeafBounds(leaf);
+        InsertLeaf(leaf);
+        isDirty[index] = false;
+    }
+    dirty.clear();
+}
+
+void SceneBVH::CollectVisible(const Vec4* planes, unsigned int planeCount,
+    std::vector<unsigned int>& indices) const
+{
+    indices.clear();
+    if (root < 0)
+        return;
+
+    std::vector<int> stack(1, root);
+    while (!stack.empty())
+    {
+        const SceneBVHNode& node = nodes[stack.back()];
+        stack.pop_back();
+
+        // The box is outside a plane if its corner farthest along the plane's normal is
+        bool isOutside = false;
+        for (unsigned int i = 0; (i < planeCount) && !isOutside; i++)
+        {
+            const Vec4& plane = planes[i];
+            double distance = plane[3];
+            for (int j = 0; j < 3; j++)
+                distance += plane[j] * ((plane[j] >= 0.0) ? node.Max[j] : node.Min[j]);
+            isOutside = distance < 0.0;
+        }
+        if (isOutside)
+            continue;
+
+        if (node.ModelIndex >= 0)
+        {
+            indices.push_back(node.ModelIndex);
+            continue;
+        }
+
+        stack.push_back(node.Left);
+        stack.push_back(node.Right);
+    }
+}
+
+void SceneBVH::CollectHits(const Vec4& origin, const Vec4& direction, double tMax,
+    std::vector<std::pair<double, unsigned int> >& hits) const
+{
+    hits.clear();
+    if (root < 0)
+        return;
+
+    double invDirection[3];
+    for (int i = 0; i < 3; i++)
+        invDirection[i] = 1.0 / ((abs(direction[i]) > 1e-300) ? direction[i] : 1e-300);
+
+    std::vector<int> stack(1, root);
+    while (!stack.empty())
+    {
+        const SceneBVHNode& node = nodes[stack.back()];
+        stack.pop_back();
+
+        double tEnter = 0.0;
+        double tExit = tMax;
+        for (int i = 0; i < 3; i++)
+        {
+            double t1 = (node.Min[i] - origin[i]) * invDirection[i];
+            double t2 = (node.Max[i] - origin[i]) * invDirection[i];
+            tEnter = std::max(tEnter, std::min(t1, t2));
+            tExit = std::min(tExit, std::max(t1, t2));
+        }
+        if (tEnter > tExit)
+            continue;
+
+        if (node.ModelIndex >= 0)
+        {
+            hits.push_back(std::make_pair(tEnter, (unsigned int)node.ModelIndex));
+            continue;
+        }
+
+        stack.push_back(node.Left);
+        stack.push_back(node.Right);
+    }
+}
+
+int SceneBVH::AllocateNode()
+{
+    int id;
+    if (freeNodes.empty())
+    {
+        id = nodes.size();
+        nodes.push_back(SceneBVHNode());
+    }
+    else
+    {
+        id = freeNodes.back();
+        freeNodes.pop_back();
+    }
+
+    SceneBVHNode& node = nodes[id];
+    node.Parent = -1;
+    node.Left = -1;
+    node.Right = -1;
+    node.ModelIndex = -1;
+    node.Height = 0;
+    return id;
+}
+
+void SceneBVH::InsertLeaf(int leaf)
+{
+    if (root < 0)
+    {
+        root = leaf;
+        nodes[leaf].Parent = -1;
+        return;
+    }
+
+    // Walk down while a child is a cheaper place for the leaf than a new
+    // parent here, every node on the way grows by the same amount
+    int sibling = root;
+    while (nodes[sibling].ModelIndex < 0)
+    {
+        const SceneBVHNode& node = nodes[sibling];
+        Vec4 min, max;
+        GetUnion(node, nodes[leaf], min, max);
+        double combinedArea = GetHalfArea(min, max);
+        double inheritedCost = combinedArea - GetHalfArea(node.Min, node.Max);
+
+        double leftCost = GetInsertCost(nodes[node.Left], nodes[leaf]) + inheritedCost;
+        double rightCost = GetInsertCost(nodes[node.Right], nodes[leaf]) + inheritedCost;
+        if ((combinedArea < leftCost) && (combinedArea < rightCost))
+            break;
+
+        sibling = (leftCost < rightCost) ? node.Left : node.Right;
+    }
+
+    // New parent of the sibling and the leaf
+    int parent = AllocateNode();
+    int grandParent = nodes[sibling].Parent;
+    nodes[parent].Parent = grandParent;
+    nodes[parent].Left = sibling;
+    nodes[parent].Right = leaf;
+    if (grandParent < 0)
+        root = parent;
+    else if (nodes[grandParent].Left == sibling)
+        nodes[grandParent].Left = parent;
+    else
+        nodes[grandParent].Right = parent;
+
+    nodes[sibling].Parent = parent;
+    nodes[leaf].Parent = parent;
+    RefitAncestors(parent);
+}
+
+void SceneBVH::RemoveLeaf(int leaf)
+{
+    if (leaf == root)
+    {
+        root = -1;
+        return;
+    }
+
+    // The sibling takes the parent's place
+    int parent = nodes[leaf].Parent;
+    int grandParent = nodes[parent].Parent;
+    int sibling = (nodes[parent].Left == leaf) ? nodes[parent].Right : nodes[parent].Left;
+
+    nodes[sibling].Parent = grandParent;
+    if (grandParent < 0)
+        root = sibling;
+    else if (nodes[grandParent].Left == parent)
+        nodes[grandParent].Left = sibling;
+    else
+        nodes[grandParent].Right = sibling;
+
+    freeNodes.push_back(parent);
+    nodes[leaf].Parent = -1;
+    RefitAncestors(grandParent);
+}
+
+void SceneBVH::SetLeafBounds(int leaf)
+{
+    SceneBVHNode& node = nodes[leaf];
+    if (!models[node.ModelIndex]->GetWorldBounds(node.Min, node.Max))
+    {
+        double infinity = std::numeric_limits<double>::infinity();
+        node.Min = Vec4(-infinity, -infinity, -infinity);
+        node.Max = Vec4(infinity, infinity, infinity);
+    }
+}
+
+void SceneBVH::RefitAncestors(int node)
+{
+    while (node >= 0)
+    {
+        node = Balance(node);
+
+        SceneBVHNode& parent = nodes[node];
+        GetUnion(nodes[parent.Left], nodes[parent.Right], parent.Min, parent.Max);
+        parent.Height = 1 + std::max(nodes[parent.Left].Height, nodes[parent.Right].Height);
+        node = parent.Parent;
+    }
+}
+
+// Rotates the taller child up if the children's heights differ by more than
+// one, and returns the node now in this node's place. Models loaded at the
+// same place have equal bounds and would otherwise chain up on one side.
+int SceneBVH::Balance(int a)
+{
+    SceneBVHNode& nodeA = nodes[a];
+    if (nodeA.ModelIndex >= 0)
+        return a;
+
+    int b = nodeA.Left;
+    int c = nodeA.Right;
+    int balance = nodes[c].Height - nodes[b].Height;
+    if ((balance >= -1) && (balance <= 1))
+        return a;
+
+    // up is the taller child, its taller child stays under it and the
+    // shorter one moves under a in up's place
+    int up = (balance > 0) ? c : b;
+    int stay = (balance > 0) ? b : c;
+    SceneBVHNode& nodeUp = nodes[up];
+    int f = nodeUp.Left;
+    int g = nodeUp.Right;
+    int tall = (nodes[f].Height > nodes[g].Height) ? f : g;
+    int moved = (tall == f) ? g : f;
+
+    nodeUp.Parent = nodeA.Parent;
+    if (nodeUp.Parent < 0)
+        root = up;
+    else if (nodes[nodeUp.Parent].Left == a)
+        nodes[nodeUp.Parent].Left = up;
+    else
+        nodes[nodeUp.Parent].Right = up;
+
+    nodeUp.Left = a;
+    nodeUp.Right = tall;
+    nodeA.Parent = up;
+    nodeA.Left = stay;
+    nodeA.Right = moved;
+    nodes[moved].Parent = a;
+
+    GetUnion(nodes[stay], nodes[moved], nodeA.Min, nodeA.Max);
+    nodeA.Height = 1 + std::max(nodes[stay].Height, nodes[moved].Height);
+    GetUnion(nodeA, nodes[tall], nodeUp.Min, nodeUp.Max);
+    nodeUp.Height = 1 + std::max(nodeA.Height, nodes[tall].Height);
+    return up;
+}
\ No newline at end of file
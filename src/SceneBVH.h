@@ -0,0 +1,65 @@
+#pragma once
+
+#include "pch.h"
+
+class Model;
+
+// Leaves have a ModelIndex, inner nodes have ModelIndex -1 and two children
+struct SceneBVHNode
+{
+    Vec4 Min;
+    Vec4 Max;
+    int Parent;
+    int Left;
+    int Right;
+    int ModelIndex;
+    int Height;
+};
+
+// Dynamic bounding volume hierarchy over the world space bounds of the
+// scene's models. Models are inserted next to the node that grows the least
+// and the tree is kept balanced by rotations, leaves of models whose
+// transform changed are reinserted on the next Update.
+// Models with a view space transform can't be bounded in world space and get
+// infinite bounds.
+class SceneBVH
+{
+public:
+    SceneBVH();
+
+    // index is the model's position in the scene
+    void Insert(Model* model, unsigned int index);
+    void Clear();
+
+    // Called by the model when its transform changes
+    void MarkDirty(unsigned int index);
+    // Reinserts the leaves marked dirty with their new bounds
+    void Update();
+
+    // Models whose bounds are not fully outside one of the planes (x, y, z, d),
+    // inside is positive
+    void CollectVisible(const Vec4* planes, unsigned int planeCount,
+        std::vector<unsigned int>& indices) const;
+    // Models whose bounds the ray enters before tMax, with the entry distance
+    void CollectHits(const Vec4& origin, const Vec4& direction, double tMax,
+        std::vector<std::pair<double, unsigned int> >& hits) const;
+
+    unsigned int GetModelCount() const { return models.size(); }
+
+private:
+    int AllocateNode();
+    void InsertLeaf(int leaf);
+    void RemoveLeaf(int leaf);
+    void SetLeafBounds(int leaf);
+    void RefitAncestors(int node);
+    int Balance(int node);
+
+private:
+    std::vector<SceneBVHNode> nodes;
+    std::vector<int> freeNodes;
+    std::vector<Model*> models;
+    std::vector<int> leaves;
+    std::vector<unsigned int> dirty;
+    std::vector<bool> isDirty;
+    int root;
+};
\ No newline at end of file
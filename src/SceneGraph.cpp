@@ -0,0 +1,249 @@
+#include "SceneGraph.h"
+#include "Model.h"
+
+#include <thread>
+#include <chrono>
+
+// Nodes per thread below which a level is updated on fewer threads
+#define SCENE_GRAPH_MIN_NODES_PER_THREAD 4096
+
+SceneGraph::SceneGraph()
+{
+    Clear();
+}
+
+unsigned int SceneGraph::AddNode(int parent, Model* model)
+{
+    unsigned int id = ids.size();
+    unsigned int position = ids.size();
+    int parentPosition = (parent >= 0) ? (int)positions[parent] : -1;
+    unsigned int depth = (parentPosition >= 0) ? depths[parentPosition] + 1 : 0;
+    positions.push_back(position);
+    ids.push_back(id);
+    parents.push_back(parentPosition);
+    depths.push_back(depth);
+    locals.push_back(Mat4());
+    worlds.push_back(Mat4());
+    isDirty.push_back(false);
+    models.push_back(model);
+    MarkDirty(position);
+
+    // The order holds while nodes are added to the last level or the one after
+    unsigned int levelCount = levelOffsets.size() - 1;
+    if (isOrderDirty || (depth + 1 < levelCount) || (depth > levelCount))
+        isOrderDirty = true;
+    else if (depth == levelCount)
+        levelOffsets.push_back(levelOffsets.back() + 1);
+    else
+        levelOffsets.back()++;
+
+    return id;
+}
+
+bool SceneGraph::SetParent(unsigned int node, int parent)
+{
+    for (int p = parent; p >= 0; p = GetParent(p))
+    {
+        if (p == (int)node)
+        {
+            LOG_WARN("SceneGraph::SetParent: node {0} is under node {1}.", parent, node);
+            return false;
+        }
+    }
+
+    unsigned int position = positions[node];
+    parents[position] = (parent >= 0) ? (int)positions[parent] : -1;
+    MarkDirty(position);
+    isOrderDirty = true;
+    return true;
+}
+
+int SceneGraph::GetParent(unsigned int node) const
+{
+    int parent = parents[positions[node]];
+    return (parent >= 0) ? (int)ids[parent] : -1;
+}
+
+Model* SceneGraph::GetModel(unsigned int node) const
+{
+    return models[positions[node]];
+}
+
+void SceneGraph::Clear()
+{
+    parents.clear();
+    locals.clear();
+    worlds.clear();
+    isDirty.clear();
+    models.clear();
+    ids.clear();
+    depths.clear();
+    levelOffsets.assign(1, 0);
+    positions.clear();
+    isOrderDirty = false;
+    isAnyDirty = false;
+    firstDirty = 0;
+}
+
+void SceneGraph::MarkDirty(unsigned int position)
+{
+    isDirty[position] = true;
+    firstDirty = isAnyDirty ? std::min(firstDirty, position) : position;
+    isAnyDirty = true;
+}
+
+void SceneGraph::SetLocalTransform(unsigned int node, const Mat4& transform)
+{
+    unsigned int position = positions[node];
+    locals[position] = transform;
+    MarkDirty(position);
+}
+
+const Mat4& SceneGraph::GetLocalTransform(unsigned int node) const
+{
+    return locals[positions[node]];
+}
+
+const Mat4& SceneGraph::GetWorldTransform(unsigned int node)
+{
+    if (isAnyDirty)
+        Update();
+    return worlds[positions[node]];
+}
+
+Mat4 SceneGraph::GetParentWorldTransform(unsigned int node)
+{
+    int parent = GetParent(node);
+    return (parent >= 0) ? GetWorldTransform(parent) : Mat4();
+}
+
+void SceneGraph::RebuildOrder()
+{
+    // Depth of every node, parents may come after their children here
+    unsigned int count = ids.size();
+    std::vector<int> newDepths(count, -1);
+    std::vector<unsigned int> chain;
+    unsigned int levelCount = 0;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        int p = i;
+        while ((p >= 0) && (newDepths[p] < 0))
+        {
+            chain.push_back(p);
+            p = parents[p];
+        }
+        int depth = (p >= 0) ? newDepths[p] : -1;
+        while (!chain.empty())
+        {
+            newDepths[chain.back()] = ++depth;
+            chain.pop_back();
+        }
+        levelCount = std::max(levelCount, (unsigned int)newDepths[i] + 1);
+    }
+
+    // Stable counting sort by depth
+    levelOffsets.assign(levelCount + 1, 0);
+    for (unsigned int i = 0; i < count; i++)
+        levelOffsets[newDepths[i] + 1]++;
+    for (unsigned int l = 0; l < levelCount; l++)
+        levelOffsets[l + 1] += levelOffsets[l];
+
+    std::vector<unsigned int> newPositions(count);
+    std::vector<unsigned int> next(levelOffsets.begin(), levelOffsets.end() - 1);
+    for (unsigned int i = 0; i < count; i++)
+        newPositions[i] = next[newDepths[i]]++;
+
+    std::vector<int> sortedParents(count);
+    std::vector<Mat4> sortedLocals(count), sortedWorlds(count);
+    std::vector<char> sortedIsDirty(count);
+    std::vector<Model*> sortedModels(count);
+    std::vector<unsigned int> sortedIds(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        unsigned int position = newPositions[i];
+        sortedParents[position] = (parents[i] >= 0) ? (int)newPositions[parents[i]] : -1;
+        sortedLocals[position] = locals[i];
+        sortedWorlds[position] = worlds[i];
+        sortedIsDirty[position] = isDirty[i];
+        sortedModels[position] = models[i];
+        sortedIds[position] = ids[i];
+        positions[ids[i]] = position;
+        depths[position] = newDepths[i];
+    }
+
+    parents.swap(sortedParents);
+    locals.swap(sortedLocals);
+    worlds.swap(sortedWorlds);
+    isDirty.swap(sortedIsDirty);
+    models.swap(sortedModels);
+    ids.swap(sortedIds);
+    isOrderDirty = false;
+    firstDirty = 0;
+}
+
+void SceneGraph::Update(unsigned int threadCount)
+{
+    if (!isAnyDirty)
+        return;
+
+    std::chrono::steady_clock::time_point before = std::chrono::steady_clock::now();
+    if (isOrderDirty)
+        RebuildOrder();
+
+    if (threadCount == 0)
+        threadCount = MaxInt(1, std::thread::hardware_concurrency());
+
+    // A node changes if it's dirty or its parent changed, parents are a
+    // level up so they are done before their children
+    auto updateRange = [this](unsigned int begin, unsigned int end)
+    {
+        for (unsigned int i = begin; i < end; i++)
+        {
+            int parent = parents[i];
+            if ((parent >= 0) && isDirty[parent])
+                isDirty[i] = true;
+            if (!isDirty[i])
+                continue;
+
+            worlds[i] = (parent >= 0) ? locals[i] * worlds[parent] : locals[i];
+        }
+    };
+
+    for (unsigned int l = 0; l + 1 < levelOffsets.size(); l++)
+    {
+        if (levelOffsets[l + 1] <= firstDirty)
+            continue;
+        unsigned int first = std::max(levelOffsets[l], firstDirty);
+        unsigned int size = levelOffsets[l + 1] - first;
+        unsigned int levelThreads = MinInt(threadCount, MaxInt(1, size / SCENE_GRAPH_MIN_NODES_PER_THREAD));
+
+        std::vector<std::thread> threads;
+        for (unsigned int t = 1; t < levelThreads; t++)
+        {
+            threads.push_back(std::thread(updateRange, first + size * t / levelThreads, 
+                first + size * (t + 1) / levelThreads));
+        }
+        updateRange(first, first + size / levelThreads);
+        for (std::thread& thread : threads)
+            thread.join();
+    }
+
+    // Models are told on this thread, they mark the scene's index
+    unsigned int changed = 0;
+    for (unsigned int i = firstDirty; i < ids.size(); i++)
+    {
+        if (!isDirty[i])
+            continue;
+
+        changed++;
+        isDirty[i] = false;
+        if (models[i] != NULL)
+            models[i]->OnWorldTransformChanged();
+    }
+    isAnyDirty = false;
+    firstDirty = ids.size();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - before).count();
+    LOG_TRACE("SceneGraph::Update: {0} of {1} nodes in {2} levels changed in {3} s.", 
+        changed, ids.size(), levelOffsets.size() - 1, seconds);
+}
\ No newline at end of file
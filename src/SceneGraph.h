@@ -0,0 +1,64 @@
+#pragma once
+
+#include "pch.h"
+
+class Model;
+
+// Hierarchy of transforms. A node's world transform is its local transform
+// followed by its parent's world transform, so moving a group node moves
+// every model under it. Nodes are stored level by level, parents before
+// children, and keep their id when the order changes. World transforms are
+// cached and only recomputed under nodes whose local transform or parent
+// changed, wide levels are updated in parallel.
+class SceneGraph
+{
+public:
+    SceneGraph();
+
+    // Returns the new node's id, parent -1 for a root. A model node tells
+    // its model when a parent moved it.
+    unsigned int AddNode(int parent = -1, Model* model = NULL);
+    // False if parent is the node or under it
+    bool SetParent(unsigned int node, int parent);
+    int GetParent(unsigned int node) const;
+    // NULL for a group node without a model
+    Model* GetModel(unsigned int node) const;
+    void Clear();
+
+    void SetLocalTransform(unsigned int node, const Mat4& transform);
+    const Mat4& GetLocalTransform(unsigned int node) const;
+    // Updates first if anything changed
+    const Mat4& GetWorldTransform(unsigned int node);
+    // Identity for a root
+    Mat4 GetParentWorldTransform(unsigned int node);
+
+    // Recomputes the world transforms under changed nodes and tells their
+    // models. threadCount 0 picks one thread per core for wide levels.
+    void Update(unsigned int threadCount = 0);
+
+    unsigned int GetNodeCount() const { return ids.size(); }
+
+private:
+    void MarkDirty(unsigned int position);
+    // Sorts the nodes by depth after nodes were moved
+    void RebuildOrder();
+
+private:
+    // By position in the order
+    std::vector<int> parents;
+    std::vector<Mat4> locals;
+    std::vector<Mat4> worlds;
+    std::vector<char> isDirty;
+    std::vector<Model*> models;
+    std::vector<unsigned int> ids;
+    std::vector<unsigned int> depths;
+    // Every level is levelOffsets[l] to levelOffsets[l + 1] - 1
+    std::vector<unsigned int> levelOffsets;
+
+    // Position of every node id
+    std::vector<unsigned int> positions;
+    bool isOrderDirty;
+    bool isAnyDirty;
+    // Nodes before it are clean, and so are their children as they come later
+    unsigned int firstDirty;
+};
\ No newline at end of file
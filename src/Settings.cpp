@@ -16,4 +16,17 @@ bool Settings::FramesInterpolation[2] = { true, false };
 bool Settings::IsBackgroundOn = false;
 bool Settings::IsBackgroundStretched = true;
 int Settings::BackgroundInterpolation = 0;
-std::string Settings::BackgroundImage = "";
\ No newline at end of file
+std::string Settings::BackgroundImage = "";
+bool Settings::IsModelCacheEnabled = true;
+bool Settings::IsTriangulationEnabled = false;
+bool Settings::IsMeshOptimizationEnabled = false;
+bool Settings::IsLodEnabled = true;
+double Settings::LodFullDetailCoverage = 0.5; // Fraction of the viewport height
+double Settings::LodHysteresis = 0.25; // In levels
+bool Settings::IsClusterCullingEnabled = true;
+bool Settings::IsProgressiveLoadingEnabled = true;
+unsigned int Settings::ProgressiveLoadingBatchSize = 100000; // Faces
+bool Settings::IsCompactVertexStorageEnabled = false;
+bool Settings::IsVertexWeldingEnabled = false;
+double Settings::VertexWeldEpsilon = 0.0; // In object space units, 0 only merges identical positions
+int Settings::DrawSortMode = 0; // DrawSortMode, front to back
\ No newline at end of file
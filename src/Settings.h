@@ -5,6 +5,7 @@
 enum CustomIDs
 {
     ID_FILE_CLEAR_ALL = 101,
+    ID_FILE_CANCEL_LOADING,
     ID_VIEW_PERSP,
     ID_VIEW_ORTHO,
     ID_VIEW_BOUNDING_BOX,
@@ -19,6 +20,8 @@ enum CustomIDs
     ID_ACTION_TRANSLATE,
     ID_ACTION_SCALE,
     ID_ACTION_ROTATE,
+    ID_ACTION_SET_PARENT,
+    ID_ACTION_CLEAR_PARENT,
     ID_AXIS_X,
     ID_AXIS_Y,
     ID_AXIS_Z,
@@ -64,4 +67,17 @@ public:
     static bool IsBackgroundStretched;
     static int BackgroundInterpolation;
     static std::string BackgroundImage;
+    static bool IsModelCacheEnabled;
+    static bool IsTriangulationEnabled;
+    static bool IsMeshOptimizationEnabled;
+    static bool IsLodEnabled;
+    static double LodFullDetailCoverage;
+    static double LodHysteresis;
+    static bool IsClusterCullingEnabled;
+    static bool IsProgressiveLoadingEnabled;
+    static unsigned int ProgressiveLoadingBatchSize;
+    static bool IsCompactVertexStorageEnabled;
+    static bool IsVertexWeldingEnabled;
+    static double VertexWeldEpsilon;
+    static int DrawSortMode;
 };
\ No newline at end of file
@@ -0,0 +1,212 @@
+#include "StlParser.h"
+#include "MappedFile.h"
+
+#include <cstring>
+#include <cstdint>
+#include <thread>
+#include <chrono>
+
+#define STL_HEADER_SIZE 80
+#define STL_TRIANGLE_SIZE 50
+// Triangles per thread below which fewer threads are used
+#define STL_MIN_TRIANGLES_PER_THREAD (64 * 1024)
+// Triangles between progress reports and cancellation checks
+#define STL_PROGRESS_TRIANGLES (16 * 1024)
+
+struct StlCorner
+{
+    float X;
+    float Y;
+    float Z;
+
+    bool operator==(const StlCorner& other) const
+    {
+        return (X == other.X) && (Y == other.Y) && (Z == other.Z);
+    }
+};
+
+// Open addressing spatial hash of corners, by their exact coordinates.
+// Slots hold an index into corners, or STL_EMPTY_SLOT.
+#define STL_EMPTY_SLOT 0xffffffffu
+
+struct StlCornerTable
+{
+    std::vector<unsigned int> Slots;
+    size_t Mask;
+
+    // Room for count corners at most half full
+    void Reserve(size_t count)
+    {
+        size_t size = 16;
+        while (size < count * 2)
+            size *= 2;
+        Slots.assign(size, STL_EMPTY_SLOT);
+        Mask = size - 1;
+    }
+
+    static size_t Hash(const StlCorner& corner)
+    {
+        uint32_t bits[3];
+        memcpy(bits, &corner, sizeof(bits));
+        uint64_t hash = bits[0] * 73856093ULL ^ bits[1] * 19349663ULL ^ bits[2] * 83492791ULL;
+        return (size_t)(hash ^ (hash >> 29));
+    }
+
+    // Index of the corner in corners, added if it isn't there yet
+    unsigned int Insert(const StlCorner& corner, std::vector<StlCorner>& corners)
+    {
+        size_t slot = Hash(corner) & Mask;
+        while (Slots[slot] != STL_EMPTY_SLOT)
+        {
+            if (corners[Slots[slot]] == corner)
+                return Slots[slot];
+            slot = (slot + 1) & Mask;
+        }
+
+        Slots[slot] = corners.size();
+        corners.push_back(corner);
+        return Slots[slot];
+    }
+};
+
+// Corners of a range of triangles, welded among themselves
+struct StlChunk
+{
+    std::vector<StlCorner> Corners;
+    // Three per triangle, into Corners
+    std::vector<unsigned int> Indices;
+};
+
+// Binary STL is little endian, like every platform this builds on. Adding
+// 0 turns -0 into 0 so both weld together.
+static inline float ReadFloat(const char* p)
+{
+    float value;
+    memcpy(&value, p, sizeof(value));
+    return value + 0.0f;
+}
+
+static void ParseTriangles(const char* triangles, unsigned int first, unsigned int last, 
+    StlChunk& chunk, LoadProgress* progress)
+{
+    StlCornerTable welded;
+    welded.Reserve((size_t)(last - first) * 3);
+    chunk.Indices.reserve((last - first) * 3);
+
+    for (unsigned int t = first; t < last; t++)
+    {
+        if ((progress != NULL) && ((t - first) % STL_PROGRESS_TRIANGLES == 0) && (t > first))
+        {
+            progress->AddBytes(STL_PROGRESS_TRIANGLES * STL_TRIANGLE_SIZE);
+            if (progress->IsCancelled)
+                return;
+        }
+
+        // The facet normal comes first, the vertex normals are calculated instead
+        const char* p = triangles + (size_t)t * STL_TRIANGLE_SIZE + 3 * sizeof(float);
+        for (int i = 0; i < 3; i++, p += 3 * sizeof(float))
+        {
+            StlCorner corner = { ReadFloat(p), ReadFloat(p + 4), ReadFloat(p + 8) };
+            chunk.Indices.push_back(welded.Insert(corner, chunk.Corners));
+        }
+    }
+
+    if (progress != NULL)
+        progress->AddBytes(((last - first) % STL_PROGRESS_TRIANGLES) * STL_TRIANGLE_SIZE);
+}
+
+bool StlParser::Parse(const std::string& filename, ObjData& data, unsigned int threadCount, 
+    LoadProgress* progress)
+{
+    MappedFile file;
+    if (!file.Open(filename))
+        return false;
+    if (progress != NULL)
+        progress->TotalBytes = file.GetSize();
+
+    std::chrono::steady_clock::time_point before = std::chrono::steady_clock::now();
+
+    uint32_t triangleCount = 0;
+    if (file.GetSize() >= STL_HEADER_SIZE + sizeof(triangleCount))
+        memcpy(&triangleCount, file.GetData() + STL_HEADER_SIZE, sizeof(triangleCount));
+    size_t expectedSize = STL_HEADER_SIZE + sizeof(triangleCount) + (size_t)triangleCount * STL_TRIANGLE_SIZE;
+    if ((file.GetSize() < STL_HEADER_SIZE + sizeof(triangleCount)) || (file.GetSize() < expectedSize))
+    {
+        bool isAscii = (file.GetSize() >= 5) && (memcmp(file.GetData(), "solid", 5) == 0);
+        LOG_ERROR("StlParser::Parse: {0} is {1}.", filename.c_str(), 
+            isAscii ? "ASCII STL, only binary STL is supported" : "not a valid binary STL file");
+        return false;
+    }
+
+    if (threadCount == 0)
+    {
+        threadCount = MaxInt(1, std::thread::hardware_concurrency());
+        threadCount = MinInt(threadCount, MaxInt(1, triangleCount / STL_MIN_TRIANGLES_PER_THREAD));
+    }
+    threadCount = MaxInt(1, MinInt(threadCount, MaxInt(1, triangleCount)));
+
+    // Every thread welds its own range of triangles
+    const char* triangles = file.GetData() + STL_HEADER_SIZE + sizeof(triangleCount);
+    std::vector<StlChunk> chunks(threadCount);
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < threadCount; i++)
+    {
+        threads.push_back(std::thread(ParseTriangles, triangles, (unsigned int)((uint64_t)triangleCount * i / threadCount), 
+            (unsigned int)((uint64_t)triangleCount * (i + 1) / threadCount), std::ref(chunks[i]), progress));
+    }
+    ParseTriangles(triangles, 0, (unsigned int)((uint64_t)triangleCount / threadCount), chunks[0], progress);
+    for (std::thread& thread : threads)
+        thread.join();
+
+    if (IsLoadCancelled(progress))
+    {
+        LOG_INFO("StlParser::Parse: {0} was cancelled.", filename.c_str());
+        return false;
+    }
+
+    // Then the corners the chunks share are welded across chunks
+    std::vector<StlCorner> corners;
+    std::vector<std::vector<unsigned int> > remaps(threadCount);
+    if (threadCount == 1)
+    {
+        corners.swap(chunks[0].Corners);
+    }
+    else
+    {
+        size_t cornerCount = 0;
+        for (const StlChunk& chunk : chunks)
+            cornerCount += chunk.Corners.size();
+
+        StlCornerTable welded;
+        welded.Reserve(cornerCount);
+        for (unsigned int i = 0; i < threadCount; i++)
+        {
+            remaps[i].resize(chunks[i].Corners.size());
+            for (unsigned int c = 0; c < chunks[i].Corners.size(); c++)
+                remaps[i][c] = welded.Insert(chunks[i].Corners[c], corners);
+        }
+    }
+
+    data.Positions.reserve(corners.size());
+    for (const StlCorner& corner : corners)
+        data.Positions.push_back(Vec4(corner.X, corner.Y, corner.Z));
+
+    data.Indices.resize((size_t)triangleCount * 3);
+    data.FaceOffsets.resize((size_t)triangleCount + 1);
+    for (unsigned int t = 0; t <= triangleCount; t++)
+        data.FaceOffsets[t] = t * 3;
+    size_t corner = 0;
+    for (unsigned int i = 0; i < threadCount; i++)
+    {
+        for (unsigned int index : chunks[i].Indices)
+            data.Indices[corner++] = ObjIndex((threadCount == 1) ? index : remaps[i][index]);
+    }
+    if (triangleCount > 0)
+        data.GroupFaces.push_back(0);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - before).count();
+    LOG_INFO("StlParser::Parse: {0} triangles, {1} corners welded to {2} positions on {3} threads in {4} s.", 
+        triangleCount, (size_t)triangleCount * 3, data.Positions.size(), threadCount, seconds);
+
+    return true;
+}
\ No newline at end of file
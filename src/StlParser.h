@@ -0,0 +1,17 @@
+#pragma once
+
+#include "pch.h"
+#include "ObjParser.h"
+#include "LoadProgress.h"
+
+// Binary STL reader. STL stores every triangle with its own copy of its
+// corners, corners with equal coordinates are welded into one position
+// through a hash of the coordinates so the mesh comes out connected.
+class StlParser
+{
+public:
+    // threadCount 0 picks one thread per core for large files. Returns false
+    // if the file can't be opened, isn't binary STL or progress was cancelled.
+    static bool Parse(const std::string& filename, ObjData& data, unsigned int threadCount = 0, 
+        LoadProgress* progress = NULL);
+};
\ No newline at end of file
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "pch.h"
+#include <cstdlib>
+#include <cstring>
+
+// Number and line scanning shared by the text model parsers. They work on
+// mapped files, which are not null terminated, so everything takes an end.
+
+static inline bool IsBlank(char c)
+{
+    return (c == ' ') || (c == '\t') || (c == '\r');
+}
+
+static inline bool IsDigit(char c)
+{
+    return (c >= '0') && (c <= '9');
+}
+
+static inline const char* SkipBlanks(const char* p, const char* end)
+{
+    while ((p < end) && IsBlank(*p))
+        p++;
+    return p;
+}
+
+static inline const char* SkipLine(const char* p, const char* end)
+{
+    const char* eol = (const char*)memchr(p, '\n', end - p);
+    return (eol == NULL) ? end : eol + 1;
+}
+
+static const double PowersOf10[] = 
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 
+    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Parses a decimal number like [+-]digits[.digits][(e|E)[+-]digits].
+// The fast path is exact only while the mantissa fits in a double's 53 bits
+// and the power of 10 is exact, anything else (inf, nan, long mantissas,
+// big exponents) goes through strtod.
+static inline const char* ParseDouble(const char* p, const char* end, double& value)
+{
+    const char* start = p;
+    bool negative = false;
+    if ((p < end) && ((*p == '-') || (*p == '+')))
+        negative = (*p++ == '-');
+
+    unsigned long long mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    while ((p < end) && IsDigit(*p))
+    {
+        mantissa = mantissa * 10 + (*p++ - '0');
+        digits++;
+    }
+    if ((p < end) && (*p == '.'))
+    {
+        p++;
+        while ((p < end) && IsDigit(*p))
+        {
+            mantissa = mantissa * 10 + (*p++ - '0');
+            digits++;
+            exponent--;
+        }
+    }
+    if ((p < end) && ((*p == 'e') || (*p == 'E')))
+    {
+        p++;
+        bool negativeExp = false;
+        if ((p < end) && ((*p == '-') || (*p == '+')))
+            negativeExp = (*p++ == '-');
+        // Past 400 the value is 0 or inf anyway, strtod sorts it out
+        int exp = 0;
+        while ((p < end) && IsDigit(*p))
+        {
+            if (exp < 400)
+                exp = exp * 10 + (*p - '0');
+            p++;
+        }
+        exponent += negativeExp ? -exp : exp;
+    }
+
+    // 19 digits can't overflow the mantissa, more might wrap around
+    if ((digits > 0) && (digits <= 19) && (mantissa <= (1ULL << 53)) && 
+        (exponent >= -22) && (exponent <= 22))
+    {
+        value = (exponent < 0) ? (double)mantissa / PowersOf10[-exponent] :
+            (double)mantissa * PowersOf10[exponent];
+        if (negative)
+            value = -value;
+        return p;
+    }
+
+    // Slow path, the token is copied since the mapped file isn't null terminated.
+    // Tokens that don't fit the stack buffer are rare enough to allocate.
+    const char* tokenEnd = start;
+    while ((tokenEnd < end) && !IsBlank(*tokenEnd) && (*tokenEnd != '\n'))
+        tokenEnd++;
+    char buffer[64];
+    std::string longToken;
+    const char* token = buffer;
+    if (tokenEnd - start < (ptrdiff_t)sizeof(buffer))
+    {
+        memcpy(buffer, start, tokenEnd - start);
+        buffer[tokenEnd - start] = '\0';
+    }
+    else
+    {
+        longToken.assign(start, tokenEnd);
+        token = longToken.c_str();
+    }
+    char* parsedEnd = NULL;
+    value = strtod(token, &parsedEnd);
+    return start + (parsedEnd - token);
+}
+
+static inline const char* ParseInt(const char* p, const char* end, int& value)
+{
+    bool negative = false;
+    if ((p < end) && ((*p == '-') || (*p == '+')))
+        negative = (*p++ == '-');
+
+    int result = 0;
+    while ((p < end) && IsDigit(*p))
+        result = result * 10 + (*p++ - '0');
+    value = negative ? -result : result;
+    return p;
+}
\ No newline at end of file
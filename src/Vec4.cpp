@@ -1,46 +1,6 @@
 #include "Vec4.h"
 #include "pch.h"
 
-Vec4::Vec4(double s)
-{
-	for (int i = 0; i < 4; i++)
-	{
-		data[i] = s;
-	}
-}
-
-Vec4::Vec4(double x, double y, double z, double w)
-{
-	data[0] = x;
-	data[1] = y;
-	data[2] = z;
-	data[3] = w;
-}
-
-Vec4::Vec4(const Vec4 & v)
-{
-	for (int i = 0; i < 4; i++)
-	{
-		data[i] = v.data[i];
-	}
-}
-
-Vec4::~Vec4()
-{
-}
-
-Vec4 & Vec4::operator=(const Vec4 & v)
-{
-	if (this == &v)
-		return *this;
-
-	for (int i = 0; i < 4; i++)
-	{
-		data[i] = v.data[i];
-	}
-	return *this;
-}
-
 bool Vec4::operator==(const Vec4 & v)
 {
 	return (Distance3(*this, v) < AL_DBL_EPSILON);
@@ -51,31 +11,11 @@ Vec4 Vec4::operator-() const
 	return ((*this) * (-1));
 }
 
-Vec4 Vec4::operator+(const Vec4 & v) const
-{
-	Vec4 result;
-	for (int i = 0; i < 4; i++)
-	{
-		result.data[i] = data[i] + v.data[i];
-	}
-	return  result;
-}
-
 Vec4 & Vec4::operator+=(const Vec4 & v)
 {
 	return (*this = *this + v);
 }
 
-Vec4 Vec4::operator-(const Vec4 & v) const
-{
-	Vec4 result;
-	for (int i = 0; i < 4; i++)
-	{
-		result.data[i] = data[i] - v.data[i];
-	}
-	return  result;
-}
-
 Vec4 & Vec4::operator-=(const Vec4 & v)
 {
 	return (*this = *this - v);
@@ -96,34 +36,11 @@ Vec4 & Vec4::operator*=(const Vec4 & v)
 	return (*this = *this * v);
 }
 
-Vec4 Vec4::operator*(double c) const
-{
-	Vec4 result;
-	for (int i = 0; i < 4; i++)
-	{
-		result.data[i] = data[i] * c;
-	}
-	return  result;
-}
-
 Vec4 & Vec4::operator*=(double c)
 {
 	return (*this = *this * c);
 }
 
-Vec4 Vec4::operator*(const Mat4 & m) const
-{
-	Vec4 result;
-	for (int i = 0; i < 4; i++)
-	{
-		for (int j = 0; j < 4; j++)
-		{
-			result[i] += data[j] * m[j][i];
-		}
-	}
-	return result;
-}
-
 Vec4 & Vec4::operator*=(const Mat4 & m)
 {
 	return (*this = *this * m);
@@ -146,38 +63,6 @@ bool Vec4::operator==(const Vec4 & v) const
 	return (Distance3(*this, v) < AL_DBL_EPSILON);
 }
 
-const double & Vec4::operator[](int i) const
-{
-	assert(i >= 0 && i < 4);
-	return data[i];
-}
-
-double & Vec4::operator[](int i)
-{
-	assert(i >= 0 && i < 4);
-	return data[i];
-}
-
-double Vec4::Dot3(const Vec4 & u, const Vec4 & v)
-{
-	double total = 0.0;
-	for (int i = 0; i < 3; i++)
-	{
-		total += u.data[i] * v.data[i];
-	}
-	return total;
-}
-
-double Vec4::Dot(const Vec4 & u, const Vec4 & v)
-{
-	double total = 0.0;
-	for (int i = 0; i < 4; i++)
-	{
-		total += u.data[i] * v.data[i];
-	}
-	return total;
-}
-
 Vec4 Vec4::Cross(const Vec4 & u, const Vec4 & v)
 {
 	Vec4 result;
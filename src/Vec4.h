@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iostream>
+#include <assert.h>
 
 // Forward decleration of Mat4 class
 class Mat4;
@@ -12,17 +13,28 @@ private:
 
 public:
 	// Constructors
-	explicit Vec4(double s = 0.0);
-	Vec4(double x, double y, double z, double w = 1.0);
+	// Small operations are defined inline (and copies are trivial) so chains
+	// like p * A * B don't call into another translation unit per temporary
+	explicit Vec4(double s = 0.0)
+	{
+		data[0] = data[1] = data[2] = data[3] = s;
+	}
+	Vec4(double x, double y, double z, double w = 1.0)
+	{
+		data[0] = x;
+		data[1] = y;
+		data[2] = z;
+		data[3] = w;
+	}
 
 	// Destructor
-	~Vec4();
+	~Vec4() = default;
 
 	// Copy constructor
-	Vec4(const Vec4& v);
+	Vec4(const Vec4& v) = default;
 
 	// Assignment operator overloading
-	Vec4& operator =(const Vec4& v);
+	Vec4& operator =(const Vec4& v) = default;
 
 	// Equals operator overloading
 	bool operator ==(const Vec4& v);
@@ -31,11 +43,17 @@ public:
 	Vec4 operator -() const;
 
 	// Addition operator overloading
-	Vec4 operator +(const Vec4& v) const;
+	Vec4 operator +(const Vec4& v) const
+	{
+		return Vec4(data[0] + v.data[0], data[1] + v.data[1], data[2] + v.data[2], data[3] + v.data[3]);
+	}
 	Vec4& operator +=(const Vec4& v);
 
 	// Subtraction operator overloading
-	Vec4 operator -(const Vec4& v) const;
+	Vec4 operator -(const Vec4& v) const
+	{
+		return Vec4(data[0] - v.data[0], data[1] - v.data[1], data[2] - v.data[2], data[3] - v.data[3]);
+	}
 	Vec4& operator -=(const Vec4& v);
 
 	// Multiplication with Vec4 overloading
@@ -44,7 +62,10 @@ public:
 	Vec4& operator *=(const Vec4& v);
 
 	// Multiplication with scalar operator overloading
-	Vec4 operator *(double c) const;
+	Vec4 operator *(double c) const
+	{
+		return Vec4(data[0] * c, data[1] * c, data[2] * c, data[3] * c);
+	}
 	Vec4& operator *=(double c);
 
 	// Multiplication with Mat4 operator overloading
@@ -58,15 +79,29 @@ public:
 	bool operator ==(const Vec4& v) const;
 
 	// Subscript operator overloading
-	const double& operator [](int i) const;
-	double& operator [](int i);
+	const double& operator [](int i) const
+	{
+		assert(i >= 0 && i < 4);
+		return data[i];
+	}
+	double& operator [](int i)
+	{
+		assert(i >= 0 && i < 4);
+		return data[i];
+	}
 
 	// Cout overloading
 	friend std::ostream& operator<<(std::ostream& os, const Vec4& v);
 
 	// Static methods
-	static double Dot3(const Vec4& u, const Vec4& v);
-	static double Dot(const Vec4& u, const Vec4& v);
+	static double Dot3(const Vec4& u, const Vec4& v)
+	{
+		return u.data[0] * v.data[0] + u.data[1] * v.data[1] + u.data[2] * v.data[2];
+	}
+	static double Dot(const Vec4& u, const Vec4& v)
+	{
+		return Dot3(u, v) + u.data[3] * v.data[3];
+	}
 	static Vec4 Cross(const Vec4& u, const Vec4& v);
 	static double Length3(const Vec4& u);
 	static double Length(const Vec4& u);
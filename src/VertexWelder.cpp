@@ -0,0 +1,207 @@
+#include "VertexWelder.h"
+
+#include <cstdint>
+#include <thread>
+#include <chrono>
+#include <functional>
+
+// Positions per thread below which fewer threads are used
+#define WELD_MIN_POSITIONS_PER_THREAD (64 * 1024)
+// Cells along the longest side of the bounds when epsilon is smaller
+#define WELD_GRID_RESOLUTION 1024
+#define WELD_EMPTY_SLOT 0xffffffffu
+
+// Positions of a cell are Order[First] to Order[Last - 1]. Cells whose
+// hashes collide share one entry, the distance test sorts them out.
+struct WeldCell
+{
+    uint64_t Key;
+    unsigned int First;
+    unsigned int Last;
+};
+
+struct WeldGrid
+{
+    double InvCellSize;
+    std::vector<std::pair<uint64_t, unsigned int> > Order;
+    std::vector<WeldCell> Cells;
+    std::vector<unsigned int> Slots;
+    size_t Mask;
+
+    void GetCell(const Vec4& position, int64_t* cell) const
+    {
+        for (int i = 0; i < 3; i++)
+            cell[i] = (int64_t)floor(position[i] * InvCellSize);
+    }
+
+    static uint64_t Hash(int64_t x, int64_t y, int64_t z)
+    {
+        uint64_t hash = (uint64_t)x * 73856093ULL ^ (uint64_t)y * 19349663ULL ^ (uint64_t)z * 83492791ULL;
+        return hash ^ (hash >> 29);
+    }
+
+    const WeldCell* Find(uint64_t key) const
+    {
+        size_t slot = key & Mask;
+        while (Slots[slot] != WELD_EMPTY_SLOT)
+        {
+            if (Cells[Slots[slot]].Key == key)
+                return &Cells[Slots[slot]];
+            slot = (slot + 1) & Mask;
+        }
+        return NULL;
+    }
+};
+
+// Runs function over threadCount ranges of [0, count)
+static void RunRanges(size_t count, unsigned int threadCount, 
+    const std::function<void(size_t, size_t)>& function)
+{
+    std::vector<std::thread> threads;
+    for (unsigned int t = 1; t < threadCount; t++)
+        threads.push_back(std::thread(function, count * t / threadCount, count * (t + 1) / threadCount));
+    function(0, count / threadCount);
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+unsigned int VertexWelder::Weld(ObjData& data, double epsilon, unsigned int threadCount)
+{
+    std::chrono::steady_clock::time_point before = std::chrono::steady_clock::now();
+
+    std::vector<Vec4>& positions = data.Positions;
+    size_t count = positions.size();
+    if (count < 2)
+        return 0;
+
+    if (threadCount == 0)
+    {
+        threadCount = MaxInt(1, std::thread::hardware_concurrency());
+        threadCount = MinInt(threadCount, MaxInt(1, count / WELD_MIN_POSITIONS_PER_THREAD));
+    }
+
+    // Cells are at least epsilon wide so close positions are at most one
+    // cell apart, and small enough to hold few positions each
+    Vec4 min = positions[0];
+    Vec4 max = positions[0];
+    for (const Vec4& position : positions)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            min[i] = std::min(min[i], position[i]);
+            max[i] = std::max(max[i], position[i]);
+        }
+    }
+    double extent = std::max(max[0] - min[0], std::max(max[1] - min[1], max[2] - min[2]));
+    double cellSize = std::max(epsilon, extent / WELD_GRID_RESOLUTION);
+
+    WeldGrid grid;
+    grid.InvCellSize = (cellSize > 0.0) ? 1.0 / cellSize : 1.0;
+    grid.Order.resize(count);
+    RunRanges(count, threadCount, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            int64_t cell[3];
+            grid.GetCell(positions[i], cell);
+            grid.Order[i] = std::make_pair(WeldGrid::Hash(cell[0], cell[1], cell[2]), (unsigned int)i);
+        }
+    });
+    std::sort(grid.Order.begin(), grid.Order.end());
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if ((i == 0) || (grid.Order[i].first != grid.Order[i - 1].first))
+            grid.Cells.push_back({ grid.Order[i].first, i, i });
+        grid.Cells.back().Last = i + 1;
+    }
+    size_t slotCount = 16;
+    while (slotCount < grid.Cells.size() * 2)
+        slotCount *= 2;
+    grid.Slots.assign(slotCount, WELD_EMPTY_SLOT);
+    grid.Mask = slotCount - 1;
+    for (unsigned int c = 0; c < grid.Cells.size(); c++)
+    {
+        size_t slot = grid.Cells[c].Key & grid.Mask;
+        while (grid.Slots[slot] != WELD_EMPTY_SLOT)
+            slot = (slot + 1) & grid.Mask;
+        grid.Slots[slot] = c;
+    }
+
+    // Lowest position within epsilon of every position, itself if none. Only
+    // the cells the box of half size epsilon around the position touches are
+    // searched, mostly just its own.
+    std::vector<unsigned int> lowest(count);
+    double epsilonSquared = epsilon * epsilon;
+    Vec4 offset(epsilon, epsilon, epsilon, 0.0);
+    RunRanges(count, threadCount, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            const Vec4& position = positions[i];
+            int64_t first[3], last[3];
+            grid.GetCell(position - offset, first);
+            grid.GetCell(position + offset, last);
+
+            unsigned int best = i;
+            for (int64_t x = first[0]; x <= last[0]; x++)
+            {
+                for (int64_t y = first[1]; y <= last[1]; y++)
+                {
+                    for (int64_t z = first[2]; z <= last[2]; z++)
+                    {
+                        const WeldCell* found = grid.Find(WeldGrid::Hash(x, y, z));
+                        if (found == NULL)
+                            continue;
+
+                        // Positions of a cell are in increasing order
+                        for (unsigned int o = found->First; o < found->Last; o++)
+                        {
+                            unsigned int other = grid.Order[o].second;
+                            if (other >= best)
+                                break;
+
+                            Vec4 d = positions[other] - position;
+                            if (d[0] * d[0] + d[1] * d[1] + d[2] * d[2] <= epsilonSquared)
+                                best = other;
+                        }
+                    }
+                }
+            }
+            lowest[i] = best;
+        }
+    });
+
+    // The lowest position comes first, so it already has its new index
+    std::vector<int> remap(count);
+    unsigned int welded = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (lowest[i] == i)
+        {
+            remap[i] = welded;
+            positions[welded++] = positions[i];
+        }
+        else
+        {
+            remap[i] = remap[lowest[i]];
+        }
+    }
+    positions.resize(welded);
+
+    RunRanges(data.Indices.size(), threadCount, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            int& posID = data.Indices[i].PositionID;
+            if ((posID >= 0) && ((size_t)posID < count))
+                posID = remap[posID];
+        }
+    });
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - before).count();
+    LOG_INFO("VertexWelder: {0} positions welded to {1} ({2}% fewer) with epsilon {3} on {4} threads in {5} s.", 
+        count, welded, 100.0 * (count - welded) / count, epsilon, threadCount, seconds);
+
+    return count - welded;
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "pch.h"
+#include "ObjParser.h"
+
+// Merges duplicate positions of parsed model data, so faces written with
+// their own copy of a shared corner share one vertex and are smoothed
+// together. Positions are bucketed in a spatial hash grid, every position
+// goes to the lowest position within epsilon of it (or of one merged into
+// it), and the face indices are rewritten.
+class VertexWelder
+{
+public:
+    // epsilon 0 merges identical positions only, threadCount 0 picks one
+    // thread per core for large models. Returns the number of positions removed.
+    static unsigned int Weld(ObjData& data, double epsilon, unsigned int threadCount = 0);
+};
\ No newline at end of file
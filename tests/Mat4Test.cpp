@@ -0,0 +1,223 @@
+#include "CpuFeatures.h"
+
+#include <cstdlib>
+#include <vector>
+
+// Checks of the Mat4 inverses and batch transforms, built and run by make
+// test once with the kernels the CPU supports and once with the scalar code only
+
+static int failures = 0;
+
+static void Check(bool condition, const char* name)
+{
+    if (!condition)
+    {
+        std::cout << "FAILED: " << name << std::endl;
+        failures++;
+    }
+}
+
+static bool IsNear(const Mat4& a, const Mat4& b, double tolerance = 1e-9)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            if (abs(a[i][j] - b[i][j]) > tolerance)
+                return false;
+        }
+    }
+    return true;
+}
+
+static double Random(double min, double max)
+{
+    return min + (max - min) * rand() / (double)RAND_MAX;
+}
+
+static bool IsNear(double a, double b)
+{
+    return abs(a - b) <= 1e-12 * std::max(1.0, std::max(abs(a), abs(b)));
+}
+
+static Mat4 RandomRigid()
+{
+    return Mat4::RotateX(Random(-180.0, 180.0)) * Mat4::RotateY(Random(-180.0, 180.0)) * 
+        Mat4::RotateZ(Random(-180.0, 180.0)) * 
+        Mat4::Translate(Random(-100.0, 100.0), Random(-100.0, 100.0), Random(-100.0, 100.0));
+}
+
+static Mat4 RandomScaled()
+{
+    return Mat4::Scale(Random(0.1, 10.0), Random(0.1, 10.0), Random(0.1, 10.0)) * RandomRigid() *
+        Mat4::Scale(Random(0.1, 10.0), Random(0.1, 10.0), Random(0.1, 10.0));
+}
+
+static Mat4 RandomProjective()
+{
+    Mat4 m;
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            m[i][j] = Random(-10.0, 10.0);
+    return m;
+}
+
+static void CheckInverse()
+{
+    Mat4 identity;
+    for (int n = 0; n < 1000; n++)
+    {
+        Mat4 m = RandomProjective();
+        Check(IsNear(m * Mat4::Inverse(m), identity, 1e-8), "M * Inverse(M) = I, projective");
+        Check(IsNear(Mat4::Inverse(m) * m, identity, 1e-8), "Inverse(M) * M = I, projective");
+    }
+
+    // Perspective projection like the camera's
+    Mat4 projection(1.0, 0.0, 0.0, 0.0,
+        0.0, 1.0, 0.0, 0.0,
+        0.0, 0.0, 1.0, 1.0 / 5.0,
+        0.0, 0.0, 0.0, 0.0);
+    projection[3][2] = -1.0;
+    Check(IsNear(projection * Mat4::Inverse(projection), identity), "M * Inverse(M) = I, perspective");
+}
+
+static void CheckInverseAffine()
+{
+    Mat4 identity;
+    for (int n = 0; n < 1000; n++)
+    {
+        Mat4 rigid = RandomRigid();
+        Check(IsNear(rigid * Mat4::InverseAffine(rigid), identity), "M * InverseAffine(M) = I, rigid");
+        Check(IsNear(Mat4::InverseAffine(rigid) * rigid, identity), "InverseAffine(M) * M = I, rigid");
+
+        Mat4 scaled = RandomScaled();
+        Check(IsNear(scaled * Mat4::InverseAffine(scaled), identity), "M * InverseAffine(M) = I, scaled");
+        Check(IsNear(Mat4::InverseAffine(scaled) * scaled, identity), "InverseAffine(M) * M = I, scaled");
+        Check(IsNear(Mat4::Inverse(scaled), Mat4::InverseAffine(scaled)), "Inverse(M) = InverseAffine(M)");
+    }
+}
+
+static void CheckNormalMatrix()
+{
+    for (int n = 0; n < 1000; n++)
+    {
+        // A normal stays perpendicular to the transformed tangents
+        Mat4 m = RandomScaled();
+        Vec4 normal = Vec4::Normalize3(Vec4(Random(-1.0, 1.0), Random(-1.0, 1.0), Random(-1.0, 1.0), 0.0));
+        Vec4 tangent = Vec4::Cross(normal, Vec4(Random(-1.0, 1.0), Random(-1.0, 1.0), Random(-1.0, 1.0), 0.0));
+        Vec4 transformedNormal = normal * Mat4::NormalMatrix(m);
+        Vec4 transformedTangent = m.TransformNormal(tangent);
+        double cosine = Vec4::Dot3(transformedNormal, transformedTangent) / 
+            (Vec4::Length3(transformedNormal) * Vec4::Length3(transformedTangent));
+        Check(abs(cosine) < 1e-9, "NormalMatrix keeps normals perpendicular, scaled");
+        Check(transformedNormal[3] == 0.0, "NormalMatrix keeps w = 0");
+
+        Mat4 linear = m;
+        linear[3] = Vec4(0.0, 0.0, 0.0, 1.0);
+        Mat4 inverseTranspose = Mat4::InverseAffine(linear);
+        inverseTranspose.Transpose();
+        Check(IsNear(Mat4::NormalMatrix(m), inverseTranspose), "NormalMatrix = Inverse(M)^T");
+    }
+
+    Mat4 rotation = RandomRigid();
+    rotation[3] = Vec4(0.0, 0.0, 0.0, 1.0);
+    Check(IsNear(Mat4::NormalMatrix(rotation), rotation), "NormalMatrix(R) = R");
+}
+
+// Batch sizes around the kernels' blocks of 4 and 8 points, so the wide
+// loops and the scalar tails are both compared with Vec4 * Mat4
+static const size_t batchSizes[] = { 1, 2, 3, 5, 7, 9, 13, 1001 };
+
+static void CheckTransformPoints()
+{
+    for (size_t n : batchSizes)
+    {
+        Mat4 m = RandomProjective();
+        std::vector<double> xs(n), ys(n), zs(n), outXs(n), outYs(n), outZs(n), outWs(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            xs[i] = Random(-100.0, 100.0);
+            ys[i] = Random(-100.0, 100.0);
+            zs[i] = Random(-100.0, 100.0);
+        }
+        m.TransformPoints(xs.data(), ys.data(), zs.data(), n, outXs.data(), outYs.data(), 
+            outZs.data(), outWs.data());
+
+        for (size_t i = 0; i < n; i++)
+        {
+            Vec4 p = Vec4(xs[i], ys[i], zs[i], 1.0) * m;
+            Check(IsNear(outXs[i], p[0]) && IsNear(outYs[i], p[1]) && IsNear(outZs[i], p[2]) && 
+                IsNear(outWs[i], p[3]), "TransformPoints = Vec4 * M");
+        }
+    }
+}
+
+static void CheckTransformQuantizedPoints()
+{
+    for (size_t n : batchSizes)
+    {
+        // Dequantization folded into a projective transform, as the meshes do
+        Mat4 m = Mat4::Scale(Random(1e-5, 1e-3)) * Mat4::Translate(Random(-1.0, 1.0), 
+            Random(-1.0, 1.0), Random(-1.0, 1.0)) * RandomProjective();
+        std::vector<uint16_t> xs(n), ys(n), zs(n);
+        std::vector<double> outXs(n), outYs(n), outZs(n), outWs(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            xs[i] = (uint16_t)(rand() & 0xFFFF);
+            ys[i] = (uint16_t)(rand() & 0xFFFF);
+            zs[i] = (uint16_t)(rand() & 0xFFFF);
+        }
+        m.TransformQuantizedPoints(xs.data(), ys.data(), zs.data(), n, outXs.data(), outYs.data(), 
+            outZs.data(), outWs.data());
+
+        for (size_t i = 0; i < n; i++)
+        {
+            Vec4 p = Vec4(xs[i], ys[i], zs[i], 1.0) * m;
+            Check(IsNear(outXs[i], p[0]) && IsNear(outYs[i], p[1]) && IsNear(outZs[i], p[2]) && 
+                IsNear(outWs[i], p[3]), "TransformQuantizedPoints = Vec4 * M");
+        }
+    }
+}
+
+static void CheckPerspectiveDivide()
+{
+    for (size_t n : batchSizes)
+    {
+        // Viewport like the renderer's
+        Mat4 viewport = Mat4::Scale(Random(100.0, 1000.0), -Random(100.0, 1000.0), 1.0) * 
+            Mat4::Translate(Random(100.0, 1000.0), Random(100.0, 1000.0), 0.0);
+        std::vector<double> xs(n), ys(n), zs(n), ws(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            xs[i] = Random(-100.0, 100.0);
+            ys[i] = Random(-100.0, 100.0);
+            zs[i] = Random(-100.0, 100.0);
+            ws[i] = Random(0.1, 100.0);
+        }
+        std::vector<double> dividedXs(xs), dividedYs(ys), dividedZs(zs);
+        viewport.PerspectiveDivide(dividedXs.data(), dividedYs.data(), dividedZs.data(), ws.data(), n);
+
+        for (size_t i = 0; i < n; i++)
+        {
+            Vec4 p = Vec4(xs[i] / ws[i], ys[i] / ws[i], zs[i] / ws[i], 1.0) * viewport;
+            Check(IsNear(dividedXs[i], p[0]) && IsNear(dividedYs[i], p[1]) && IsNear(dividedZs[i], p[2]), 
+                "PerspectiveDivide = Vec4 / w * M");
+        }
+    }
+}
+
+int main()
+{
+    srand(1);
+    std::cout << "Mat4Test: " << (CpuFeatures::HasAvx() ? "AVX" : "scalar") << " kernels" << std::endl;
+    CheckInverse();
+    CheckInverseAffine();
+    CheckNormalMatrix();
+    CheckTransformPoints();
+    CheckTransformQuantizedPoints();
+    CheckPerspectiveDivide();
+
+    if (failures > 0)
+        std::cout << "Mat4Test: " << failures << " checks failed" << std::endl;
+    return (failures > 0) ? 1 : 0;
+}
\ No newline at end of file